@@ -1,4 +1,11 @@
 #include "Ambulance.hpp"
+#include "../Common/Persistence.hpp"
+#include "../Common/Snapshot.hpp"
+#include "../Common/Stats.hpp"
+#include "../Common/Trace.hpp"
+#include "../Common/Recorder.hpp"
+#include "../Common/Table.hpp"
+#include "../Common/WaitStats.hpp"
 
 #include <iostream>
 #include <fstream>
@@ -14,6 +21,10 @@
 
 using namespace std;
 
+static string shiftName(int shift) {
+    return shift == 0 ? "Morning" : (shift == 1 ? "Afternoon" : "Midnight");
+}
+
 // ==============================================
 //   AmbulanceQueue methods
 // ==============================================
@@ -22,6 +33,18 @@ AmbulanceQueue::AmbulanceQueue() {
     front = 0; //first element
     rear  = -1; //last element
     count = 0; //total stored
+    // The array is part of the object: full size whatever is stored
+    MemoryRegistry::instance().allocated(MEM_AMBULANCE_ARRAY, sizeof(arr));
+}
+
+AmbulanceQueue::AmbulanceQueue(const AmbulanceQueue& other)
+    : front(other.front), rear(other.rear), count(other.count) {
+    memcpy(arr, other.arr, sizeof(arr));
+    MemoryRegistry::instance().allocated(MEM_AMBULANCE_ARRAY, sizeof(arr));
+}
+
+AmbulanceQueue::~AmbulanceQueue() {
+    MemoryRegistry::instance().released(MEM_AMBULANCE_ARRAY, sizeof(arr));
 }
 
 bool AmbulanceQueue::isEmpty() const {
@@ -73,29 +96,19 @@ void AmbulanceQueue::display() const {
         return;
     }
 
-    cout << "\n=============== Current Queue ================\n";
-    cout << "| " << setw(4) << "No" 
-         << " | " << setw(4) << "ID" 
-         << " | " << setw(12) << "Plate" 
-         << " | " << setw(20) << "Driver" 
-         << " | " << setw(9) << "Shift" << " |\n";
-    cout << "---------------------------------------------\n";
+    TableWriter table(cout, {{"No", 4, true}, {"ID", 4, true}, {"Plate", 12, true},
+                             {"Driver", 20, true}, {"Shift", 9, true}}, true);
+    table.line("\n=============== Current Queue ================");
+    table.header();
 
     int index = front;
     for (int i = 0; i < count; i++) {
         const Ambulance& a = arr[index];
-        string shiftName = (a.shift == 0 ? "Morning" : (a.shift == 1 ? "Afternoon" : "Midnight"));
-
-        cout << "| " << setw(4) << (i + 1)
-             << " | " << setw(4) << a.id
-             << " | " << setw(12) << a.plate
-             << " | " << setw(20) << a.driverName
-             << " | " << setw(9) << shiftName << " |\n";
-
+        if (!table.row({to_string(i + 1), to_string(a.id), a.plate, a.driverName, shiftName(a.shift)})) break;
         index = (index + 1) % MAX_AMBULANCES;
     }
 
-    cout << "=============================================\n";
+    table.finish(count, "=============================================");
 }
 
 int AmbulanceQueue::size() const {
@@ -123,7 +136,58 @@ void AmbulanceQueue::clear() {
 // ==============================================
 
 AmbulanceManager::AmbulanceManager(const std::string& file)
-    : fileName(file) {}
+    : fileName(file), sharedGeneration(0) {}
+
+// Shared memory: copy the segment into the queue if another process changed it
+void AmbulanceManager::pullShared(bool force) {
+    AmbulanceTable::Layout* seg = shared->get();
+    if (!force && seg->generation == sharedGeneration) return;
+
+    queue.clear();
+    for (int i = 0; i < seg->count; ++i) queue.enqueue(seg->records[i]);
+    sharedGeneration = seg->generation;
+    trackQueue(wallClockMillis());   // ambulances registered or rotated elsewhere
+}
+
+// Follow every scheduled ambulance; known ones only pick up shift changes
+void AmbulanceManager::trackQueue(int64_t now) {
+    Ambulance a;
+    for (int i = 0; i < queue.size(); ++i)
+        if (queue.getAt(i, a)) telemetry.track(a.id, a.shift, now);
+}
+
+// Shared memory: publish the queue (in queue order) after a change
+void AmbulanceManager::pushShared() {
+    AmbulanceTable::Layout* seg = shared->get();
+
+    for (int i = 0; i < queue.size(); ++i) queue.getAt(i, seg->records[i]);
+    seg->count = queue.size();
+    sharedGeneration = ++seg->generation;
+}
+
+bool AmbulanceManager::enableSharedMemory(const string& name) {
+    unique_ptr<AmbulanceTable> table(new AmbulanceTable());
+    string error;
+    if (!table->attach(name, error)) {
+        cout << "[WARNING] Shared memory unavailable (" << error << "). Using private data.\n";
+        return false;
+    }
+
+    shared = move(table);
+    SharedScope<AmbulanceTable> scope(shared.get());
+    if (!shared->get()->loaded) {
+        pushShared();   // first process: seed the segment from our file
+        shared->get()->loaded = 1;
+    } else {
+        pullShared(true);
+    }
+    return true;
+}
+
+void AmbulanceManager::refresh() {
+    SharedScope<AmbulanceTable> scope(shared.get());
+    if (scope.active()) pullShared();
+}
 
 // Helper: check if ID exists in current queue
 bool AmbulanceManager::idExists(int id) const {
@@ -157,7 +221,28 @@ int AmbulanceManager::generateNewID() const {
     return id;
 }
 
+// Ambulance is fixed-width already, so snapshot records are stored as is
+bool AmbulanceManager::loadFromSnapshot() {
+    TraceSpan span("ambulance.loadSnapshot");
+    SnapshotView snap;
+    if (!snap.open<Ambulance>(fileName, SNAPSHOT_AMBULANCE)) return false;
+
+    queue.clear();
+    for (size_t i = 0; i < snap.count(); ++i) {
+        if (!queue.enqueue(snap.record<Ambulance>(i))) break;
+    }
+    return true;
+}
+
 void AmbulanceManager::loadFromFile() {
+    StatTimer timer(STAT_AMBULANCE_LOAD);
+    if (loadFromSnapshot()) {
+        trackQueue(wallClockMillis());
+        cout << "[INFO] Ambulance data loaded from " << snapshotPathFor(fileName) << ".\n";
+        return;
+    }
+
+    TraceSpan span("ambulance.parseCSV");
     ifstream inFile(fileName);
 
     if (!inFile.is_open()) {
@@ -208,15 +293,13 @@ void AmbulanceManager::loadFromFile() {
     }
 
     inFile.close();
+    trackQueue(wallClockMillis());
     cout << "[INFO] Ambulance data loaded from " << fileName << ".\n";
 }
 
 void AmbulanceManager::saveToFile() const {
-    ofstream outFile(fileName);
-    if (!outFile.is_open()) {
-        cerr << "[ERROR] Cannot write to file: " << fileName << "\n";
-        return;
-    }
+    StatTimer timer(STAT_AMBULANCE_SAVE);
+    ostringstream outFile;
 
     Ambulance temp;
     for (int i = 0; i < queue.size(); ++i) {
@@ -228,11 +311,21 @@ void AmbulanceManager::saveToFile() const {
         }
     }
 
-    outFile.close();
-    cout << "[INFO] Ambulance data saved to " << fileName << ".\n";
+    string csv = outFile.str();
+
+    SnapshotWriter snap;
+    for (int i = 0; i < queue.size(); ++i) {
+        if (queue.getAt(i, temp)) snap.addRecord(temp);
+    }
+
+    // Queued on the background writer unless processes share the data
+    bool sync = shared != nullptr;
+    persistFile(fileName, csv, sync);
+    persistFile(snapshotPathFor(fileName), snap.finish<Ambulance>(SNAPSHOT_AMBULANCE, 0, csv), sync);
 }
 
 void AmbulanceManager::registerAmbulance() {
+    TraceSpan span("ambulance.registerAmbulance");
     if (queue.isFull()) {
         cout << "[ERROR] Schedule is full. Cannot register more ambulances.\n";
         return;
@@ -240,6 +333,7 @@ void AmbulanceManager::registerAmbulance() {
 
     Ambulance a;
     memset(&a, 0, sizeof(a));
+    TraceSpan prompt("ambulance.prompt");
 
     // ========== ID input with uniqueness ==========
     while (true) {
@@ -293,14 +387,51 @@ void AmbulanceManager::registerAmbulance() {
     }
     cin.ignore(numeric_limits<streamsize>::max(), '\n');
     a.shift = shiftChoice - 1;
+    prompt.end();
 
-    if (queue.enqueue(a)) cout << "Ambulance registered successfully (ID " << a.id << ").\n";
-    else cerr << "[ERROR] Failed to add ambulance.\n";
+    // Re-checked inside addAmbulance in case another dispatcher took the ID or plate meanwhile
+    string error;
+    if (addAmbulance(a, error)) cout << "Ambulance registered successfully (ID " << a.id << ").\n";
+    else cerr << "[ERROR] Failed to add ambulance: " << error << "\n";
+}
+
+// Register without prompting; validates the same rules as the menu
+bool AmbulanceManager::addAmbulance(Ambulance& a, string& error) {
+    StatTimer timer(STAT_AMBULANCE_REGISTER);
+    SharedScope<AmbulanceTable> scope(shared.get());
+    if (scope.active()) pullShared();
+
+    if (queue.isFull()) { error = "schedule full"; return false; }
+    if (a.id < 0) { error = "id must be positive"; return false; }
+    if (a.id == 0) a.id = generateNewID();
+    else if (idExists(a.id)) { error = "id exists"; return false; }
+
+    if (strlen(a.plate) == 0) { error = "plate empty"; return false; }
+    if (plateExists(a.plate)) { error = "plate exists"; return false; }
+    if (strlen(a.driverName) == 0) { error = "driver empty"; return false; }
+    if (a.shift < 0 || a.shift > 2) { error = "shift must be 1-3"; return false; }
+
+    if (!queue.enqueue(a)) { error = "enqueue failed"; return false; }
+    telemetry.track(a.id, a.shift, wallClockMillis());
+    if (changeLogOn()) logChange("ambulance", "register", changeFields(a));
+    if (scope.active()) pushShared();
+    return true;
 }
 
 void AmbulanceManager::rotateShift() {
+    TraceSpan span("ambulance.rotateShift");
+    if (!rotateAll()) { cout << "[ERROR] No ambulances to rotate.\n"; return; }
+
+    cout << "[INFO] All ambulance shifts rotated (Morning->Afternoon->Midnight->Morning).\n";
+}
+
+bool AmbulanceManager::rotateAll() {
+    StatTimer timer(STAT_AMBULANCE_ROTATE);
+    SharedScope<AmbulanceTable> scope(shared.get());
+    if (scope.active()) pullShared();
+
     int n = queue.size();
-    if (n == 0) { cout << "[ERROR] No ambulances to rotate.\n"; return; }
+    if (n == 0) return false;
 
     vector<Ambulance> tempList; tempList.reserve(n);
     Ambulance tmp;
@@ -310,17 +441,126 @@ void AmbulanceManager::rotateShift() {
         else cerr << "[ERROR] Unexpected dequeue error during rotation.\n";
     }
 
+    int64_t now = wallClockMillis();
     for (const auto& a : tempList) {
         if (!queue.enqueue(a)) cerr << "[ERROR] Failed to enqueue during rotation.\n";
+        telemetry.setShift(a.id, a.shift, now);
     }
+    if (changeLogOn()) logChange("ambulance", "rotate");
 
-    cout << "[INFO] All ambulance shifts rotated (Morning->Afternoon->Midnight->Morning).\n";
+    if (scope.active()) pushShared();
+    return true;
+}
+
+// ==============================================
+//  Fleet states and utilization
+// ==============================================
+bool AmbulanceManager::setState(int id, AmbulanceState& state, string& error, int64_t at) {
+    StatTimer timer(STAT_AMBULANCE_STATUS);
+    SharedScope<AmbulanceTable> scope(shared.get());
+    if (scope.active()) pullShared();
+
+    if (at == 0) at = wallClockMillis();
+    if (!telemetry.transition(id, state, at, error)) return false;
+    if (changeLogOn())
+        logChange("ambulance", "status", ChangeFields{{"id", to_string(id)}, {"state", ambulanceStateName(state)},
+                                                      {"at", to_string(at)}});
+    return true;
+}
+
+void AmbulanceManager::updateStatus() {
+    TraceSpan span("ambulance.updateStatus");
+    if (queue.isEmpty()) { cout << "No ambulances in the schedule.\n"; return; }
+
+    TraceSpan prompt("ambulance.prompt");
+    int id;
+    cout << "Enter Ambulance ID: ";
+    if (!(cin >> id)) {
+        cout << "[ERROR] Please enter a valid number.\n";
+        cin.clear(); cin.ignore(numeric_limits<streamsize>::max(), '\n');
+        return;
+    }
+    AmbulanceState current;
+    if (!telemetry.stateOf(id, current)) { cout << "[ERROR] No ambulance with ID " << id << ".\n"; return; }
+
+    cout << "Currently " << ambulanceStateName(current) << ".\n"
+         << "1. Available\n2. Dispatched\n3. Returning\n4. Off shift\n";
+    int choice = 0;
+    while (true) {
+        cout << "Enter new state (1-4): ";
+        if ((cin >> choice) && choice >= 1 && choice <= 4) break;
+        cout << "[ERROR] Enter 1 - 4 only.\n";
+        cin.clear(); cin.ignore(numeric_limits<streamsize>::max(), '\n');
+    }
+    cin.ignore(numeric_limits<streamsize>::max(), '\n');
+    prompt.end();
+
+    AmbulanceState state = (AmbulanceState)(choice - 1);
+    string error;
+    if (setState(id, state, error)) cout << "[INFO] Ambulance " << id << " is now " << ambulanceStateName(state) << ".\n";
+    else cout << "[ERROR] " << error << ".\n";
+}
+
+static string minutesText(int64_t ms) {
+    ostringstream out;
+    out << fixed << setprecision(1) << ms / 60000.0;
+    return out.str();
+}
+
+static string percentText(double fraction) {
+    ostringstream out;
+    out << fixed << setprecision(1) << fraction * 100 << "%";
+    return out.str();
+}
+
+void AmbulanceManager::displayUtilization() {
+    TraceSpan span("ambulance.displayUtilization");
+    if (queue.isEmpty()) { cout << "No ambulances in the schedule.\n"; return; }
+
+    int64_t now = wallClockMillis();
+    telemetry.catchUp(now);
+
+    TableWriter table(cout, {{"ID", 4, true}, {"Shift", 9, true}, {"State", 10, true}, {"Busy min", 9, true},
+                             {"Idle min", 9, true}, {"Util", 6, true}, {"Moves", 5, true}}, true);
+    table.line("\n============================ Fleet Utilization ===========================");
+    table.header();
+
+    Ambulance a;
+    for (int i = 0; i < queue.size(); ++i) {
+        if (!queue.getAt(i, a)) continue;
+        StateTimes t;
+        uint32_t moves = 0;
+        AmbulanceState state;
+        if (!telemetry.ambulanceTimes(a.id, now, t, &moves) || !telemetry.stateOf(a.id, state)) continue;
+        if (!table.row({to_string(a.id), shiftName(a.shift), ambulanceStateName(state), minutesText(t.busy()),
+                        minutesText(t.idle()), percentText(t.utilization()), to_string(moves)}))
+            break;
+    }
+
+    table.line(string(74, '-'));
+    for (int sh = 0; sh < AMBULANCE_SHIFTS; sh++) {
+        StateTimes t = telemetry.shiftTimes(sh, now);
+        table.line("  " + shiftName(sh) + ": busy " + minutesText(t.busy()) + " min, idle " + minutesText(t.idle()) +
+                   " min, utilization " + percentText(t.utilization()));
+    }
+    StateTimes fleet = telemetry.fleetTimes(now);
+    table.line("  Fleet: " + to_string(telemetry.inState(AMB_AVAILABLE)) + " available, " +
+               to_string(telemetry.inState(AMB_DISPATCHED)) + " dispatched, " +
+               to_string(telemetry.inState(AMB_RETURNING)) + " returning, " +
+               to_string(telemetry.inState(AMB_OFF_SHIFT)) + " off shift; utilization " +
+               percentText(fleet.utilization()));
+    table.finish(queue.size(), string(74, '='));
+}
+
+void AmbulanceManager::exportTelemetry(const string& path) const {
+    persistFile(path, telemetry.series(), false);
 }
 
 // ==============================================
 //  Display sorted schedule in table format
 // ==============================================
 void AmbulanceManager::displaySchedule() const {
+    TraceSpan span("ambulance.displaySchedule");
     if (queue.isEmpty()) { cout << "No ambulances in the schedule.\n"; return; }
 
     vector<Ambulance> v; v.reserve(queue.size());
@@ -331,21 +571,12 @@ void AmbulanceManager::displaySchedule() const {
         if(a.shift!=b.shift) return a.shift < b.shift; return a.id < b.id;
     });
 
-    cout << "\n================ Ambulance Schedule ================\n";
-    cout << "| " << setw(4) << "ID"
-         << " | " << setw(12) << "Plate"
-         << " | " << setw(20) << "Driver"
-         << " | " << setw(9) << "Shift" << " |\n";
-    cout << "----------------------------------------------------\n";
-
-    for (const auto& a : v) {
-        string shiftName = (a.shift == 0 ? "Morning" : (a.shift == 1 ? "Afternoon" : "Midnight"));
-        cout << "| " << setw(4) << a.id
-             << " | " << setw(12) << a.plate
-             << " | " << setw(20) << a.driverName
-             << " | " << setw(9) << shiftName << " |\n";
-    }
-    cout << "====================================================\n";
+    TableWriter table(cout, {{"ID", 4, true}, {"Plate", 12, true}, {"Driver", 20, true}, {"Shift", 9, true}}, true);
+    table.line("\n================ Ambulance Schedule ================");
+    table.header();
+    for (const auto& a : v)
+        if (!table.row({to_string(a.id), a.plate, a.driverName, shiftName(a.shift)})) break;
+    table.finish(v.size(), "====================================================");
 }
 
 // ==============================================
@@ -353,7 +584,6 @@ void AmbulanceManager::displaySchedule() const {
 // ==============================================
 
 void ambulanceMenu(AmbulanceManager& manager) {
-    manager.loadFromFile();
     int choice;
 
     while (true) {
@@ -362,6 +592,9 @@ void ambulanceMenu(AmbulanceManager& manager) {
         cout << "2. Rotate Ambulance Shift (all ambulances shift to next time-slot)\n";
         cout << "3. Display Ambulance Schedule (sorted by shift)\n";
         cout << "4. Show Queue Order (non-sorted, current queue order)\n";
+        cout << "5. Update Ambulance Status (dispatched, returning, ...)\n";
+        cout << "6. Fleet Utilization Report\n";
+        cout << "7. Export Telemetry (" << TELEMETRY_FILE << ")\n";
         cout << "0. Back to Main Menu\n";
         cout << "===============================================\n";
         cout << "Enter choice: ";
@@ -372,20 +605,37 @@ void ambulanceMenu(AmbulanceManager& manager) {
             continue; 
         }
         cin.ignore(numeric_limits<streamsize>::max(), '\n');
+        manager.refresh();
 
         switch (choice) {
             case 1: manager.registerAmbulance(); break;
             case 2: manager.rotateShift(); break;
             case 3: manager.displaySchedule(); break;
             case 4: manager.getQueue().display(); break;
-            case 0: cout << "Returning to main menu...\n"; manager.saveToFile(); return;
+            case 5: manager.updateStatus(); break;
+            case 6: manager.displayUtilization(); break;
+            case 7:
+                manager.exportTelemetry();
+                cout << "[INFO] " << manager.getTelemetry().eventCount() << " transitions written to "
+                     << TELEMETRY_FILE << ".\n";
+                break;
+            case 0:
+                cout << "Returning to main menu...\n";
+                manager.saveToFile();
+                cout << "[INFO] Ambulance data saved.\n";
+                return;
             default: cout << "[ERROR] Invalid choice. Try again.\n";
         }
     }
 }
 
+#ifndef HOSPITAL_SINGLE_PROCESS
 int main() {
+    startRecordingFromEnv("ambulance");
     AmbulanceManager manager;
+    manager.loadFromFile();
+    if (getenv("HOSPITAL_SHM")) manager.enableSharedMemory();
     ambulanceMenu(manager);
     return 0;
-}
\ No newline at end of file
+}
+#endif
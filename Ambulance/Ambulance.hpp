@@ -1,7 +1,12 @@
 #ifndef AMBULANCE_HPP
 #define AMBULANCE_HPP
 
+#include <memory>
 #include <string>
+#include "../Common/SharedTable.hpp"
+#include "../Common/ChangeLog.hpp"
+#include "../Common/Memory.hpp"
+#include "Telemetry.hpp"
 
 struct Ambulance {
     int  id;
@@ -10,7 +15,17 @@ struct Ambulance {
     int  shift; // 0 = Morning, 1 = Afternoon, 2 = Midnight
 };
 
+// Change log line for a registration (see Common/ChangeLog.hpp)
+inline ChangeFields changeFields(const Ambulance& a) {
+    return ChangeFields{{"id", std::to_string(a.id)}, {"plate", a.plate}, {"driver", a.driverName},
+                        {"shift", std::to_string(a.shift)}};
+}
+
 const int MAX_AMBULANCES = 100;
+const std::string AMBULANCE_SHM = "/hospital_ambulance";
+
+// Ambulance is already fixed-layout, so the segment stores it as is
+typedef SharedTable<Ambulance, MAX_AMBULANCES> AmbulanceTable;
 
 class AmbulanceQueue {
 private:
@@ -21,6 +36,9 @@ private:
 
 public:
     AmbulanceQueue();
+    ~AmbulanceQueue();
+    AmbulanceQueue(const AmbulanceQueue& other);
+    AmbulanceQueue& operator=(const AmbulanceQueue& other) = default;
 
     bool isEmpty() const;
     bool isFull() const;
@@ -43,22 +61,53 @@ private:
     AmbulanceQueue queue;
     std::string    fileName;
 
+    // Shared memory mode (null when off)
+    std::unique_ptr<AmbulanceTable> shared;
+    uint64_t       sharedGeneration;
+    void pullShared(bool force = false);
+    void pushShared();
+
+    // States and busy time (see Telemetry.hpp). Kept per process: the
+    // shared segment only holds the schedule.
+    FleetTelemetry telemetry;
+    void trackQueue(int64_t now);
+
 public:
     explicit AmbulanceManager(const std::string& file = "Ambulance/Ambulance.csv");
 
-    void loadFromFile();
-    void saveToFile() const;
+    void loadFromFile();      // prefers the binary snapshot when it is current
+    bool loadFromSnapshot();
+    void saveToFile() const;  // writes the CSV and its snapshot
 
     void registerAmbulance();
     void rotateShift();
     void displaySchedule() const;
 
+    // Non-interactive versions (no prompts). id 0 = auto-generate.
+    bool addAmbulance(Ambulance& a, std::string& error);
+    bool rotateAll();
+
+    // Move an ambulance to another state; `state` comes back as the state
+    // it ended up in (available outside its shift means off shift).
+    // at = 0: now.
+    bool setState(int id, AmbulanceState& state, std::string& error, int64_t at = 0);
+    void updateStatus();
+    void displayUtilization();
+    void exportTelemetry(const std::string& path = TELEMETRY_FILE) const;
+
+    // Keep the queue in a named shared-memory segment so several processes
+    // see the same live schedule. The first process to attach seeds it.
+    bool enableSharedMemory(const std::string& name = AMBULANCE_SHM);
+    void refresh();   // pick up changes made by other processes
+
     bool idExists(int id) const;
     bool plateExists(const std::string& plate) const; // ✅ NEW
     int  generateNewID() const;
 
     AmbulanceQueue&       getQueue()       { return queue; }
     const AmbulanceQueue& getQueue() const { return queue; }
+    FleetTelemetry&       getTelemetry()       { return telemetry; }
+    const FleetTelemetry& getTelemetry() const { return telemetry; }
 };
 
 void ambulanceMenu(AmbulanceManager& manager);
@@ -0,0 +1,306 @@
+#ifndef AMBULANCE_TELEMETRY_HPP
+#define AMBULANCE_TELEMETRY_HPP
+
+#include <cstdint>
+#include <ctime>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "../Common/Memory.hpp"
+
+// =======================================================
+// FLEET TELEMETRY
+// Each ambulance is in one state at a time:
+//   available   on shift, waiting at base
+//   dispatched  on the way to or at a call
+//   returning   heading back to base
+//   off-shift   outside its crew's shift
+//
+// A transition closes the interval the ambulance spent in its old state
+// and adds it to the ambulance's totals and to its shift's totals. The
+// intervals still open are counted per (shift, state) along with the sum
+// of their start times, so the open time of a whole shift is
+// count * now - sum: every figure in a report, per ambulance or per
+// shift, costs O(1) however long the fleet has been running.
+//
+// Busy = dispatched + returning, idle = available, and utilization =
+// busy / (busy + idle); time off shift counts as neither.
+//
+// The last TELEMETRY_MAX_EVENTS transitions are kept as a time series of
+// fleet state counts. series() writes it with times as deltas, one short
+// line per transition:
+//   # start=<epoch ms of the first line>
+//   dt_ms,id,state,available,dispatched,returning,off
+// with state A, D, R or O.
+// =======================================================
+
+enum AmbulanceState { AMB_AVAILABLE = 0, AMB_DISPATCHED, AMB_RETURNING, AMB_OFF_SHIFT, AMB_STATE_COUNT };
+
+const int AMBULANCE_SHIFTS = 3;
+const size_t TELEMETRY_MAX_EVENTS = 65536;
+const std::string TELEMETRY_FILE = "Ambulance/Telemetry.csv";
+
+inline const char* ambulanceStateName(int state) {
+    static const char* names[AMB_STATE_COUNT] = {"available", "dispatched", "returning", "off-shift"};
+    return state >= 0 && state < AMB_STATE_COUNT ? names[state] : "?";
+}
+
+inline bool parseAmbulanceState(const std::string& text, AmbulanceState& out) {
+    for (int s = 0; s < AMB_STATE_COUNT; s++)
+        if (text == ambulanceStateName(s)) { out = (AmbulanceState)s; return true; }
+    return false;
+}
+
+// Crew shift on duty at a wall clock time (local): Morning 4 AM - 12 PM,
+// Afternoon 12 PM - 8 PM, Midnight 8 PM - 4 AM
+inline int shiftAt(int64_t epochMillis) {
+    time_t t = (time_t)(epochMillis / 1000);
+    tm local;
+#ifdef _WIN32
+    localtime_s(&local, &t);
+#else
+    localtime_r(&t, &local);
+#endif
+    int hour = local.tm_hour;
+    return hour >= 4 && hour < 12 ? 0 : (hour >= 12 && hour < 20 ? 1 : 2);
+}
+
+// Milliseconds per state, closed intervals only unless a report added
+// the open ones
+struct StateTimes {
+    int64_t ms[AMB_STATE_COUNT];
+
+    int64_t busy() const { return ms[AMB_DISPATCHED] + ms[AMB_RETURNING]; }
+    int64_t idle() const { return ms[AMB_AVAILABLE]; }
+    double utilization() const {
+        int64_t onShift = busy() + idle();
+        return onShift > 0 ? (double)busy() / (double)onShift : 0.0;
+    }
+};
+
+struct AmbulanceTrack {
+    int            shift;
+    AmbulanceState state;
+    int64_t        since;         // when it entered `state`
+    StateTimes     closed;
+    uint32_t       transitions;
+};
+
+struct TelemetryEvent {
+    int64_t at;
+    int     id;
+    uint8_t state;
+    uint8_t fleet[AMB_STATE_COUNT];   // ambulances in each state afterwards (at most MAX_AMBULANCES)
+};
+
+class FleetTelemetry {
+private:
+    typedef std::unordered_map<int, AmbulanceTrack, std::hash<int>, std::equal_to<int>,
+                               CountingAllocator<std::pair<const int, AmbulanceTrack>, MEM_AMBULANCE_TELEMETRY>> Tracks;
+
+    Tracks     tracks;
+    StateTimes shiftClosed[AMBULANCE_SHIFTS];
+    int        openCount[AMBULANCE_SHIFTS][AMB_STATE_COUNT];
+    int64_t    openSince[AMBULANCE_SHIFTS][AMB_STATE_COUNT];   // sum of `since` of those open intervals
+    int        dutyShift;                                      // -1 until the clock was first read
+    int64_t    dutyChecked;                                    // quarter hour of the last look
+
+    // Ring of the most recent transitions
+    std::vector<TelemetryEvent, CountingAllocator<TelemetryEvent, MEM_AMBULANCE_TELEMETRY>> events;
+    size_t     firstEvent;
+
+    void open(AmbulanceTrack& t, int64_t now) {
+        t.since = now;
+        openCount[t.shift][t.state]++;
+        openSince[t.shift][t.state] += now;
+    }
+
+    void close(AmbulanceTrack& t, int64_t now) {
+        int64_t spent = now > t.since ? now - t.since : 0;
+        t.closed.ms[t.state] += spent;
+        shiftClosed[t.shift].ms[t.state] += spent;
+        openCount[t.shift][t.state]--;
+        openSince[t.shift][t.state] -= t.since;
+    }
+
+    void record(int id, AmbulanceState state, int64_t at) {
+        TelemetryEvent e;
+        e.at = at;
+        e.id = id;
+        e.state = (uint8_t)state;
+        for (int s = 0; s < AMB_STATE_COUNT; s++) e.fleet[s] = (uint8_t)inState((AmbulanceState)s);
+
+        if (events.size() < TELEMETRY_MAX_EVENTS) {
+            events.push_back(e);
+        } else {
+            events[firstEvent] = e;
+            firstEvent = (firstEvent + 1) % events.size();
+        }
+    }
+
+    void move(int id, AmbulanceTrack& t, AmbulanceState state, int64_t now) {
+        close(t, now);
+        t.state = state;
+        t.transitions++;
+        open(t, now);
+        record(id, state, now);
+    }
+
+    // An available crew whose shift ends goes off shift, and an off-shift
+    // crew whose shift starts becomes available; busy crews finish their
+    // call first. O(fleet), but only when the shift on duty changes.
+    void followShifts(int64_t now) {
+        // Every time zone is a whole number of quarter hours from UTC, so
+        // the shift can only change when the quarter hour does
+        int64_t quarter = now / (15 * 60 * 1000);
+        if (dutyShift >= 0 && quarter == dutyChecked) return;
+        dutyChecked = quarter;
+
+        int duty = shiftAt(now);
+        if (duty == dutyShift) return;
+        dutyShift = duty;
+        for (auto& entry : tracks) {
+            AmbulanceTrack& t = entry.second;
+            if (t.state == AMB_AVAILABLE && t.shift != duty) move(entry.first, t, AMB_OFF_SHIFT, now);
+            else if (t.state == AMB_OFF_SHIFT && t.shift == duty) move(entry.first, t, AMB_AVAILABLE, now);
+        }
+    }
+
+    StateTimes withOpen(const StateTimes& closed, int shift, int64_t now) const {
+        StateTimes out = closed;
+        for (int s = 0; s < AMB_STATE_COUNT; s++)
+            out.ms[s] += (int64_t)openCount[shift][s] * now - openSince[shift][s];
+        return out;
+    }
+
+public:
+    FleetTelemetry() : dutyShift(-1), dutyChecked(0), firstEvent(0) {
+        for (int sh = 0; sh < AMBULANCE_SHIFTS; sh++) {
+            shiftClosed[sh] = StateTimes{{0, 0, 0, 0}};
+            for (int s = 0; s < AMB_STATE_COUNT; s++) { openCount[sh][s] = 0; openSince[sh][s] = 0; }
+        }
+    }
+
+    bool tracking(int id) const { return tracks.count(id) > 0; }
+    size_t size() const { return tracks.size(); }
+
+    // Start following an ambulance (on load or registration): available if
+    // its shift is on duty, otherwise off shift. Known IDs only get their
+    // shift updated.
+    void track(int id, int shift, int64_t now) {
+        auto it = tracks.find(id);
+        if (it != tracks.end()) {
+            setShift(id, shift, now);
+            return;
+        }
+        followShifts(now);
+        AmbulanceTrack t;
+        t.shift = shift;
+        t.state = shift == dutyShift ? AMB_AVAILABLE : AMB_OFF_SHIFT;
+        t.closed = StateTimes{{0, 0, 0, 0}};
+        t.transitions = 0;
+        open(t, now);
+        tracks[id] = t;
+        record(id, t.state, now);
+    }
+
+    // Crew moved to another shift (rotation). Time up to now stays with
+    // the old shift.
+    void setShift(int id, int shift, int64_t now) {
+        auto it = tracks.find(id);
+        if (it == tracks.end() || it->second.shift == shift) return;
+        close(it->second, now);
+        it->second.shift = shift;
+        open(it->second, now);
+        followShifts(now);
+        AmbulanceTrack& t = it->second;
+        if (t.state == AMB_AVAILABLE && t.shift != dutyShift) move(id, t, AMB_OFF_SHIFT, now);
+        else if (t.state == AMB_OFF_SHIFT && t.shift == dutyShift) move(id, t, AMB_AVAILABLE, now);
+    }
+
+    // O(1) (apart from a shift change falling due). An ambulance that
+    // becomes available outside its shift goes off shift instead; the
+    // state it ended up in is returned through `state`.
+    bool transition(int id, AmbulanceState& state, int64_t now, std::string& error) {
+        auto it = tracks.find(id);
+        if (it == tracks.end()) { error = "no ambulance " + std::to_string(id); return false; }
+        followShifts(now);
+
+        AmbulanceTrack& t = it->second;
+        if (state == AMB_AVAILABLE && t.shift != dutyShift) state = AMB_OFF_SHIFT;
+        if (t.state == state) { error = std::string("already ") + ambulanceStateName(state); return false; }
+        move(id, t, state, now);
+        return true;
+    }
+
+    bool stateOf(int id, AmbulanceState& out) const {
+        auto it = tracks.find(id);
+        if (it == tracks.end()) return false;
+        out = it->second.state;
+        return true;
+    }
+
+    int inState(AmbulanceState state) const {
+        int n = 0;
+        for (int sh = 0; sh < AMBULANCE_SHIFTS; sh++) n += openCount[sh][state];
+        return n;
+    }
+
+    // ---------- Reports (time up to `now`) ----------
+
+    bool ambulanceTimes(int id, int64_t now, StateTimes& out, uint32_t* transitions = nullptr) const {
+        auto it = tracks.find(id);
+        if (it == tracks.end()) return false;
+        const AmbulanceTrack& t = it->second;
+        out = t.closed;
+        if (now > t.since) out.ms[t.state] += now - t.since;
+        if (transitions != nullptr) *transitions = t.transitions;
+        return true;
+    }
+
+    StateTimes shiftTimes(int shift, int64_t now) const {
+        return withOpen(shiftClosed[shift], shift, now);
+    }
+
+    StateTimes fleetTimes(int64_t now) const {
+        StateTimes total{{0, 0, 0, 0}};
+        for (int sh = 0; sh < AMBULANCE_SHIFTS; sh++) {
+            StateTimes s = shiftTimes(sh, now);
+            for (int st = 0; st < AMB_STATE_COUNT; st++) total.ms[st] += s.ms[st];
+        }
+        return total;
+    }
+
+    // Shift changes that fell due since the last transition are applied
+    // first, so the report is up to date
+    void catchUp(int64_t now) { followShifts(now); }
+
+    size_t eventCount() const { return events.size(); }
+
+    std::string series() const {
+        std::string out;
+        out.reserve(events.size() * 24 + 64);
+        size_t n = events.size();
+        int64_t previous = n > 0 ? events[firstEvent].at : 0;
+        out += "# start=" + std::to_string(previous) + "\n";
+        out += "dt_ms,id,state,available,dispatched,returning,off\n";
+        for (size_t i = 0; i < n; i++) {
+            const TelemetryEvent& e = events[(firstEvent + i) % n];
+            out += std::to_string(e.at - previous);
+            out += ',';
+            out += std::to_string(e.id);
+            out += ',';
+            out += "ADRO"[e.state];
+            for (int s = 0; s < AMB_STATE_COUNT; s++) {
+                out += ',';
+                out += std::to_string(e.fleet[s]);
+            }
+            out += '\n';
+            previous = e.at;
+        }
+        return out;
+    }
+};
+
+#endif // AMBULANCE_TELEMETRY_HPP
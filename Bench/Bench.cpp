@@ -0,0 +1,524 @@
+#include "../Patient/Patient.hpp"
+#include "../Medical/Medical.hpp"
+#include "../Emergency/Emergency.hpp"
+#include "../Emergency/ConcurrentEmergencyQueue.hpp"
+#include "../Ambulance/Ambulance.hpp"
+#include "../Common/Persistence.hpp"
+#include "../Common/Archive.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#define chdir _chdir
+#define getcwd _getcwd
+#define makeDir(path) _mkdir(path)
+#else
+#include <unistd.h>
+#define makeDir(path) mkdir(path, 0755)
+#endif
+
+using namespace std;
+
+// ==============================================
+//  Benchmark suite and synthetic data generator
+// ==============================================
+// For every size, writes a data set laid out like the repository
+// (Patient.csv, Medical/, Emergency/, Ambulance/) into DIR/<rows>/, runs
+// every module against it there, and prints one CSV line per measurement:
+//
+//   module,operation,rows,loaded,ops,total_ms,ns_per_op
+//
+// `rows` is what was generated, `loaded` what the module actually holds
+// afterwards (Medical, Emergency and Ambulance have fixed capacities).
+
+const char* BENCH_NAMES[] = {"Hui Nan", "Jia Yee", "Adam", "Ali", "Rou Yi", "Siti", "John Lim", "Mei Ling"};
+const char* BENCH_CONDITIONS[] = {"High Fever", "Accident Injury", "Heart Attack", "Road Accident",
+                                  "Asthma", "Fracture", "Burn", "Stroke"};
+const char* BENCH_SUPPLIES[] = {"Paracetamol", "Bandage", "Syringe", "Saline", "Gloves", "Insulin"};
+const int BENCH_POOL = 6;   // smallest of the pools above
+
+// ===============================
+// Data generator
+// ===============================
+static bool writeText(const string &path, const string &content) {
+    ofstream out(path, ios::binary);
+    out << content;
+    return out.good();
+}
+
+// Generate all four CSV files for `rows` rows under dir. Any snapshot left
+// from an earlier run is removed so the first load really parses the CSV.
+static bool generateDataset(const string &dir, long rows, unsigned seed) {
+    mt19937 rng(seed);
+    makeDir(dir.c_str());
+    makeDir((dir + "/Medical").c_str());
+    makeDir((dir + "/Emergency").c_str());
+    makeDir((dir + "/Ambulance").c_str());
+
+    ostringstream patients;
+    patients << "ID,Name,Condition\n";
+    for (long i = 1; i <= rows; i++)
+        patients << i << "," << BENCH_NAMES[rng() % BENCH_POOL] << ","
+                 << BENCH_CONDITIONS[rng() % BENCH_POOL] << "\n";
+
+    ostringstream supplies;
+    for (long i = 1; i <= rows; i++)
+        supplies << BENCH_SUPPLIES[rng() % BENCH_POOL] << "," << 1 + rng() % 500
+                 << ",B" << setw(6) << setfill('0') << i << setfill(' ') << "\n";
+
+    ostringstream cases;
+    cases << "ID, Patient Name, Emergency Type, Priority Level\n";
+    for (long i = 1; i <= rows; i++)
+        cases << "P" << setw(3) << setfill('0') << i << setfill(' ') << ", "
+              << BENCH_NAMES[rng() % BENCH_POOL] << ", "
+              << BENCH_CONDITIONS[rng() % BENCH_POOL] << ", " << 1 + rng() % 10 << "\n";
+
+    ostringstream ambulances;
+    for (long i = 1; i <= rows; i++)
+        ambulances << i << ",AMB" << i << "," << BENCH_NAMES[rng() % BENCH_POOL] << "," << rng() % 3 << "\n";
+
+    const string files[4] = {"/Patient.csv", "/Medical/Medical.csv", "/Emergency/Emergency.csv",
+                             "/Ambulance/Ambulance.csv"};
+    const string text[4] = {patients.str(), supplies.str(), cases.str(), ambulances.str()};
+
+    for (int i = 0; i < 4; i++) {
+        remove(snapshotPathFor(dir + files[i]).c_str());
+        if (!writeText(dir + files[i], text[i])) {
+            cerr << "[ERROR] Cannot write " << dir + files[i] << "\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+// ===============================
+// Measurement helpers
+// ===============================
+static ostream* csvOut = &cout;
+
+static double millisSince(chrono::steady_clock::time_point start) {
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+static void report(const string &module, const string &operation, long rows, int loaded,
+                   long ops, double millis) {
+    *csvOut << module << "," << operation << "," << rows << "," << loaded << "," << ops << ","
+            << fixed << setprecision(3) << millis << ","
+            << setprecision(1) << (ops > 0 ? millis * 1e6 / ops : 0) << "\n";
+    csvOut->unsetf(ios::floatfield);
+    csvOut->flush();
+}
+
+// The modules print progress and listings; keep that out of the results
+class Quiet {
+private:
+    ostringstream sink;
+    streambuf* savedOut;
+    streambuf* savedErr;
+
+public:
+    Quiet() : savedOut(cout.rdbuf(sink.rdbuf())), savedErr(cerr.rdbuf(sink.rdbuf())) {}
+    ~Quiet() {
+        cout.rdbuf(savedOut);
+        cerr.rdbuf(savedErr);
+    }
+};
+
+// Live bytes a module holds once loaded (the patient registry is shared
+// by every size run in this process, so it only grows)
+static void reportMemory(const string &module, MemoryModule which, long rows, int loaded) {
+    int64_t bytes = MemoryRegistry::instance().moduleBytes(which);
+    cerr << "[INFO] " << module << " memory at " << rows << " rows: " << bytes << " B live, "
+         << (loaded > 0 ? bytes / loaded : 0) << " B/record\n";
+}
+
+// Saves are queued on the background writer; a save is only finished
+// once its files are on disk
+static void waitForDisk() {
+    PersistenceWriter::instance().barrier();
+}
+
+// ===============================
+// Patient (persistent FIFO queue)
+// ===============================
+static void benchPatient(long rows, long ops) {
+    double loadMs, saveMs, snapMs;
+    int loaded;
+    {
+        PatientQueue pq;
+        auto t = chrono::steady_clock::now();
+        { Quiet q; pq.loadFromCSV("Patient.csv"); }
+        loadMs = millisSince(t);
+        loaded = pq.count();
+
+        t = chrono::steady_clock::now();
+        pq.saveToCSV("Patient.csv");
+        waitForDisk();
+        saveMs = millisSince(t);
+    }
+    report("patient", "load_csv", rows, loaded, 1, loadMs);
+    report("patient", "save", rows, loaded, 1, saveMs);
+
+    PatientQueue pq;
+    auto t = chrono::steady_clock::now();
+    { Quiet q; pq.loadFromCSV("Patient.csv"); }
+    snapMs = millisSince(t);
+    report("patient", "load_snapshot", rows, pq.count(), 1, snapMs);
+    reportMemory("patient", MEM_MODULE_PATIENT, rows, pq.count());
+
+    t = chrono::steady_clock::now();
+    for (long i = 0; i < ops; i++)
+        pq.admitNext("Bench Patient", "Checkup", false);
+    report("patient", "admitPatient", rows, pq.count(), ops, millisSince(t));
+
+    // Spread over the whole queue, not just the front
+    vector<int> ids;
+    PatientVersion waiting = pq.version();
+    size_t step = waiting.size() / (size_t)ops > 0 ? waiting.size() / (size_t)ops : 1;
+    for (size_t i = step / 2; i < waiting.size() && ids.size() < (size_t)ops; i += step)
+        ids.push_back(waiting.at(i).id);
+
+    Patient out;
+    t = chrono::steady_clock::now();
+    for (int id : ids)
+        pq.removeByID(id, out, false);
+    report("patient", "removeByID", rows, pq.count(), (long)ids.size(), millisSince(t));
+
+    t = chrono::steady_clock::now();
+    for (long i = 0; i < ops; i++)
+        pq.dischargeFront(out, false);
+    report("patient", "dischargePatient", rows, pq.count(), ops, millisSince(t));
+}
+
+// ===============================
+// Medical (persistent stack, fixed capacity)
+// ===============================
+static void benchMedical(long rows, long ops) {
+    auto t = chrono::steady_clock::now();
+    unique_ptr<MedicalSupplyManager> m;
+    { Quiet q; m.reset(new MedicalSupplyManager()); }
+    report("medical", "load_csv", rows, m->count(), 1, millisSince(t));
+
+    t = chrono::steady_clock::now();
+    m->saveToCSV();
+    waitForDisk();
+    report("medical", "save", rows, m->count(), 1, millisSince(t));
+
+    t = chrono::steady_clock::now();
+    { Quiet q; m.reset(new MedicalSupplyManager()); }
+    report("medical", "load_snapshot", rows, m->count(), 1, millisSince(t));
+    reportMemory("medical", MEM_MODULE_MEDICAL, rows, m->count());
+
+    // The stack is bounded, so pushes and pops alternate in full/empty rounds
+    Supply s = {"Bench Supply", 1, "B000000"};
+    Supply out;
+    double pushMs = 0, popMs = 0;
+    long pushes = 0, pops = 0;
+    while (pushes < ops) {
+        t = chrono::steady_clock::now();
+        while (pushes < ops && m->pushSupply(s, false)) pushes++;
+        pushMs += millisSince(t);
+
+        t = chrono::steady_clock::now();
+        while (m->popSupply(out, false)) pops++;
+        popMs += millisSince(t);
+    }
+    report("medical", "addSupply", rows, m->count(), pushes, pushMs);
+    report("medical", "useLastSupply", rows, m->count(), pops, popMs);
+}
+
+// ===============================
+// Emergency (persistent list, linear scan for the most critical case)
+// ===============================
+static void benchEmergency(long rows, long ops) {
+    auto t = chrono::steady_clock::now();
+    unique_ptr<EmergencyManager> e;
+    { Quiet q; e.reset(new EmergencyManager()); }
+    report("emergency", "load_csv", rows, e->count(), 1, millisSince(t));
+
+    t = chrono::steady_clock::now();
+    e->saveToCSV();
+    waitForDisk();
+    report("emergency", "save", rows, e->count(), 1, millisSince(t));
+
+    t = chrono::steady_clock::now();
+    { Quiet q; e.reset(new EmergencyManager()); }
+    report("emergency", "load_snapshot", rows, e->count(), 1, millisSince(t));
+    reportMemory("emergency", MEM_MODULE_EMERGENCY, rows, e->count());
+    int loaded = e->count();
+
+    long views = ops / 100 + 1;   // each view formats the whole list
+    t = chrono::steady_clock::now();
+    {
+        Quiet q;
+        for (long i = 0; i < views; i++) e->viewCases();
+    }
+    report("emergency", "viewCases", rows, loaded, views, millisSince(t));
+
+    // Drain first: the list is bounded, and a full list rejects every add
+    mt19937 rng(7);
+    Emergency out;
+    double addMs = 0, popMs = 0;
+    long adds = 0, pops = 0;
+    while (adds < ops) {
+        t = chrono::steady_clock::now();
+        while (e->popCritical(out, false)) pops++;
+        popMs += millisSince(t);
+
+        t = chrono::steady_clock::now();
+        while (adds < ops && e->addCase("Bench Patient", "Checkup", 1 + rng() % 10, false) != "") adds++;
+        addMs += millisSince(t);
+    }
+    report("emergency", "logCase", rows, e->count(), adds, addMs);
+    report("emergency", "processCritical", rows, e->count(), pops, popMs);
+
+    // Dispatch board: one intake thread logging, N officers taking the
+    // most critical case; total time for `ops` cases through the board
+    Emergency walkIn = out;
+    for (int officers = 1; officers <= 8; officers *= 2) {
+        ConcurrentEmergencyQueue board;
+        atomic<long> taken(0);
+        t = chrono::steady_clock::now();
+        thread intake([&] {
+            Emergency c = walkIn;
+            for (long i = 0; i < ops; i++) {
+                c.priority = 1 + (int)(i % 10);
+                while (!board.logCase(c)) this_thread::yield();   // full: wait for the officers
+                // Well inside a level's change ring, or officers would wait
+                if (board.unapplied() > 256) board.applyTo([](const Emergency &) {}, [](const Emergency &) {});
+            }
+        });
+        vector<thread> crew;
+        for (int o = 0; o < officers; o++)
+            crew.emplace_back([&] {
+                Emergency c;
+                while (taken.load(memory_order_relaxed) < ops) {
+                    if (board.popCritical(c)) taken.fetch_add(1, memory_order_relaxed);
+                    else this_thread::yield();
+                }
+            });
+        intake.join();
+        for (thread &c : crew) c.join();
+        report("emergency", "boardProcess/" + to_string(officers), rows, board.count(), ops, millisSince(t));
+    }
+}
+
+// ===============================
+// Ambulance (circular queue)
+// ===============================
+static void benchAmbulance(long rows, long ops) {
+    AmbulanceManager a;
+    auto t = chrono::steady_clock::now();
+    { Quiet q; a.loadFromFile(); }
+    report("ambulance", "load_csv", rows, a.getQueue().size(), 1, millisSince(t));
+
+    t = chrono::steady_clock::now();
+    a.saveToFile();
+    waitForDisk();
+    report("ambulance", "save", rows, a.getQueue().size(), 1, millisSince(t));
+
+    t = chrono::steady_clock::now();
+    { Quiet q; a.loadFromFile(); }
+    report("ambulance", "load_snapshot", rows, a.getQueue().size(), 1, millisSince(t));
+    reportMemory("ambulance", MEM_MODULE_AMBULANCE, rows, a.getQueue().size());
+    int loaded = a.getQueue().size();
+
+    t = chrono::steady_clock::now();
+    for (long i = 0; i < ops; i++) a.rotateAll();
+    report("ambulance", "rotate", rows, loaded, ops, millisSince(t));
+
+    mt19937 rng(11);
+    long found = 0;
+    t = chrono::steady_clock::now();
+    for (long i = 0; i < ops; i++) found += a.idExists(1 + (int)(rng() % (2 * MAX_AMBULANCES)));
+    report("ambulance", "idExists", rows, loaded, ops, millisSince(t));
+
+    long idSum = 0;
+    t = chrono::steady_clock::now();
+    for (long i = 0; i < ops; i++) idSum += a.generateNewID();
+    report("ambulance", "generateNewID", rows, loaded, ops, millisSince(t));
+
+    // Queue is bounded: dequeue everything, then enqueue it back
+    AmbulanceQueue &q = a.getQueue();
+    vector<Ambulance> held;
+    Ambulance tmp;
+    double enqMs = 0;
+    long enqs = 0;
+    while (enqs < ops) {
+        while (!q.isEmpty() && q.dequeue(tmp)) held.push_back(tmp);
+        if (held.empty()) break;
+
+        t = chrono::steady_clock::now();
+        for (const Ambulance &x : held) {
+            if (enqs >= ops) break;
+            q.enqueue(x);
+            enqs++;
+        }
+        enqMs += millisSince(t);
+        held.clear();
+    }
+    report("ambulance", "enqueue", rows, loaded, enqs, enqMs);
+
+    // Keep the compiler from dropping the lookups
+    if (found < 0 || idSum < 0) cerr << "";
+}
+
+// ===============================
+// Archive (columnar blocks + text tail)
+// ===============================
+// `rows` departures spread over a year, then the kinds of query the
+// archive command runs: everything, one day, one type, one priority.
+// For queries `loaded` is the number of matching rows.
+static void benchArchive(long rows) {
+    const string path = "Bench.archive";
+    remove(path.c_str());
+    remove((path + ".tail").c_str());
+
+    const int64_t start = 1767225600000LL;   // 2026-01-01 UTC
+    const int64_t step = 365LL * 24 * 3600 * 1000 / rows;
+    mt19937 rng(5);
+
+    vector<ArchivedRecord> batch;
+    batch.reserve(10000);
+    RecordArchive archive(path);
+    double appendMs = 0;
+    for (long i = 0; i < rows; i++) {
+        int64_t removedAt = start + i * step;
+        batch.push_back(ArchivedRecord{removedAt, removedAt - (int64_t)(rng() % 7200000), i + 1,
+                                       1 + (int)(rng() % 10), BENCH_CONDITIONS[rng() % 8],
+                                       "Patient " + to_string(rng() % 5000)});
+        if (batch.size() == 10000 || i + 1 == rows) {
+            auto t = chrono::steady_clock::now();
+            archive.appendAll(batch);
+            appendMs += millisSince(t);
+            batch.clear();
+        }
+    }
+    archive.seal();
+    report("archive", "append", rows, (int)rows, rows, appendMs);
+
+    struct stat st;
+    if (stat(path.c_str(), &st) == 0)
+        cerr << "[INFO] Archive of " << rows << " rows: " << st.st_size << " bytes ("
+             << fixed << setprecision(1) << (double)st.st_size / rows << " per row)\n";
+    cerr.unsetf(ios::floatfield);
+
+    ArchiveQuery all;
+    ArchiveQuery oneDay;
+    oneDay.from = start + 180LL * 24 * 3600 * 1000;
+    oneDay.to = oneDay.from + 24LL * 3600 * 1000;
+    ArchiveQuery oneType;
+    oneType.type = "Stroke";
+    ArchiveQuery onePriority;
+    onePriority.priority = 1;
+
+    const ArchiveQuery *queries[] = {&all, &oneDay, &oneType, &onePriority};
+    const char *const names[] = {"query_all", "query_day", "query_type", "query_priority"};
+    for (int i = 0; i < 4; i++) {
+        auto t = chrono::steady_clock::now();
+        ArchiveResult r = archive.query(*queries[i]);
+        report("archive", names[i], rows, (int)r.matched, 1, millisSince(t));
+    }
+}
+
+// ===============================
+// Main Program
+// ===============================
+static void printUsage() {
+    cout << "Usage:\n"
+         << "  Bench [--sizes N,N,...] [--ops N] [--dir DIR] [--out FILE]\n"
+         << "        run every module at each size (default 1000,...,10000000)\n"
+         << "  Bench --generate N [--dir DIR]\n"
+         << "        only write an N-row data set to DIR (default bench_data/N)\n"
+         << "\nResults are CSV: module,operation,rows,loaded,ops,total_ms,ns_per_op\n";
+}
+
+static vector<long> parseSizes(const string &list) {
+    vector<long> sizes;
+    stringstream ss(list);
+    string item;
+    while (getline(ss, item, ',')) {
+        long n = atol(item.c_str());
+        if (n > 0) sizes.push_back(n);
+    }
+    return sizes;
+}
+
+int main(int argc, char *argv[]) {
+    vector<long> sizes = {1000, 10000, 100000, 1000000, 10000000};
+    long ops = 100000;
+    string dir = "bench_data";
+    string outFile;
+    long generateOnly = 0;
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--sizes" && i + 1 < argc) sizes = parseSizes(argv[++i]);
+        else if (arg == "--ops" && i + 1 < argc) ops = atol(argv[++i]);
+        else if (arg == "--dir" && i + 1 < argc) dir = argv[++i];
+        else if (arg == "--out" && i + 1 < argc) outFile = argv[++i];
+        else if (arg == "--generate" && i + 1 < argc) generateOnly = atol(argv[++i]);
+        else {
+            printUsage();
+            return arg == "--help" ? 0 : 2;
+        }
+    }
+    if (ops < 1) ops = 1;
+
+    if (generateOnly > 0) {
+        if (!generateDataset(dir == "bench_data" ? dir + "/" + to_string(generateOnly) : dir,
+                             generateOnly, 42)) {
+            return 1;
+        }
+        return 0;
+    }
+
+    ofstream file;
+    if (!outFile.empty()) {
+        file.open(outFile);
+        if (!file.is_open()) {
+            cerr << "[ERROR] Cannot write to file: " << outFile << "\n";
+            return 2;
+        }
+        csvOut = &file;
+    }
+
+    char home[4096];
+    if (getcwd(home, sizeof(home)) == nullptr) return 2;
+    makeDir(dir.c_str());
+
+    *csvOut << "module,operation,rows,loaded,ops,total_ms,ns_per_op\n";
+
+    for (long rows : sizes) {
+        string setDir = dir + "/" + to_string(rows);
+        cerr << "[INFO] Generating " << rows << " rows in " << setDir << "...\n";
+        if (!generateDataset(setDir, rows, 42)) return 1;
+
+        // The modules open their files relative to the working directory
+        if (chdir(setDir.c_str()) != 0) {
+            cerr << "[ERROR] Cannot enter " << setDir << "\n";
+            return 1;
+        }
+        benchPatient(rows, ops);
+        benchMedical(rows, ops);
+        benchEmergency(rows, ops);
+        benchAmbulance(rows, ops);
+        benchArchive(rows);
+        waitForDisk();
+        if (chdir(home) != 0) return 1;
+    }
+    return 0;
+}
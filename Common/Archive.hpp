@@ -0,0 +1,642 @@
+#ifndef ARCHIVE_HPP
+#define ARCHIVE_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <limits>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <sys/file.h>
+#include <unistd.h>
+#endif
+
+// ==============================================
+//  Archive of discharged / processed records
+// ==============================================
+// Records leaving a queue are appended here instead of disappearing, so
+// history can be queried without keeping it in the live CSVs. The
+// managers append a row only once its departure can no longer be undone
+// (it left the undo history, or the program ended), so an undone
+// discharge is never archived.
+//
+// New rows go to a small text tail (X.tail, one line per row). Once the
+// tail passes ARCHIVE_TAIL_BYTES it is sealed: encoded as one columnar
+// block and appended to the archive file X, then emptied.
+//
+// Block layout:
+//
+//   ArchiveBlockHeader               row count, min/max time and priority,
+//                                    byte length of every section
+//   type dictionary                  distinct condition/type strings
+//   name dictionary                  distinct names
+//   id column                        zigzag varint deltas
+//   removedAt column                 zigzag varint deltas (ms)
+//   wait column                      varint ms (removedAt - enqueuedAt)
+//   priority column                  varint
+//   type column                      varint dictionary codes
+//   name column                      varint dictionary codes
+//
+// A query reads only block headers for blocks whose time or priority range
+// can't match, only the type dictionary when the requested type isn't in
+// the block, and only the columns it needs otherwise.
+//
+// Appends, seals and queries hold a flock on the tail, so separate module
+// processes can share one archive.
+//
+// Crashes: since version 2 a block header is followed by an
+// ArchiveBlockCheck with a checksum of the block body and of the tail
+// text it was sealed from. A seal first cuts the archive back to its last
+// whole block (a torn block from a crash mid-write), and drops tail rows
+// the last block already holds (a crash between writing the block and
+// emptying the tail); queries skip such rows too. Version 1 blocks are
+// still read.
+
+const uint32_t ARCHIVE_MAGIC      = 0x43524148;   // "HARC"
+const uint32_t ARCHIVE_VERSION    = 2;            // 2: ArchiveBlockCheck
+const long     ARCHIVE_TAIL_BYTES = 256 * 1024;   // about 5000 rows per block
+
+// Off on a standby: the primary archives (and counts the wait of) every
+// departure the standby repeats. Checked when a departure happens, so
+// one repeated before a promotion is never recorded after it.
+inline std::atomic<bool>& departuresRecorded() {
+    static std::atomic<bool> on(true);
+    return on;
+}
+
+struct ArchivedRecord {
+    int64_t     removedAt;    // wall clock ms when it left the queue
+    int64_t     enqueuedAt;   // wall clock ms when it joined
+    int64_t     id;
+    int32_t     priority;     // 0 when the queue has no priorities
+    std::string type;         // condition or emergency type
+    std::string name;
+};
+
+enum ArchiveColumn { COL_ID = 0, COL_REMOVED, COL_WAIT, COL_PRIORITY, COL_TYPE, COL_NAME, ARCHIVE_COLUMNS };
+
+struct ArchiveBlockHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t rows;
+    int32_t  minPriority;
+    int64_t  minRemovedAt;
+    int64_t  maxRemovedAt;
+    int32_t  maxPriority;
+    uint32_t typeDictBytes;
+    uint32_t nameDictBytes;
+    uint32_t columnBytes[ARCHIVE_COLUMNS];
+};
+
+struct ArchiveBlockCheck {
+    uint64_t bodyChecksum;   // archiveChecksum() of everything after this
+    uint64_t tailBytes;      // the tail text the block was sealed from:
+    uint64_t tailChecksum;   // its length and checksum
+};
+
+// Filter; an empty type or priority < 0 matches everything
+struct ArchiveQuery {
+    int64_t     from     = std::numeric_limits<int64_t>::min();
+    int64_t     to       = std::numeric_limits<int64_t>::max();
+    std::string type;
+    int         priority = -1;
+    size_t      limit    = 0;   // matching rows to return (totals cover all)
+};
+
+struct ArchiveResult {
+    uint64_t matched       = 0;
+    uint64_t rowsScanned   = 0;   // rows whose columns were decoded
+    uint64_t blocks        = 0;
+    uint64_t blocksSkipped = 0;   // ruled out by header or dictionary
+    double   totalWaitSeconds = 0;
+    double   maxWaitSeconds   = 0;
+    double   millis           = 0;
+    std::vector<ArchivedRecord> rows;
+};
+
+// ===============================
+// Encoding helpers
+// ===============================
+inline void putVarint(std::string &out, uint64_t v) {
+    while (v >= 0x80) {
+        out.push_back((char)(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back((char)v);
+}
+
+inline uint64_t getVarint(const char *&p, const char *end) {
+    uint64_t v = 0;
+    int shift = 0;
+    while (p < end) {
+        uint8_t b = (uint8_t)*p++;
+        v |= (uint64_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) break;
+        shift += 7;
+    }
+    return v;
+}
+
+// FNV-1a, 64-bit
+inline uint64_t archiveChecksum(const char *data, size_t size) {
+    uint64_t h = 14695981039346656037ULL;
+    for (size_t i = 0; i < size; i++) {
+        h ^= (unsigned char)data[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+inline uint64_t zigzag(int64_t v) { return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63); }
+inline int64_t unzigzag(uint64_t v) { return (int64_t)(v >> 1) ^ -(int64_t)(v & 1); }
+
+// "2026-10-19 14:05:00" in local time
+inline std::string formatMillis(int64_t ms) {
+    time_t secs = (time_t)(ms / 1000);
+    struct tm local;
+#ifdef _WIN32
+    localtime_s(&local, &secs);
+#else
+    localtime_r(&secs, &local);
+#endif
+    char buffer[32];
+    strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", &local);
+    return buffer;
+}
+
+// Epoch ms, or "YYYY-MM-DD[ HH:MM[:SS]]" in local time. A bare date used
+// as the end of a range (endOfDay) covers that whole day.
+inline bool parseTimeArg(const std::string &text, bool endOfDay, int64_t &out) {
+    if (text.empty()) return false;
+    if (text.find_first_not_of("0123456789") == std::string::npos) {
+        out = atoll(text.c_str());
+        return true;
+    }
+
+    struct tm t;
+    memset(&t, 0, sizeof(t));
+    int fields = sscanf(text.c_str(), "%d-%d-%d %d:%d:%d", &t.tm_year, &t.tm_mon, &t.tm_mday,
+                        &t.tm_hour, &t.tm_min, &t.tm_sec);
+    if (fields < 3) return false;
+    t.tm_year -= 1900;
+    t.tm_mon -= 1;
+    t.tm_isdst = -1;
+    time_t secs = mktime(&t);
+    if (secs == (time_t)-1) return false;
+
+    out = (int64_t)secs * 1000;
+    if (fields == 3 && endOfDay) out += 24 * 3600 * 1000LL - 1;
+    else if (endOfDay) out += fields == 5 ? 59999 : 999;
+    return true;
+}
+
+class RecordArchive {
+private:
+    std::string path;
+    std::string tailPath;
+
+    // flock on the tail; a no-op where flock doesn't exist
+    static void lockFile(FILE *f, bool exclusive) {
+#ifndef _WIN32
+        flock(fileno(f), exclusive ? LOCK_EX : LOCK_SH);
+#else
+        (void)f; (void)exclusive;
+#endif
+    }
+
+    static void unlockFile(FILE *f) {
+#ifndef _WIN32
+        flock(fileno(f), LOCK_UN);
+#else
+        (void)f;
+#endif
+    }
+
+    static std::string clean(const std::string &s) {
+        std::string out = s;
+        for (char &c : out)
+            if (c == '\t' || c == '\n' || c == '\r') c = ' ';
+        return out;
+    }
+
+    static std::string tailLine(const ArchivedRecord &r) {
+        return std::to_string(r.removedAt) + "\t" + std::to_string(r.enqueuedAt) + "\t" +
+               std::to_string(r.id) + "\t" + std::to_string(r.priority) + "\t" +
+               clean(r.type) + "\t" + clean(r.name) + "\n";
+    }
+
+    // Complete lines only: a row being written by someone else has no '\n' yet.
+    // A line without all six fields (cut short by a crash) is skipped.
+    static void parseTail(const std::string &text, std::vector<ArchivedRecord> &rows) {
+        size_t start = 0;
+        while (true) {
+            size_t end = text.find('\n', start);
+            if (end == std::string::npos) break;
+            if (std::count(text.begin() + (long)start, text.begin() + (long)end, '\t') != 5) {
+                start = end + 1;
+                continue;
+            }
+
+            const char *p = text.c_str() + start;
+            ArchivedRecord r;
+            char *next;
+            bool ok = true;
+            r.removedAt = strtoll(p, &next, 10);
+            ok = ok && *next == '\t';
+            if (ok) r.enqueuedAt = strtoll(next + 1, &next, 10);
+            ok = ok && *next == '\t';
+            if (ok) r.id = strtoll(next + 1, &next, 10);
+            ok = ok && *next == '\t';
+            if (ok) r.priority = (int32_t)strtol(next + 1, &next, 10);
+            size_t typeStart = (size_t)(next + 1 - text.c_str());
+            size_t typeEnd = text.find('\t', typeStart);
+            if (ok && *next == '\t' && typeEnd != std::string::npos && typeEnd < end) {
+                r.type = text.substr(typeStart, typeEnd - typeStart);
+                r.name = text.substr(typeEnd + 1, end - typeEnd - 1);
+                rows.push_back(r);
+            }
+            start = end + 1;
+        }
+    }
+
+    static bool truncateFile(FILE *f, long size) {
+        fflush(f);
+#ifdef _WIN32
+        return _chsize(_fileno(f), size) == 0;
+#else
+        return ftruncate(fileno(f), size) == 0;
+#endif
+    }
+
+    static bool knownVersion(const ArchiveBlockHeader &h) {
+        return h.magic == ARCHIVE_MAGIC && (h.version == 1 || h.version == ARCHIVE_VERSION);
+    }
+
+    static uint64_t bodyBytesOf(const ArchiveBlockHeader &h) {
+        uint64_t bytes = (uint64_t)h.typeDictBytes + h.nameDictBytes;
+        for (int c = 0; c < ARCHIVE_COLUMNS; c++) bytes += h.columnBytes[c];
+        return bytes;
+    }
+
+    // Length of the archive up to its last whole block, and that block's
+    // check (haveCheck false for none or version 1). Only the last block's
+    // body is read: a crash can only have torn the end.
+    static long committedLength(FILE *f, ArchiveBlockCheck &last, bool &haveCheck) {
+        fseek(f, 0, SEEK_END);
+        long size = ftell(f);
+        long at = 0, lastAt = 0, lastBody = 0;
+        ArchiveBlockHeader h;
+        ArchiveBlockCheck check, before;
+        bool checked = false, checkedBefore = false;
+        while (fseek(f, at, SEEK_SET) == 0 && fread(&h, sizeof(h), 1, f) == 1 && knownVersion(h)) {
+            long headBytes = (long)sizeof(h);
+            bool hasCheck = h.version >= 2;
+            ArchiveBlockCheck c = ArchiveBlockCheck();
+            if (hasCheck) {
+                if (fread(&c, sizeof(c), 1, f) != 1) break;
+                headBytes += (long)sizeof(c);
+            }
+            uint64_t body = bodyBytesOf(h);
+            if ((uint64_t)(size - at - headBytes) < body) break;   // cut short
+            before = check;
+            checkedBefore = checked;
+            check = c;
+            checked = hasCheck;
+            lastAt = at;
+            lastBody = (long)body;
+            at += headBytes + (long)body;
+        }
+
+        if (checked) {
+            std::string body((size_t)lastBody, '\0');
+            bool whole = fseek(f, at - lastBody, SEEK_SET) == 0 &&
+                         fread(&body[0], 1, body.size(), f) == body.size() &&
+                         archiveChecksum(body.data(), body.size()) == check.bodyChecksum;
+            if (!whole) {   // garbage that happens to look like a header
+                at = lastAt;
+                check = before;
+                checked = checkedBefore;
+            }
+        }
+        last = check;
+        haveCheck = checked;
+        return at;
+    }
+
+    // Bytes at the start of the tail that the last block was sealed from
+    static size_t sealedPrefix(const std::string &tail, const ArchiveBlockCheck &last, bool haveCheck) {
+        if (!haveCheck || last.tailBytes == 0 || last.tailBytes > tail.size()) return 0;
+        return archiveChecksum(tail.data(), (size_t)last.tailBytes) == last.tailChecksum ? (size_t)last.tailBytes : 0;
+    }
+
+    static std::string readAll(FILE *f) {
+        std::string text;
+        fseek(f, 0, SEEK_END);
+        long size = ftell(f);
+        if (size > 0) {
+            text.resize((size_t)size);
+            fseek(f, 0, SEEK_SET);
+            text.resize(fread(&text[0], 1, (size_t)size, f));
+        }
+        return text;
+    }
+
+    static void encodeDictionary(std::string &out, const std::vector<std::string> &words) {
+        putVarint(out, words.size());
+        for (const std::string &w : words) {
+            putVarint(out, w.size());
+            out += w;
+        }
+    }
+
+    static std::vector<std::string> decodeDictionary(const char *p, const char *end) {
+        std::vector<std::string> words((size_t)getVarint(p, end));
+        for (std::string &w : words) {
+            size_t n = (size_t)getVarint(p, end);
+            if (n > (size_t)(end - p)) n = (size_t)(end - p);
+            w.assign(p, n);
+            p += n;
+        }
+        return words;
+    }
+
+    // One block for the given rows (all in one call so min/max are exact),
+    // sealed from tailText
+    static std::string encodeBlock(const std::vector<ArchivedRecord> &rows, const std::string &tailText) {
+        ArchiveBlockHeader h;
+        memset(&h, 0, sizeof(h));
+        h.magic = ARCHIVE_MAGIC;
+        h.version = ARCHIVE_VERSION;
+        h.rows = (uint32_t)rows.size();
+        h.minRemovedAt = std::numeric_limits<int64_t>::max();
+        h.maxRemovedAt = std::numeric_limits<int64_t>::min();
+        h.minPriority = std::numeric_limits<int32_t>::max();
+        h.maxPriority = std::numeric_limits<int32_t>::min();
+
+        std::vector<std::string> typeWords, nameWords;
+        std::unordered_map<std::string, uint32_t> typeCodes, nameCodes;
+        std::string columns[ARCHIVE_COLUMNS];
+        int64_t prevID = 0, prevRemoved = 0;
+
+        for (const ArchivedRecord &r : rows) {
+            if (r.removedAt < h.minRemovedAt) h.minRemovedAt = r.removedAt;
+            if (r.removedAt > h.maxRemovedAt) h.maxRemovedAt = r.removedAt;
+            if (r.priority < h.minPriority) h.minPriority = r.priority;
+            if (r.priority > h.maxPriority) h.maxPriority = r.priority;
+
+            auto type = typeCodes.emplace(r.type, (uint32_t)typeWords.size());
+            if (type.second) typeWords.push_back(r.type);
+            auto name = nameCodes.emplace(r.name, (uint32_t)nameWords.size());
+            if (name.second) nameWords.push_back(r.name);
+
+            putVarint(columns[COL_ID], zigzag(r.id - prevID));
+            putVarint(columns[COL_REMOVED], zigzag(r.removedAt - prevRemoved));
+            putVarint(columns[COL_WAIT], zigzag(r.removedAt - r.enqueuedAt));
+            putVarint(columns[COL_PRIORITY], zigzag(r.priority));
+            putVarint(columns[COL_TYPE], type.first->second);
+            putVarint(columns[COL_NAME], name.first->second);
+            prevID = r.id;
+            prevRemoved = r.removedAt;
+        }
+
+        std::string typeDict, nameDict;
+        encodeDictionary(typeDict, typeWords);
+        encodeDictionary(nameDict, nameWords);
+        h.typeDictBytes = (uint32_t)typeDict.size();
+        h.nameDictBytes = (uint32_t)nameDict.size();
+        for (int c = 0; c < ARCHIVE_COLUMNS; c++) h.columnBytes[c] = (uint32_t)columns[c].size();
+
+        std::string body = typeDict + nameDict;
+        for (int c = 0; c < ARCHIVE_COLUMNS; c++) body += columns[c];
+        ArchiveBlockCheck check;
+        check.bodyChecksum = archiveChecksum(body.data(), body.size());
+        check.tailBytes = tailText.size();
+        check.tailChecksum = archiveChecksum(tailText.data(), tailText.size());
+
+        std::string block((const char*)&h, sizeof(h));
+        block.append((const char*)&check, sizeof(check));
+        return block + body;
+    }
+
+    static bool matches(const ArchiveQuery &q, int64_t removedAt, int32_t priority) {
+        return removedAt >= q.from && removedAt <= q.to && (q.priority < 0 || priority == q.priority);
+    }
+
+    static void count(ArchiveResult &result, const ArchiveQuery &q, const ArchivedRecord &r) {
+        double wait = (r.removedAt - r.enqueuedAt) / 1000.0;
+        result.matched++;
+        result.totalWaitSeconds += wait;
+        if (wait > result.maxWaitSeconds) result.maxWaitSeconds = wait;
+        if (result.rows.size() < q.limit) result.rows.push_back(r);
+    }
+
+    void queryBlock(const ArchiveBlockHeader &h, const std::string &body,
+                    const ArchiveQuery &q, ArchiveResult &result) const {
+        const char *p = body.data();
+        const char *typeDictAt = p;
+        const char *nameDictAt = typeDictAt + h.typeDictBytes;
+        const char *col[ARCHIVE_COLUMNS];
+        col[0] = nameDictAt + h.nameDictBytes;
+        for (int c = 1; c < ARCHIVE_COLUMNS; c++) col[c] = col[c - 1] + h.columnBytes[c - 1];
+        const char *end[ARCHIVE_COLUMNS];
+        for (int c = 0; c < ARCHIVE_COLUMNS; c++) end[c] = col[c] + h.columnBytes[c];
+
+        std::vector<std::string> types = decodeDictionary(typeDictAt, nameDictAt);
+        int64_t wantType = -1;
+        if (!q.type.empty()) {
+            for (size_t i = 0; i < types.size(); i++)
+                if (types[i] == q.type) wantType = (int64_t)i;
+            if (wantType < 0) { result.blocksSkipped++; return; }
+        }
+
+        bool wantRows = result.rows.size() < q.limit;
+        std::vector<std::string> names;
+        if (wantRows) names = decodeDictionary(nameDictAt, col[0]);
+
+        int64_t id = 0, removedAt = 0;
+        result.rowsScanned += h.rows;
+        for (uint32_t i = 0; i < h.rows; i++) {
+            removedAt += unzigzag(getVarint(col[COL_REMOVED], end[COL_REMOVED]));
+            int64_t wait = unzigzag(getVarint(col[COL_WAIT], end[COL_WAIT]));
+            int32_t priority = (int32_t)unzigzag(getVarint(col[COL_PRIORITY], end[COL_PRIORITY]));
+            uint64_t type = getVarint(col[COL_TYPE], end[COL_TYPE]);
+            uint64_t name = 0;
+            if (wantRows) {
+                id += unzigzag(getVarint(col[COL_ID], end[COL_ID]));
+                name = getVarint(col[COL_NAME], end[COL_NAME]);
+            }
+
+            if (!matches(q, removedAt, priority)) continue;
+            if (wantType >= 0 && (int64_t)type != wantType) continue;
+
+            ArchivedRecord r;
+            r.removedAt = removedAt;
+            r.enqueuedAt = removedAt - wait;
+            r.priority = priority;
+            if (wantRows) {
+                r.id = id;
+                r.type = type < types.size() ? types[type] : "";
+                r.name = name < names.size() ? names[name] : "";
+            }
+            count(result, q, r);
+            wantRows = result.rows.size() < q.limit;
+        }
+    }
+
+    // Encode the tail as a block; caller holds the tail lock exclusively
+    bool sealLocked(FILE *tail) {
+        std::string text = readAll(tail);
+        text.resize(text.rfind('\n') + 1);   // complete lines (none: npos + 1 = 0)
+
+        FILE *f = fopen(path.c_str(), "r+b");
+        if (f == nullptr) f = fopen(path.c_str(), "w+b");
+        if (f == nullptr) return false;
+        ArchiveBlockCheck last;
+        bool haveCheck;
+        long committed = committedLength(f, last, haveCheck);
+        size_t sealed = sealedPrefix(text, last, haveCheck);
+
+        std::vector<ArchivedRecord> rows;
+        parseTail(text.substr(sealed), rows);
+        bool ok = true;
+        if (!rows.empty()) {
+            std::string block = encodeBlock(rows, text);
+            ok = truncateFile(f, committed) && fseek(f, committed, SEEK_SET) == 0 &&
+                 fwrite(block.data(), 1, block.size(), f) == block.size();
+            ok = fflush(f) == 0 && ok;
+#ifdef _WIN32
+            ok = _commit(_fileno(f)) == 0 && ok;
+#else
+            ok = fsync(fileno(f)) == 0 && ok;
+#endif
+        }
+        ok = fclose(f) == 0 && ok;
+        if (!ok) return false;   // keep the tail; rows stay queryable there
+
+        return truncateFile(tail, 0);
+    }
+
+public:
+    explicit RecordArchive(const std::string &archivePath)
+        : path(archivePath), tailPath(archivePath + ".tail") {}
+
+    const std::string& filePath() const { return path; }
+
+    void append(const ArchivedRecord &r) {
+        appendAll(std::vector<ArchivedRecord>(1, r));
+    }
+
+    // Several rows with one lock and one write (bulk imports)
+    void appendAll(const std::vector<ArchivedRecord> &rows) {
+        FILE *tail = fopen(tailPath.c_str(), "a+b");
+        if (tail == nullptr) return;
+        lockFile(tail, true);
+
+        // A row cut short by a crash must not run into the next one
+        std::string text;
+        if (fseek(tail, -1, SEEK_END) == 0 && fgetc(tail) != '\n') text = "\n";
+        for (const ArchivedRecord &r : rows) {
+            text += tailLine(r);
+            if ((long)text.size() >= ARCHIVE_TAIL_BYTES) {
+                fwrite(text.data(), 1, text.size(), tail);
+                fflush(tail);
+                sealLocked(tail);
+                text.clear();
+            }
+        }
+        fwrite(text.data(), 1, text.size(), tail);
+        fflush(tail);
+
+        fseek(tail, 0, SEEK_END);
+        if (ftell(tail) >= ARCHIVE_TAIL_BYTES)
+            sealLocked(tail);
+
+        unlockFile(tail);
+        fclose(tail);
+    }
+
+    // Turn whatever is in the tail into a block now
+    void seal() {
+        FILE *tail = fopen(tailPath.c_str(), "a+b");
+        if (tail == nullptr) return;
+        lockFile(tail, true);
+        sealLocked(tail);
+        unlockFile(tail);
+        fclose(tail);
+    }
+
+    ArchiveResult query(const ArchiveQuery &q) const {
+        auto start = std::chrono::steady_clock::now();
+        ArchiveResult result;
+
+        // Hold the tail shared so no seal moves rows between the two files
+        FILE *tail = fopen(tailPath.c_str(), "rb");
+        if (tail != nullptr) lockFile(tail, false);
+
+        ArchiveBlockCheck last = ArchiveBlockCheck();
+        bool haveCheck = false;
+        FILE *f = fopen(path.c_str(), "rb");
+        if (f != nullptr) {
+            fseek(f, 0, SEEK_END);
+            long size = ftell(f);
+            fseek(f, 0, SEEK_SET);
+            ArchiveBlockHeader h;
+            ArchiveBlockCheck check = ArchiveBlockCheck();
+            std::string body;
+            while (fread(&h, sizeof(h), 1, f) == 1) {
+                if (!knownVersion(h)) break;
+                haveCheck = h.version >= 2;
+                if (haveCheck && fread(&check, sizeof(check), 1, f) != 1) { haveCheck = false; break; }
+                uint64_t bodyBytes = bodyBytesOf(h);
+                result.blocks++;
+
+                bool outside = h.maxRemovedAt < q.from || h.minRemovedAt > q.to ||
+                               (q.priority >= 0 && (q.priority < h.minPriority || q.priority > h.maxPriority));
+                if (outside) {
+                    if (fseek(f, (long)bodyBytes, SEEK_CUR) != 0 || ftell(f) > size) {
+                        haveCheck = false;   // torn by a crash
+                        result.blocks--;
+                        break;
+                    }
+                    result.blocksSkipped++;
+                    continue;
+                }
+
+                body.resize((size_t)bodyBytes);
+                bool whole = fread(&body[0], 1, body.size(), f) == body.size() &&
+                             (!haveCheck || archiveChecksum(body.data(), body.size()) == check.bodyChecksum);
+                if (!whole) { haveCheck = false; result.blocks--; break; }   // torn by a crash
+                queryBlock(h, body, q, result);
+            }
+            last = check;
+            fclose(f);
+        }
+
+        if (tail != nullptr) {
+            std::vector<ArchivedRecord> rows;
+            std::string text = readAll(tail);
+            parseTail(text.substr(sealedPrefix(text, last, haveCheck)), rows);
+            unlockFile(tail);
+            fclose(tail);
+            result.rowsScanned += rows.size();
+            for (const ArchivedRecord &r : rows)
+                if (matches(q, r.removedAt, r.priority) && (q.type.empty() || r.type == q.type))
+                    count(result, q, r);
+        }
+
+        result.millis = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        return result;
+    }
+};
+
+#endif // ARCHIVE_HPP
@@ -0,0 +1,261 @@
+#ifndef CHANGELOG_HPP
+#define CHANGELOG_HPP
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+// ==============================================
+//  Change log (feeds a hot standby)
+// ==============================================
+// Once opened, every change a manager makes is appended as one line, in
+// the order the changes happened:
+//
+//   <seq>\t<module>\t<op>\t<key>=<value>\t...
+//   17	patient	admit	id=105	name=Ali	condition=Flu	enqueued=1792386979120
+//   18	emergency	process	id=P001
+//
+// Each line carries what a replica needs to repeat the change exactly
+// (IDs, timestamps), so applying the log in order rebuilds the same
+// queues. A log starts with "log begin", the primary's state at that
+// moment as ordinary add lines, and "log ready".
+//
+// Lines go to the log file and to every follower socket (standbys that
+// connected after the file was opened are sent the file so far first).
+// Each line is flushed to the OS as it is written; a crash of the
+// program loses nothing, a power cut may lose the last few lines.
+//
+// Writers never wait for a standby: under the lock a line is only added
+// to each follower's backlog, and one sender thread writes the backlogs
+// to the (non-blocking) sockets. A standby whose backlog grows past
+// FOLLOWER_BACKLOG_LIMIT is dropped; it reconnects and starts over.
+
+const size_t FOLLOWER_BACKLOG_LIMIT = 16 * 1024 * 1024;
+
+typedef std::vector<std::pair<std::string, std::string>> ChangeFields;
+
+class ChangeLog {
+private:
+    struct Follower {
+        int         fd;
+        FILE*       catchUp;      // the log as it was when it connected
+        long        catchUpLeft;  // bytes of it not yet sent
+        std::string queued;       // new lines (under the lock)
+        std::string sending;      // sender thread only
+        size_t      sent;
+        bool        dropped;
+    };
+
+    std::mutex        lock;
+    std::atomic<bool> on;
+    FILE*             file;
+    std::string       path;
+    uint64_t          seq;
+    std::vector<std::shared_ptr<Follower>> followers;
+    int               wake[2];    // wakes the sender thread
+    bool              senderStarted;
+
+    ChangeLog() : on(false), file(nullptr), seq(0), senderStarted(false) { wake[0] = wake[1] = -1; }
+
+    static std::string clean(const std::string &s) {
+        std::string out = s;
+        for (char &c : out)
+            if (c == '\t' || c == '\n' || c == '\r') c = ' ';
+        return out;
+    }
+
+#ifndef _WIN32
+    void wakeSender() {
+        if (wake[1] < 0) return;
+        char c = 1;
+        ssize_t n = ::write(wake[1], &c, 1);   // full pipe: already woken
+        (void)n;
+    }
+
+    void drop(Follower &f, const char *why) {
+        std::lock_guard<std::mutex> guard(lock);
+        if (!f.dropped) std::cerr << "[WARN] Dropped a standby: " << why << "\n";
+        f.dropped = true;
+    }
+
+    // Next piece of the log file for a follower that is catching up
+    static void readCatchUp(Follower &f) {
+        char buffer[65536];
+        size_t want = (size_t)f.catchUpLeft < sizeof(buffer) ? (size_t)f.catchUpLeft : sizeof(buffer);
+        size_t n = fread(buffer, 1, want, f.catchUp);
+        f.sending.assign(buffer, n);
+        f.sent = 0;
+        f.catchUpLeft = n == 0 ? 0 : f.catchUpLeft - (long)n;   // short file: nothing more
+        if (f.catchUpLeft == 0) {
+            fclose(f.catchUp);
+            f.catchUp = nullptr;
+        }
+    }
+
+    void sendLoop() {
+        std::vector<std::shared_ptr<Follower>> current;
+        std::vector<pollfd> fds;
+        while (true) {
+            std::vector<int> closing;
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                for (size_t i = 0; i < followers.size(); ) {
+                    if (!followers[i]->dropped) { i++; continue; }
+                    closing.push_back(followers[i]->fd);
+                    if (followers[i]->catchUp != nullptr) fclose(followers[i]->catchUp);
+                    followers.erase(followers.begin() + i);
+                }
+                for (auto &f : followers) {
+                    if (f->sent < f->sending.size() || f->catchUp != nullptr || f->queued.empty()) continue;
+                    f->sending.clear();
+                    f->sending.swap(f->queued);
+                    f->sent = 0;
+                }
+                current = followers;
+            }
+            for (int fd : closing) close(fd);
+
+            fds.assign(1, pollfd{wake[0], POLLIN, 0});
+            for (auto &f : current) {
+                if (f->sent == f->sending.size() && f->catchUp != nullptr) readCatchUp(*f);
+                if (f->sent < f->sending.size()) fds.push_back(pollfd{f->fd, POLLOUT, 0});
+            }
+
+            if (poll(fds.data(), fds.size(), -1) < 0) continue;
+            if (fds[0].revents & POLLIN) {
+                char drain[256];
+                while (read(wake[0], drain, sizeof(drain)) > 0) {}
+            }
+
+            size_t k = 1;
+            for (auto &f : current) {
+                if (k == fds.size() || fds[k].fd != f->fd) continue;
+                short ready = fds[k++].revents;
+                if (ready == 0) continue;
+                if (ready & (POLLERR | POLLHUP | POLLNVAL)) { drop(*f, "connection closed"); continue; }
+                ssize_t n = ::write(f->fd, f->sending.data() + f->sent, f->sending.size() - f->sent);
+                if (n > 0) f->sent += (size_t)n;
+                else if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                    drop(*f, "connection closed");
+            }
+        }
+    }
+
+    // Under the lock
+    void startSender() {
+        if (senderStarted) return;
+        if (pipe(wake) < 0) { wake[0] = wake[1] = -1; return; }
+        fcntl(wake[0], F_SETFL, O_NONBLOCK);
+        fcntl(wake[1], F_SETFL, O_NONBLOCK);
+        senderStarted = true;
+        std::thread([this] { sendLoop(); }).detach();
+    }
+#endif
+
+public:
+    // Never destroyed: managers may log while statics are torn down
+    static ChangeLog& instance() {
+        static ChangeLog* log = new ChangeLog();
+        return *log;
+    }
+
+    bool enabled() const { return on.load(std::memory_order_relaxed); }
+
+    // Start a new log at logPath (an old one is replaced)
+    bool open(const std::string &logPath) {
+        std::lock_guard<std::mutex> guard(lock);
+        FILE *f = fopen(logPath.c_str(), "wb");
+        if (f == nullptr) return false;
+        if (file != nullptr) fclose(file);
+        file = f;
+        path = logPath;
+        seq = 0;
+        on = true;
+        return true;
+    }
+
+    void write(const std::string &module, const std::string &op, const ChangeFields &fields = ChangeFields()) {
+        if (!enabled()) return;
+
+        std::lock_guard<std::mutex> guard(lock);
+        std::string line = std::to_string(++seq) + "\t" + module + "\t" + op;
+        for (const auto &f : fields)
+            line += "\t" + f.first + "=" + clean(f.second);
+        line += "\n";
+
+        fwrite(line.data(), 1, line.size(), file);
+        fflush(file);
+
+#ifndef _WIN32
+        if (followers.empty()) return;
+        for (auto &f : followers) {
+            if (f->dropped) continue;
+            if (f->queued.size() + line.size() > FOLLOWER_BACKLOG_LIMIT) {
+                std::cerr << "[WARN] Dropped a standby that fell behind.\n";
+                f->dropped = true;
+                continue;
+            }
+            f->queued += line;
+        }
+        wakeSender();
+#endif
+    }
+
+    // Send a newly connected standby everything so far, then every new
+    // line. The file so far is fixed under the log lock (its own handle,
+    // its length then) so no line is missed or sent twice; the sender
+    // thread reads and sends it.
+    void follow(int fd) {
+#ifndef _WIN32
+        std::lock_guard<std::mutex> guard(lock);
+        startSender();
+        FILE *f = path.empty() ? nullptr : fopen(path.c_str(), "rb");
+        long length = 0;
+        if (f != nullptr && file != nullptr) length = ftell(file);
+        if (!senderStarted || length < 0 || (file != nullptr && f == nullptr)) {
+            if (f != nullptr) fclose(f);
+            close(fd);
+            return;
+        }
+        if (length == 0 && f != nullptr) { fclose(f); f = nullptr; }
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+        std::shared_ptr<Follower> follower(new Follower());
+        follower->fd = fd;
+        follower->catchUp = f;
+        follower->catchUpLeft = length;
+        follower->sent = 0;
+        follower->dropped = false;
+        followers.push_back(follower);
+        wakeSender();
+#else
+        (void)fd;
+#endif
+    }
+};
+
+// Call sites check this first so nothing is formatted when logging is off
+inline bool changeLogOn() {
+    return ChangeLog::instance().enabled();
+}
+
+inline void logChange(const std::string &module, const std::string &op,
+                      const ChangeFields &fields = ChangeFields()) {
+    ChangeLog::instance().write(module, op, fields);
+}
+
+#endif // CHANGELOG_HPP
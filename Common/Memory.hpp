@@ -0,0 +1,223 @@
+#ifndef MEMORY_HPP
+#define MEMORY_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <new>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// ==============================================
+//  Memory accounting
+// ==============================================
+// Each data structure charges what it allocates to an account, so a
+// report can show where memory goes per module:
+//
+//   - containers use CountingAllocator<T, ACCOUNT>, which counts every
+//     allocation and release (nodes, hash buckets, deque blocks);
+//   - strings that don't fit in the string object itself are charged by
+//     whoever holds them (accountString), when the holder is built and
+//     again, negatively, when it is destroyed;
+//   - fixed arrays inside an object are charged once by its constructor.
+//
+// Counters are relaxed atomics: exact totals, no locks on the hot path.
+// Persistent nodes kept alive only by undo history count as live, since
+// they are.
+
+enum MemoryAccount {
+    MEM_PATIENT_NODES = 0,
+    MEM_PATIENT_INDEX,
+    MEM_REGISTRY_RECORDS,
+    MEM_REGISTRY_STRINGS,
+    MEM_REGISTRY_INDEX,
+    MEM_ADMISSION_NODES,
+    MEM_ADMISSION_STRINGS,
+    MEM_MEDICAL_NODES,
+    MEM_MEDICAL_STRINGS,
+    MEM_EMERGENCY_NODES,
+    MEM_EMERGENCY_STRINGS,
+    MEM_EMERGENCY_BOARD,
+    MEM_AMBULANCE_ARRAY,
+    MEM_AMBULANCE_TELEMETRY,
+    MEM_ACCOUNT_COUNT,
+    MEM_UNTRACKED = MEM_ACCOUNT_COUNT
+};
+
+// Modules, for per-module totals and bytes per record
+enum MemoryModule { MEM_MODULE_PATIENT = 0, MEM_MODULE_MEDICAL, MEM_MODULE_EMERGENCY, MEM_MODULE_AMBULANCE,
+                    MEM_MODULE_COUNT };
+
+inline const char* memoryModuleName(int module) {
+    static const char* names[MEM_MODULE_COUNT] = {"patient", "medical", "emergency", "ambulance"};
+    return module >= 0 && module < MEM_MODULE_COUNT ? names[module] : "?";
+}
+
+inline MemoryModule memoryModuleOf(int account) {
+    static const MemoryModule modules[MEM_ACCOUNT_COUNT] = {
+        MEM_MODULE_PATIENT, MEM_MODULE_PATIENT, MEM_MODULE_PATIENT, MEM_MODULE_PATIENT,
+        MEM_MODULE_PATIENT, MEM_MODULE_PATIENT, MEM_MODULE_PATIENT, MEM_MODULE_MEDICAL, MEM_MODULE_MEDICAL,
+        MEM_MODULE_EMERGENCY, MEM_MODULE_EMERGENCY, MEM_MODULE_EMERGENCY, MEM_MODULE_AMBULANCE,
+        MEM_MODULE_AMBULANCE
+    };
+    return modules[account];
+}
+
+inline const char* memoryAccountName(int account) {
+    static const char* names[MEM_ACCOUNT_COUNT] = {
+        "queue nodes", "queue id index", "registry records", "registry strings", "registry id index",
+        "intake nodes", "intake strings", "stack nodes", "strings",
+        "list nodes", "strings", "dispatch board", "fixed queue array", "telemetry"
+    };
+    return account >= 0 && account < MEM_ACCOUNT_COUNT ? names[account] : "?";
+}
+
+struct MemoryRow {
+    std::string module;
+    std::string structure;
+    int64_t     liveBytes;
+    int64_t     peakBytes;
+    uint64_t    allocations;   // since start
+    int64_t     liveAllocations;
+};
+
+class MemoryRegistry {
+private:
+    struct Account {
+        std::atomic<int64_t>  live;
+        std::atomic<int64_t>  peak;
+        std::atomic<uint64_t> allocs;
+        std::atomic<int64_t>  liveAllocs;
+    };
+    Account accounts[MEM_ACCOUNT_COUNT];
+
+    MemoryRegistry() {
+        for (Account &a : accounts) {
+            a.live = 0;
+            a.peak = 0;
+            a.allocs = 0;
+            a.liveAllocs = 0;
+        }
+    }
+
+public:
+    // Never destroyed: containers release memory while statics are torn down
+    static MemoryRegistry& instance() {
+        static MemoryRegistry* r = new MemoryRegistry();
+        return *r;
+    }
+
+    void allocated(MemoryAccount account, size_t bytes, int count = 1) {
+        if (account >= MEM_ACCOUNT_COUNT) return;
+        Account &a = accounts[account];
+        int64_t now = a.live.fetch_add((int64_t)bytes, std::memory_order_relaxed) + (int64_t)bytes;
+        a.allocs.fetch_add((uint64_t)count, std::memory_order_relaxed);
+        a.liveAllocs.fetch_add(count, std::memory_order_relaxed);
+
+        int64_t peak = a.peak.load(std::memory_order_relaxed);
+        while (now > peak && !a.peak.compare_exchange_weak(peak, now, std::memory_order_relaxed)) {}
+    }
+
+    void released(MemoryAccount account, size_t bytes, int count = 1) {
+        if (account >= MEM_ACCOUNT_COUNT) return;
+        accounts[account].live.fetch_sub((int64_t)bytes, std::memory_order_relaxed);
+        accounts[account].liveAllocs.fetch_sub(count, std::memory_order_relaxed);
+    }
+
+    std::vector<MemoryRow> rows() const {
+        std::vector<MemoryRow> out;
+        for (int i = 0; i < MEM_ACCOUNT_COUNT; i++) {
+            const Account &a = accounts[i];
+            out.push_back(MemoryRow{memoryModuleName(memoryModuleOf(i)), memoryAccountName(i),
+                                    a.live.load(std::memory_order_relaxed), a.peak.load(std::memory_order_relaxed),
+                                    a.allocs.load(std::memory_order_relaxed),
+                                    a.liveAllocs.load(std::memory_order_relaxed)});
+        }
+        return out;
+    }
+
+    // Live bytes of one module (sum of its accounts)
+    int64_t moduleBytes(int module) const {
+        int64_t total = 0;
+        for (int i = 0; i < MEM_ACCOUNT_COUNT; i++)
+            if (memoryModuleOf(i) == module) total += accounts[i].live.load(std::memory_order_relaxed);
+        return total;
+    }
+
+    // records[m] = records module m holds now, for bytes per record
+    void printTable(std::ostream &out, const int records[MEM_MODULE_COUNT]) const {
+        std::ostringstream t;
+        t << "\n=========================== Memory Use ===========================\n";
+        t << std::left << std::setw(11) << "Module" << std::setw(20) << "Structure" << std::right
+          << std::setw(12) << "Live (B)" << std::setw(12) << "Peak (B)" << std::setw(11) << "Allocs"
+          << std::setw(10) << "Live" << "\n";
+        t << std::string(76, '-') << "\n";
+        for (const MemoryRow &r : rows())
+            t << std::left << std::setw(11) << r.module << std::setw(20) << r.structure << std::right
+              << std::setw(12) << r.liveBytes << std::setw(12) << r.peakBytes << std::setw(11) << r.allocations
+              << std::setw(10) << r.liveAllocations << "\n";
+
+        t << std::string(76, '-') << "\n";
+        t << std::fixed << std::setprecision(1);
+        for (int m = 0; m < MEM_MODULE_COUNT; m++) {
+            int64_t bytes = moduleBytes(m);
+            t << std::left << std::setw(11) << memoryModuleName(m) << std::right << std::setw(10) << records[m]
+              << " records " << std::setw(12) << bytes << " B  "
+              << (records[m] > 0 ? (double)bytes / records[m] : 0.0) << " B/record\n";
+        }
+        t << "Patient records share the registry with emergency cases.\n";
+        out << t.str();
+    }
+};
+
+// ===============================
+// Allocator for standard containers
+// ===============================
+template <class T, MemoryAccount ACCOUNT>
+struct CountingAllocator {
+    typedef T value_type;
+
+    template <class U>
+    struct rebind { typedef CountingAllocator<U, ACCOUNT> other; };
+
+    CountingAllocator() {}
+    template <class U>
+    CountingAllocator(const CountingAllocator<U, ACCOUNT>&) {}
+
+    T* allocate(size_t n) {
+        T* p = static_cast<T*>(::operator new(n * sizeof(T)));
+        MemoryRegistry::instance().allocated(ACCOUNT, n * sizeof(T));
+        return p;
+    }
+
+    void deallocate(T* p, size_t n) {
+        MemoryRegistry::instance().released(ACCOUNT, n * sizeof(T));
+        ::operator delete(p);
+    }
+};
+
+template <class T, class U, MemoryAccount A>
+bool operator==(const CountingAllocator<T, A>&, const CountingAllocator<U, A>&) { return true; }
+template <class T, class U, MemoryAccount A>
+bool operator!=(const CountingAllocator<T, A>&, const CountingAllocator<U, A>&) { return false; }
+
+// ===============================
+// Strings
+// ===============================
+// Heap block of a string, if it has one (short strings live inside the
+// std::string object). sign = +1 when the holder is built, -1 when it goes.
+inline void accountString(MemoryAccount account, const std::string &s, int sign) {
+    static const size_t inlineCapacity = std::string().capacity();
+    if (s.capacity() <= inlineCapacity) return;
+    if (sign > 0) MemoryRegistry::instance().allocated(account, s.capacity() + 1);
+    else MemoryRegistry::instance().released(account, s.capacity() + 1);
+}
+
+// Records with no strings of their own; types that have some overload this
+template <class T>
+inline void accountStrings(const T&, MemoryAccount, int) {}
+
+#endif // MEMORY_HPP
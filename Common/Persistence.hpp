@@ -0,0 +1,236 @@
+#ifndef PERSISTENCE_HPP
+#define PERSISTENCE_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "Stats.hpp"
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// ==============================================
+//  File persistence
+// ==============================================
+
+// Replace path with content without ever leaving a half-written file:
+// write path.tmp, flush it to disk, then rename over the original.
+inline bool writeFileAtomically(const std::string &path, const std::string &content) {
+    StatTimer timer(STAT_FILE_WRITE);
+    std::string tmp = path + ".tmp";
+
+    FILE *f = fopen(tmp.c_str(), "wb");
+    if (f == nullptr) {
+        std::cerr << "[ERROR] Cannot write to file: " << path << "\n";
+        return false;
+    }
+
+    bool ok = fwrite(content.data(), 1, content.size(), f) == content.size();
+    ok = fflush(f) == 0 && ok;
+#ifdef _WIN32
+    ok = _commit(_fileno(f)) == 0 && ok;
+#else
+    ok = fsync(fileno(f)) == 0 && ok;
+#endif
+    ok = fclose(f) == 0 && ok;
+
+#ifdef _WIN32
+    if (ok) remove(path.c_str());   // rename() does not replace on Windows
+#endif
+    if (!ok || rename(tmp.c_str(), path.c_str()) != 0) {
+        std::cerr << "[ERROR] Failed to save file: " << path << "\n";
+        remove(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+// Add text to the end of path (created if missing) and flush it to disk.
+// One O_APPEND write, so a crash leaves at most a torn last line.
+inline bool appendFileDurably(const std::string &path, const std::string &text) {
+    StatTimer timer(STAT_FILE_WRITE);
+#ifdef _WIN32
+    FILE *f = fopen(path.c_str(), "ab");
+    bool ok = f != nullptr && fwrite(text.data(), 1, text.size(), f) == text.size();
+    ok = f != nullptr && fflush(f) == 0 && _commit(_fileno(f)) == 0 && ok;
+    if (f != nullptr) ok = fclose(f) == 0 && ok;
+#else
+    int fd = open(path.c_str(), O_WRONLY | O_APPEND | O_CREAT, 0644);
+    bool ok = fd >= 0 && write(fd, text.data(), text.size()) == (ssize_t)text.size();
+    ok = fd >= 0 && fsync(fd) == 0 && ok;
+    if (fd >= 0) ok = close(fd) == 0 && ok;
+#endif
+    if (!ok) std::cerr << "[ERROR] Failed to append to file: " << path << "\n";
+    return ok;
+}
+
+// Background writer with group commit.
+//
+// submit() hands over the new contents of a file and returns at once.
+// If the same file is submitted again before the writer gets to it, only
+// the newest contents are written, so a burst of changes costs one write.
+// barrier() blocks until everything submitted before the call is on disk.
+// Pending writes are finished when the program exits.
+//
+// A write that fails is reported on cerr and counted; failures() and
+// barrier() return the count so far, so a caller that remembers the last
+// value it saw can tell whether its own saves made it.
+class PersistenceWriter {
+private:
+    std::map<std::string, std::string> pending;   // path -> newest contents
+    uint64_t submitted;                           // tickets handed out
+    uint64_t written;                             // tickets known on disk
+    uint64_t failed;                              // writes that did not make it
+    std::string lastFailed;                       // path of the latest of them
+    bool stopping;
+
+    std::mutex lock;
+    std::condition_variable work;
+    std::condition_variable done;
+    std::thread writer;
+
+    // Wait this long after the first change so a burst shares one write
+    static constexpr std::chrono::milliseconds GROUP_WINDOW{2};
+
+    void run() {
+        std::unique_lock<std::mutex> guard(lock);
+        while (true) {
+            work.wait(guard, [this] { return stopping || !pending.empty(); });
+            if (pending.empty()) return;   // stopping with nothing left
+
+            if (!stopping) {
+                guard.unlock();
+                std::this_thread::sleep_for(GROUP_WINDOW);
+                guard.lock();
+            }
+
+            std::map<std::string, std::string> batch;
+            batch.swap(pending);
+            uint64_t upTo = submitted;
+
+            guard.unlock();
+            std::string failedPath;
+            int failures = 0;
+            for (const auto &file : batch) {
+                if (writeFileAtomically(file.first, file.second)) continue;
+                failedPath = file.first;
+                failures++;
+            }
+            guard.lock();
+
+            if (failures > 0) {
+                failed += failures;
+                lastFailed = failedPath;
+            }
+            written = upTo;
+            done.notify_all();
+        }
+    }
+
+    PersistenceWriter() : submitted(0), written(0), failed(0), stopping(false) {
+        writer = std::thread(&PersistenceWriter::run, this);
+    }
+
+public:
+    static PersistenceWriter& instance() {
+        static PersistenceWriter w;
+        return w;
+    }
+
+    ~PersistenceWriter() {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            stopping = true;
+        }
+        work.notify_one();
+        writer.join();
+    }
+
+    PersistenceWriter(const PersistenceWriter&) = delete;
+    PersistenceWriter& operator=(const PersistenceWriter&) = delete;
+
+    void submit(const std::string &path, std::string content) {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            pending[path] = std::move(content);
+            submitted++;
+        }
+        work.notify_one();
+    }
+
+    // Durability barrier. Returns failures() once everything is written.
+    uint64_t barrier(std::string *lastPath = nullptr) {
+        std::unique_lock<std::mutex> guard(lock);
+        uint64_t ticket = submitted;
+        done.wait(guard, [this, ticket] { return written >= ticket; });
+        if (lastPath != nullptr) *lastPath = lastFailed;
+        return failed;
+    }
+
+    // Failed writes since the start, and the path of the latest
+    uint64_t failures(std::string *lastPath = nullptr) {
+        std::lock_guard<std::mutex> guard(lock);
+        if (lastPath != nullptr) *lastPath = lastFailed;
+        return failed;
+    }
+
+    // A write made outside the writer (persistFile with `synchronous`) failed
+    void noteFailure(const std::string &path) {
+        std::lock_guard<std::mutex> guard(lock);
+        failed++;
+        lastFailed = path;
+    }
+};
+
+// Where saves go in a backup child (see Hospital/Backup.cpp): the
+// background writer's thread does not exist there, so files are written
+// directly under `dir` instead. Empty dir = normal saving.
+struct PersistRedirect {
+    std::string dir;
+    int         failures;
+};
+
+inline PersistRedirect& persistRedirect() {
+    static PersistRedirect r{"", 0};
+    return r;
+}
+
+// Save a data file. Normally queued on the background writer; with
+// `synchronous` it is written before returning (used when the caller holds
+// a lock shared with other processes, so file order follows lock order).
+inline void persistFile(const std::string &path, std::string content, bool synchronous) {
+    PersistRedirect &redirect = persistRedirect();
+    if (!redirect.dir.empty()) {
+        if (!writeFileAtomically(redirect.dir + "/" + path, content)) redirect.failures++;
+    } else if (synchronous) {
+        PersistenceWriter &writer = PersistenceWriter::instance();
+        writer.barrier();   // nothing older may land after us
+        if (!writeFileAtomically(path, content)) writer.noteFailure(path);
+    } else {
+        PersistenceWriter::instance().submit(path, std::move(content));
+    }
+}
+
+// Append to a data file right away (journals). The caller makes sure no
+// queued rewrite of the same file is still pending.
+inline void persistAppend(const std::string &path, const std::string &text) {
+    PersistRedirect &redirect = persistRedirect();
+    if (!redirect.dir.empty()) {
+        if (!appendFileDurably(redirect.dir + "/" + path, text)) redirect.failures++;
+    } else if (!appendFileDurably(path, text)) {
+        PersistenceWriter::instance().noteFailure(path);
+    }
+}
+
+#endif // PERSISTENCE_HPP
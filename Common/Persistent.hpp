@@ -0,0 +1,261 @@
+#ifndef PERSISTENT_HPP
+#define PERSISTENT_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Memory.hpp"
+
+// ==============================================
+//  Persistent (versioned) sequence and undo history
+// ==============================================
+// PersistentSeq<T> is an ordered list whose nodes are never modified
+// after they are built. A change copies only the O(log n) nodes on the
+// path it touches and shares the rest with the previous version, so:
+//
+//   - keeping the old version costs a pointer copy, which is what makes
+//     undo cheap (UndoHistory below keeps a few old versions);
+//   - a copy of the sequence is a frozen version: a save or a report can
+//     read it, even on another thread, while the original keeps changing.
+//
+// Internally an implicit treap: a binary tree ordered by position with a
+// random heap priority per node, which keeps the expected depth O(log n).
+// Nodes hold their subtree size, so at(i), insertAt(i) and eraseAt(i)
+// are O(log n), and pushBack/popFront/popBack are O(log n) as well. In a sequence
+// sorted by some key, partitionPoint() finds a key's position in O(log n).
+//
+// Node memory is charged to NODES and the heap part of each value's
+// strings to STRINGS (Common/Memory.hpp).
+
+template <class T, MemoryAccount NODES = MEM_UNTRACKED, MemoryAccount STRINGS = NODES>
+class PersistentSeq {
+private:
+    struct Node;
+    typedef std::shared_ptr<const Node> Ptr;
+    typedef CountingAllocator<Node, NODES> Alloc;
+
+    struct Node {
+        uint64_t priority;
+        size_t   size;
+        T        value;
+        Ptr      left;
+        Ptr      right;
+
+        Node(uint64_t p, size_t n, const T &v, Ptr l, Ptr r)
+            : priority(p), size(n), value(v), left(std::move(l)), right(std::move(r)) {
+            accountStrings(value, STRINGS, 1);
+        }
+        ~Node() { accountStrings(value, STRINGS, -1); }
+    };
+
+    Ptr root;
+
+    static size_t sizeOf(const Ptr &t) { return t ? t->size : 0; }
+
+    // splitmix64 over a shared counter: cheap, thread-safe and repeatable
+    static uint64_t nextPriority() {
+        static std::atomic<uint64_t> counter(0);
+        uint64_t z = counter.fetch_add(0x9E3779B97F4A7C15ull, std::memory_order_relaxed);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    // Copy of t with new children (path copying)
+    static Ptr with(const Ptr &t, Ptr left, Ptr right) {
+        size_t n = 1 + sizeOf(left) + sizeOf(right);
+        return std::allocate_shared<const Node>(Alloc(), t->priority, n, t->value, std::move(left), std::move(right));
+    }
+
+    static Ptr leaf(const T &value) {
+        return std::allocate_shared<const Node>(Alloc(), nextPriority(), 1, value, nullptr, nullptr);
+    }
+
+    // Concatenate: every element of a comes before every element of b
+    static Ptr merge(const Ptr &a, const Ptr &b) {
+        if (!a) return b;
+        if (!b) return a;
+        if (a->priority > b->priority)
+            return with(a, a->left, merge(a->right, b));
+        return with(b, merge(a, b->left), b->right);
+    }
+
+    // First i elements of t into l, the rest into r
+    static void split(const Ptr &t, size_t i, Ptr &l, Ptr &r) {
+        if (!t) { l = r = nullptr; return; }
+        size_t leftSize = sizeOf(t->left);
+        if (i <= leftSize) {
+            Ptr rest;
+            split(t->left, i, l, rest);
+            r = with(t, rest, t->right);
+        } else {
+            Ptr rest;
+            split(t->right, i - leftSize - 1, rest, r);
+            l = with(t, t->left, rest);
+        }
+    }
+
+    static Ptr eraseAt(const Ptr &t, size_t i) {
+        size_t leftSize = sizeOf(t->left);
+        if (i < leftSize) return with(t, eraseAt(t->left, i), t->right);
+        if (i > leftSize) return with(t, t->left, eraseAt(t->right, i - leftSize - 1));
+        return merge(t->left, t->right);
+    }
+
+    template <class F>
+    static bool visit(const Ptr &t, size_t &index, F &f) {
+        if (!t) return true;
+        if (!visit(t->left, index, f)) return false;
+        if (!f(index++, t->value)) return false;
+        return visit(t->right, index, f);
+    }
+
+public:
+    size_t size() const { return sizeOf(root); }
+    bool empty() const { return !root; }
+
+    const T& at(size_t i) const {
+        const Node *t = root.get();
+        while (true) {
+            size_t leftSize = sizeOf(t->left);
+            if (i < leftSize) t = t->left.get();
+            else if (i == leftSize) return t->value;
+            else { i -= leftSize + 1; t = t->right.get(); }
+        }
+    }
+
+    const T& front() const { return at(0); }
+    const T& back() const { return at(size() - 1); }
+
+    void pushBack(const T &value) { root = merge(root, leaf(value)); }
+    void insertAt(size_t i, const T &value) {
+        Ptr l, r;
+        split(root, i, l, r);
+        root = merge(merge(l, leaf(value)), r);
+    }
+    void eraseAt(size_t i) { root = eraseAt(root, i); }
+    void popFront() { eraseAt(0); }
+    void popBack() { eraseAt(size() - 1); }
+    void clear() { root.reset(); }
+
+    // Replace the contents in O(n) (bulk load). Builds the treap left to
+    // right, keeping the nodes on the right edge on a stack; a node is
+    // finished, and its size known, once it leaves the stack.
+    void assign(const std::vector<T> &items) {
+        std::vector<std::shared_ptr<Node>> edge;
+        for (const T &item : items) {
+            std::shared_ptr<Node> n = std::allocate_shared<Node>(Alloc(), nextPriority(), 1, item, nullptr, nullptr);
+            std::shared_ptr<Node> last;
+            while (!edge.empty() && edge.back()->priority < n->priority) {
+                last = edge.back();
+                edge.pop_back();
+                last->size = 1 + sizeOf(last->left) + sizeOf(last->right);
+            }
+            n->left = last;
+            if (!edge.empty()) edge.back()->right = n;
+            edge.push_back(n);
+        }
+        for (size_t i = edge.size(); i-- > 0;)
+            edge[i]->size = 1 + sizeOf(edge[i]->left) + sizeOf(edge[i]->right);
+        root = edge.empty() ? nullptr : Ptr(edge.front());
+    }
+
+    // Index of the first element for which before(element) is false, in
+    // a sequence where before() holds for a prefix only (e.g. one sorted
+    // by a key). Walks one root-to-leaf path: O(log n).
+    template <class F>
+    size_t partitionPoint(F before) const {
+        size_t index = 0;
+        const Node *t = root.get();
+        while (t != nullptr) {
+            if (before(t->value)) {
+                index += sizeOf(t->left) + 1;
+                t = t->right.get();
+            } else {
+                t = t->left.get();
+            }
+        }
+        return index;
+    }
+
+    // Calls f(index, value) in order until f returns false
+    template <class F>
+    void forEach(F f) const {
+        size_t index = 0;
+        visit(root, index, f);
+    }
+};
+
+// ===============================
+// Undo history: earlier versions of a persistent collection
+// ===============================
+const size_t UNDO_DEPTH = 50;
+
+template <class V>
+class UndoHistory {
+private:
+    struct Step {
+        V                     before;
+        std::string           what;
+        std::function<void()> settle;   // once it can't be undone any more
+    };
+    std::deque<Step> past;   // newest at the back
+
+    static void settle(Step &step) {
+        if (step.settle) step.settle();
+    }
+
+public:
+    UndoHistory() {}
+    UndoHistory(const UndoHistory &) = delete;              // settles exactly once
+    UndoHistory &operator=(const UndoHistory &) = delete;
+    UndoHistory(UndoHistory &&other) : past(std::move(other.past)) { other.past.clear(); }
+    UndoHistory &operator=(UndoHistory &&other) {
+        if (this != &other) {
+            clear();
+            past = std::move(other.past);
+            other.past.clear();
+        }
+        return *this;
+    }
+    ~UndoHistory() { clear(); }
+
+    // Call before changing `current`; what = e.g. "discharge of Siti".
+    // settle does what must only happen if the change stays (an archive
+    // row, a wait sample): it runs when the change leaves the history,
+    // never if it is undone.
+    void record(const V &current, const std::string &what,
+                std::function<void()> settleStep = std::function<void()>()) {
+        past.push_back(Step{current, what, std::move(settleStep)});
+        if (past.size() > UNDO_DEPTH) {
+            settle(past.front());
+            past.pop_front();
+        }
+    }
+
+    bool canUndo() const { return !past.empty(); }
+    const std::string& lastChange() const { return past.back().what; }
+
+    // Put the previous version back: a pointer swap, no elements copied
+    bool undo(V &current) {
+        if (past.empty()) return false;
+        current = past.back().before;
+        past.pop_back();
+        return true;
+    }
+
+    // Nothing can be undone any more: every change settles, oldest first
+    void clear() {
+        for (Step &step : past) settle(step);
+        past.clear();
+    }
+};
+
+#endif // PERSISTENT_HPP
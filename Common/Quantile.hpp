@@ -0,0 +1,122 @@
+#ifndef QUANTILE_HPP
+#define QUANTILE_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// ==============================================
+//  Streaming quantile sketch (KLL)
+// ==============================================
+// Keeps a small sample of everything it has seen, arranged in levels:
+// an item on level h stands for 2^h original values. When a level fills
+// up it is sorted and every other item (odd or even positions, chosen at
+// random) moves up one level with twice the weight. Lower levels get
+// smaller capacities, so the whole sketch holds about 3k items no matter
+// how many values were added, and rank error is about 1.7/k.
+//
+// Sketches with the same k merge by concatenating levels and compacting,
+// so per-key sketches can be combined into totals without the raw data.
+
+class QuantileSketch {
+private:
+    int k;
+    uint64_t n;
+    double minValue, maxValue;
+    std::vector<std::vector<double>> levels;
+    uint32_t coin;   // xorshift state; fixed seed keeps runs repeatable
+
+    bool flip() {
+        coin ^= coin << 13;
+        coin ^= coin >> 17;
+        coin ^= coin << 5;
+        return coin & 1;
+    }
+
+    size_t capacity(size_t level) const {
+        size_t depth = levels.size() - 1 - level;
+        size_t c = (size_t)std::ceil(k * std::pow(2.0 / 3.0, (double)depth));
+        return std::max<size_t>(c, 2);
+    }
+
+    void compact() {
+        for (size_t h = 0; h < levels.size(); h++) {
+            if (levels[h].size() < capacity(h)) continue;
+            if (h + 1 == levels.size()) levels.emplace_back();
+
+            std::vector<double> &from = levels[h];
+            std::sort(from.begin(), from.end());
+            // An odd item out stays behind so the total weight is exact
+            double leftover = 0;
+            bool hasLeftover = from.size() % 2 == 1;
+            if (hasLeftover) { leftover = from.back(); from.pop_back(); }
+
+            std::vector<double> &to = levels[h + 1];
+            for (size_t i = flip() ? 1 : 0; i < from.size(); i += 2)
+                to.push_back(from[i]);
+            from.clear();
+            if (hasLeftover) from.push_back(leftover);
+        }
+    }
+
+public:
+    explicit QuantileSketch(int accuracy = 200)
+        : k(accuracy), n(0), minValue(0), maxValue(0), levels(1), coin(2463534242u) {}
+
+    void add(double value) {
+        if (n == 0 || value < minValue) minValue = value;
+        if (n == 0 || value > maxValue) maxValue = value;
+        n++;
+        levels[0].push_back(value);
+        if (levels[0].size() >= capacity(0)) compact();
+    }
+
+    void merge(const QuantileSketch &other) {
+        if (other.n == 0) return;
+        if (n == 0 || other.minValue < minValue) minValue = other.minValue;
+        if (n == 0 || other.maxValue > maxValue) maxValue = other.maxValue;
+        n += other.n;
+        if (levels.size() < other.levels.size()) levels.resize(other.levels.size());
+        for (size_t h = 0; h < other.levels.size(); h++)
+            levels[h].insert(levels[h].end(), other.levels[h].begin(), other.levels[h].end());
+        compact();
+    }
+
+    uint64_t count() const { return n; }
+    double min() const { return minValue; }
+    double max() const { return maxValue; }
+
+    // Items currently held (for memory accounting)
+    size_t retained() const {
+        size_t total = 0;
+        for (const auto &level : levels) total += level.size();
+        return total;
+    }
+
+    // Value at rank q (0..1); 0 when empty
+    double quantile(double q) const {
+        if (n == 0) return 0;
+        if (q <= 0) return minValue;
+        if (q >= 1) return maxValue;
+
+        std::vector<std::pair<double, uint64_t>> weighted;
+        weighted.reserve(retained());
+        for (size_t h = 0; h < levels.size(); h++)
+            for (double v : levels[h]) weighted.push_back({v, (uint64_t)1 << h});
+        std::sort(weighted.begin(), weighted.end());
+
+        uint64_t total = 0;
+        for (const auto &w : weighted) total += w.second;
+        uint64_t target = (uint64_t)std::ceil(q * (double)total);
+        uint64_t seen = 0;
+        for (const auto &w : weighted) {
+            seen += w.second;
+            if (seen >= target) return w.first;
+        }
+        return maxValue;
+    }
+};
+
+#endif // QUANTILE_HPP
@@ -0,0 +1,224 @@
+#ifndef RECORDER_HPP
+#define RECORDER_HPP
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Table.hpp"
+
+// ==============================================
+//  Session recording and replay of menu input
+// ==============================================
+// With HOSPITAL_RECORD=FILE set, every line the menus read from standard
+// input is also appended to FILE together with the time (ms since start)
+// at which the program consumed it:
+//
+//   # hospital-recording v1 module=emergency
+//   1520.113<TAB>1
+//   4210.870<TAB>Hui Nan
+//
+// The data files as they were when recording started are copied to
+// FILE.data/, so a replay always starts from the same state.
+
+const std::string RECORDING_HEADER = "# hospital-recording v1";
+
+// Data files every module reads under dir: the fixed ones (with the
+// patient lane setup and the journals) and each store room's
+// Medical/Medical-<room>.csv
+inline std::vector<std::string> recordedDataFiles(const std::string &dir) {
+    std::vector<std::string> files = {
+        "Patient.csv", "Patient.csv.journal", "PatientLanes.csv",
+        "Medical/Medical.csv", "Medical/Transfer.journal", "Emergency/Emergency.csv", "Ambulance/Ambulance.csv"
+    };
+    std::error_code ec;
+    for (const auto &entry : std::filesystem::directory_iterator(std::filesystem::path(dir) / "Medical", ec)) {
+        std::string name = entry.path().filename().string();
+        const std::string prefix = "Medical-", suffix = ".csv";
+        if (name.size() > prefix.size() + suffix.size() && name.compare(0, prefix.size(), prefix) == 0 &&
+            name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0)
+            files.push_back("Medical/" + name);
+    }
+    return files;
+}
+
+// Copy whichever data files exist from one directory tree to another
+inline bool copyDataFiles(const std::string &fromDir, const std::string &toDir) {
+    namespace fs = std::filesystem;
+    std::error_code ec;
+    for (const std::string &f : recordedDataFiles(fromDir)) {
+        fs::path src = fs::path(fromDir) / f;
+        if (!fs::exists(src, ec)) continue;
+        fs::path dst = fs::path(toDir) / f;
+        fs::create_directories(dst.parent_path(), ec);
+        fs::copy_file(src, dst, fs::copy_options::overwrite_existing, ec);
+        if (ec) {
+            std::cerr << "[ERROR] Cannot copy " << src.string() << ": " << ec.message() << "\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+// ===============================
+// Recording: passes input through and logs each line
+// ===============================
+class RecordingBuf : public std::streambuf {
+private:
+    std::streambuf* source;
+    std::ofstream   log;
+    std::string     line;
+    std::chrono::steady_clock::time_point start;
+
+protected:
+    int_type underflow() override {
+        if (gptr() < egptr()) return traits_type::to_int_type(*gptr());
+
+        line.clear();
+        int_type c;
+        while ((c = source->sbumpc()) != traits_type::eof()) {
+            line.push_back(traits_type::to_char_type(c));
+            if (c == '\n') break;
+        }
+        if (line.empty()) return traits_type::eof();
+
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::string text = line;
+        if (!text.empty() && text.back() == '\n') text.pop_back();
+        if (!text.empty() && text.back() == '\r') text.pop_back();
+        log << std::fixed << std::setprecision(3) << ms << "\t" << text << std::endl;
+
+        setg(&line[0], &line[0], &line[0] + line.size());
+        return traits_type::to_int_type(line[0]);
+    }
+
+public:
+    RecordingBuf(std::streambuf* src, const std::string &path, const std::string &module)
+        : source(src), log(path), start(std::chrono::steady_clock::now()) {
+        log << RECORDING_HEADER << " module=" << module << std::endl;
+    }
+
+    bool good() const { return log.good(); }
+};
+
+// Start recording standard input if HOSPITAL_RECORD is set. Call at the
+// top of main(), before any data is loaded.
+inline void startRecordingFromEnv(const std::string &module) {
+    const char* path = getenv("HOSPITAL_RECORD");
+    if (path == nullptr || *path == '\0') return;
+
+    // Emptied first: a room left from an earlier recording is not data
+    std::error_code ec;
+    std::filesystem::remove_all(std::string(path) + ".data", ec);
+    if (!copyDataFiles(".", std::string(path) + ".data")) return;
+
+    // Never freed: cin keeps using it until the program exits
+    RecordingBuf* buf = new RecordingBuf(std::cin.rdbuf(), path, module);
+    if (!buf->good()) {
+        std::cerr << "[ERROR] Cannot write recording: " << path << "\n";
+        delete buf;
+        return;
+    }
+    std::cin.rdbuf(buf);
+    tableInputRedirected() = true;
+    std::cerr << "[INFO] Recording input to " << path << "\n";
+}
+
+// ===============================
+// Replay: serves recorded lines as standard input
+// ===============================
+struct RecordedLine {
+    double      atMillis;
+    std::string text;
+};
+
+// Read a recording; module is taken from the header
+inline bool loadRecording(const std::string &path, std::string &module,
+                          std::vector<RecordedLine> &lines, std::string &error) {
+    std::ifstream in(path);
+    if (!in.is_open()) { error = "cannot open " + path; return false; }
+
+    std::string header;
+    getline(in, header);
+    if (header.compare(0, RECORDING_HEADER.size(), RECORDING_HEADER) != 0) {
+        error = path + " is not a recording";
+        return false;
+    }
+    size_t m = header.find("module=");
+    module = m == std::string::npos ? "" : header.substr(m + 7);
+
+    std::string row;
+    while (getline(in, row)) {
+        size_t tab = row.find('\t');
+        if (tab == std::string::npos) continue;
+        lines.push_back(RecordedLine{atof(row.substr(0, tab).c_str()), row.substr(tab + 1)});
+    }
+    return true;
+}
+
+class ReplayBuf : public std::streambuf {
+private:
+    const std::vector<RecordedLine>& lines;
+    size_t      next;
+    bool        paced;        // wait until each line's recorded time
+    std::string current;
+    std::chrono::steady_clock::time_point start;
+    std::chrono::steady_clock::time_point delivered;
+    std::function<void()> onEnd;   // input ran out before the menus exited
+
+public:
+    // responseMillis[i]: time from handing over line i until the program
+    // asked for more input, i.e. how long line i took to handle
+    std::vector<double> responseMillis;
+
+protected:
+    int_type underflow() override {
+        if (gptr() < egptr()) return traits_type::to_int_type(*gptr());
+
+        auto now = std::chrono::steady_clock::now();
+        if (next > 0 && responseMillis.size() < next)
+            responseMillis.push_back(std::chrono::duration<double, std::milli>(now - delivered).count());
+
+        if (next >= lines.size()) {
+            if (onEnd) onEnd();
+            return traits_type::eof();
+        }
+
+        if (paced) {
+            auto due = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                   std::chrono::duration<double, std::milli>(lines[next].atMillis));
+            std::this_thread::sleep_until(due);
+        }
+
+        current = lines[next++].text + "\n";
+        delivered = std::chrono::steady_clock::now();
+        setg(&current[0], &current[0], &current[0] + current.size());
+        return traits_type::to_int_type(current[0]);
+    }
+
+public:
+    ReplayBuf(const std::vector<RecordedLine> &recorded, bool originalPacing, std::function<void()> end)
+        : lines(recorded), next(0), paced(originalPacing),
+          start(std::chrono::steady_clock::now()), onEnd(end) {}
+
+    size_t consumed() const { return next; }
+
+    // The menus exited: count the handling time of the last line too
+    void close() {
+        if (next > 0 && responseMillis.size() < next)
+            responseMillis.push_back(std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - delivered).count());
+    }
+};
+
+#endif // RECORDER_HPP
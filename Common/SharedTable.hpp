@@ -0,0 +1,190 @@
+#ifndef SHARED_TABLE_HPP
+#define SHARED_TABLE_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+// ==============================================
+//  Fixed-layout record table in POSIX shared memory
+// ==============================================
+// Lets separately launched module processes work on the same live data.
+// Every process maps the same named segment; a process-shared (robust)
+// mutex guards it and `generation` is bumped on every change so a process
+// only re-reads the records after someone else modified them.
+//
+// Records must be plain fixed-size structs (char arrays, no std::string).
+
+const uint32_t SHARED_TABLE_MAGIC   = 0x31545348; // "HST1"
+const uint32_t SHARED_TABLE_VERSION = 1;
+
+// Copy a string into a fixed char field, truncating if needed
+template <size_t N>
+inline void copyText(char (&dst)[N], const std::string &src) {
+    size_t n = src.size() < N - 1 ? src.size() : N - 1;
+    memcpy(dst, src.data(), n);
+    dst[n] = '\0';
+}
+
+#ifdef _WIN32
+
+// Shared memory mode is POSIX only; attach() always fails on Windows.
+template <class Record, int Capacity>
+class SharedTable {
+public:
+    struct Layout {
+        uint64_t generation;
+        int32_t  count;
+        int32_t  counter;
+        uint32_t loaded;
+        Record   records[Capacity];
+    };
+
+    bool attach(const std::string &, std::string &error) {
+        error = "shared memory is not supported on this platform";
+        return false;
+    }
+    Layout* get() { return nullptr; }
+    void lock() {}
+    void unlock() {}
+};
+
+#else
+
+#include <cerrno>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+template <class Record, int Capacity>
+class SharedTable {
+public:
+    struct Layout {
+        uint32_t              magic;
+        uint32_t              version;
+        uint32_t              recordSize;
+        uint32_t              capacity;
+        std::atomic<uint32_t> ready;      // creator finished initialising
+        uint32_t              loaded;     // first user copied its CSV data in
+        uint64_t              generation; // bumped on every change
+        int32_t               count;      // records in use
+        int32_t               counter;    // module ID counter (lastID / nextID)
+        pthread_mutex_t       mutex;
+        Record                records[Capacity];
+    };
+
+private:
+    Layout* data;
+
+    static void pause() { usleep(1000); }
+
+public:
+    SharedTable() : data(nullptr) {}
+
+    ~SharedTable() {
+        if (data != nullptr) munmap(data, sizeof(Layout));
+    }
+
+    SharedTable(const SharedTable&) = delete;
+    SharedTable& operator=(const SharedTable&) = delete;
+
+    // Map (creating if needed) the segment called name, e.g. "/hospital_emergency"
+    bool attach(const std::string &name, std::string &error) {
+        int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+        bool creator = fd >= 0;
+
+        if (!creator) {
+            if (errno != EEXIST) { error = strerror(errno); return false; }
+            fd = shm_open(name.c_str(), O_RDWR, 0600);
+            if (fd < 0) { error = strerror(errno); return false; }
+
+            // The creator may still be sizing the segment
+            struct stat st;
+            for (int tries = 0; fstat(fd, &st) == 0 && st.st_size == 0 && tries < 2000; tries++)
+                pause();
+            if (fstat(fd, &st) != 0 || st.st_size != (off_t)sizeof(Layout)) {
+                close(fd);
+                error = "segment " + name + " has a different layout (remove it from /dev/shm)";
+                return false;
+            }
+        } else if (ftruncate(fd, sizeof(Layout)) != 0) {
+            error = strerror(errno);
+            close(fd);
+            shm_unlink(name.c_str());
+            return false;
+        }
+
+        void* p = mmap(nullptr, sizeof(Layout), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (p == MAP_FAILED) { error = strerror(errno); return false; }
+        data = static_cast<Layout*>(p);
+
+        if (creator) {
+            data->magic = SHARED_TABLE_MAGIC;
+            data->version = SHARED_TABLE_VERSION;
+            data->recordSize = sizeof(Record);
+            data->capacity = Capacity;
+            data->loaded = 0;
+            data->generation = 0;
+            data->count = 0;
+            data->counter = 0;
+
+            pthread_mutexattr_t attr;
+            pthread_mutexattr_init(&attr);
+            pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+            pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+            pthread_mutex_init(&data->mutex, &attr);
+            pthread_mutexattr_destroy(&attr);
+
+            data->ready.store(1, std::memory_order_release);
+        } else {
+            for (int tries = 0; data->ready.load(std::memory_order_acquire) == 0 && tries < 2000; tries++)
+                pause();
+
+            if (data->ready.load(std::memory_order_acquire) == 0 ||
+                data->magic != SHARED_TABLE_MAGIC || data->version != SHARED_TABLE_VERSION ||
+                data->recordSize != sizeof(Record) || data->capacity != (uint32_t)Capacity) {
+                munmap(data, sizeof(Layout));
+                data = nullptr;
+                error = "segment " + name + " has a different layout (remove it from /dev/shm)";
+                return false;
+            }
+        }
+        return true;
+    }
+
+    Layout* get() { return data; }
+
+    void lock() {
+        // A process that died holding the lock leaves it "owner dead".
+        // Records are plain fixed-size structs, so they stay readable
+        // even if that process was cut off mid-copy.
+        if (pthread_mutex_lock(&data->mutex) == EOWNERDEAD)
+            pthread_mutex_consistent(&data->mutex);
+    }
+
+    void unlock() { pthread_mutex_unlock(&data->mutex); }
+};
+
+#endif // _WIN32
+
+// Holds the table lock for one operation; does nothing when table is null
+template <class Table>
+class SharedScope {
+private:
+    Table* table;
+
+public:
+    explicit SharedScope(Table* t) : table(t) { if (table) table->lock(); }
+    ~SharedScope() { if (table) table->unlock(); }
+
+    SharedScope(const SharedScope&) = delete;
+    SharedScope& operator=(const SharedScope&) = delete;
+
+    bool active() const { return table != nullptr; }
+};
+
+#endif // SHARED_TABLE_HPP
@@ -0,0 +1,230 @@
+#ifndef SNAPSHOT_HPP
+#define SNAPSHOT_HPP
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+// ==============================================
+//  Binary snapshot of one manager's data
+// ==============================================
+// Layout (little-endian, native struct layout):
+//
+//   SnapshotHeader
+//   recordCount x fixed-width record     (module-specific POD struct)
+//   string heap                          (bytes referenced by StrRef)
+//
+// Strings are stored once in the heap and referenced by offset/length,
+// so a record can be read straight out of the mapped file: no
+// tokenizing and no stoi at startup.
+//
+// A snapshot sits next to its CSV (X.csv -> X.csv.snap) and remembers
+// the size and a checksum of the CSV written with it. It is used only if
+// the CSV is there and still has both, so a CSV edited by hand (even
+// within the same second, or to the same length) is parsed instead,
+// which keeps CSV as the import/export format. Checking reads the CSV
+// once, which costs far less than parsing it.
+
+const char     SNAPSHOT_MAGIC[4] = {'H', 'S', 'N', 'P'};
+const uint32_t SNAPSHOT_VERSION  = 2;   // 2: CSV checksum
+
+enum SnapshotKind : uint32_t {
+    SNAPSHOT_PATIENT = 1,
+    SNAPSHOT_MEDICAL,
+    SNAPSHOT_EMERGENCY,
+    SNAPSHOT_AMBULANCE
+};
+
+struct SnapshotHeader {
+    char     magic[4];
+    uint32_t version;
+    uint32_t kind;
+    uint32_t recordSize;
+    uint64_t recordCount;
+    uint64_t heapOffset;
+    uint64_t heapSize;
+    int64_t  counter;     // module ID counter (lastID / nextID)
+    uint64_t csvSize;     // size of the CSV written together with this snapshot
+    uint64_t csvChecksum; // snapshotChecksum() of that CSV
+};
+
+struct StrRef {
+    uint32_t offset;
+    uint32_t length;
+};
+
+inline std::string snapshotPathFor(const std::string &csvPath) {
+    return csvPath + ".snap";
+}
+
+// FNV-1a, 64-bit
+inline uint64_t snapshotChecksum(const char *data, size_t size) {
+    uint64_t h = 14695981039346656037ULL;
+    for (size_t i = 0; i < size; i++) {
+        h ^= (unsigned char)data[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+// Checksum of a file expected to be `size` bytes; false if it is not
+inline bool fileChecksum(const std::string &path, uint64_t size, uint64_t &out) {
+    FILE *f = fopen(path.c_str(), "rb");
+    if (f == nullptr) return false;
+    std::vector<char> data((size_t)size + 1);
+    size_t got = fread(data.data(), 1, data.size(), f);
+    fclose(f);
+    if (got != size) return false;
+    out = snapshotChecksum(data.data(), got);
+    return true;
+}
+
+// ===============================
+// Writer: collects records and strings, then produces the file bytes
+// ===============================
+class SnapshotWriter {
+private:
+    std::string records;
+    std::string heap;
+    uint64_t    count;
+
+public:
+    SnapshotWriter() : count(0) {}
+
+    StrRef addString(const std::string &s) {
+        StrRef ref = {(uint32_t)heap.size(), (uint32_t)s.size()};
+        heap += s;
+        return ref;
+    }
+
+    template <class Record>
+    void addRecord(const Record &r) {
+        records.append(reinterpret_cast<const char*>(&r), sizeof(Record));
+        count++;
+    }
+
+    template <class Record>
+    std::string finish(SnapshotKind kind, int64_t counter, const std::string &csv) const {
+        SnapshotHeader h;
+        memset(&h, 0, sizeof(h));
+        memcpy(h.magic, SNAPSHOT_MAGIC, 4);
+        h.version = SNAPSHOT_VERSION;
+        h.kind = kind;
+        h.recordSize = sizeof(Record);
+        h.recordCount = count;
+        h.heapOffset = sizeof(SnapshotHeader) + records.size();
+        h.heapSize = heap.size();
+        h.counter = counter;
+        h.csvSize = csv.size();
+        h.csvChecksum = snapshotChecksum(csv.data(), csv.size());
+
+        std::string out(reinterpret_cast<const char*>(&h), sizeof(h));
+        out += records;
+        out += heap;
+        return out;
+    }
+};
+
+// ===============================
+// Reader: maps a snapshot file and checks it before use
+// ===============================
+class SnapshotView {
+private:
+    const char*       base;
+    size_t            length;
+    std::vector<char> buffer;   // used where mmap is unavailable
+    bool              mapped;
+
+    void release() {
+#ifndef _WIN32
+        if (mapped) munmap(const_cast<char*>(base), length);
+#endif
+        base = nullptr;
+        length = 0;
+        mapped = false;
+        buffer.clear();
+    }
+
+    const SnapshotHeader& header() const {
+        return *reinterpret_cast<const SnapshotHeader*>(base);
+    }
+
+public:
+    SnapshotView() : base(nullptr), length(0), mapped(false) {}
+    ~SnapshotView() { release(); }
+
+    SnapshotView(const SnapshotView&) = delete;
+    SnapshotView& operator=(const SnapshotView&) = delete;
+
+    // Open snapshotPathFor(csvPath) if it is valid and was written with
+    // the CSV as it is now. Returns false (and leaves the view empty)
+    // otherwise.
+    template <class Record>
+    bool open(const std::string &csvPath, SnapshotKind kind) {
+        release();
+        std::string path = snapshotPathFor(csvPath);
+
+        struct stat snapStat, csvStat;
+        if (stat(path.c_str(), &snapStat) != 0 || stat(csvPath.c_str(), &csvStat) != 0) return false;
+        if ((size_t)snapStat.st_size < sizeof(SnapshotHeader)) return false;
+
+#ifndef _WIN32
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        void *p = mmap(nullptr, (size_t)snapStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (p == MAP_FAILED) return false;
+        base = static_cast<const char*>(p);
+        length = (size_t)snapStat.st_size;
+        mapped = true;
+#else
+        FILE *f = fopen(path.c_str(), "rb");
+        if (f == nullptr) return false;
+        buffer.resize((size_t)snapStat.st_size);
+        size_t got = fread(buffer.data(), 1, buffer.size(), f);
+        fclose(f);
+        if (got != buffer.size()) { release(); return false; }
+        base = buffer.data();
+        length = buffer.size();
+#endif
+
+        const SnapshotHeader &h = header();
+        bool ok = memcmp(h.magic, SNAPSHOT_MAGIC, 4) == 0 &&
+                  h.version == SNAPSHOT_VERSION &&
+                  h.kind == kind &&
+                  h.recordSize == sizeof(Record) &&
+                  h.heapOffset == sizeof(SnapshotHeader) + h.recordCount * sizeof(Record) &&
+                  h.heapOffset + h.heapSize == length &&
+                  h.csvSize == (uint64_t)csvStat.st_size;
+        uint64_t sum;
+        ok = ok && fileChecksum(csvPath, h.csvSize, sum) && sum == h.csvChecksum;
+        if (!ok) release();
+        return ok;
+    }
+
+    size_t  count() const   { return (size_t)header().recordCount; }
+    int64_t counter() const { return header().counter; }
+
+    template <class Record>
+    const Record& record(size_t i) const {
+        return reinterpret_cast<const Record*>(base + sizeof(SnapshotHeader))[i];
+    }
+
+    // String bytes are bounds-checked so a damaged file can't read past the end
+    std::string text(StrRef ref) const {
+        const SnapshotHeader &h = header();
+        if ((uint64_t)ref.offset + ref.length > h.heapSize) return "";
+        return std::string(base + h.heapOffset + ref.offset, ref.length);
+    }
+};
+
+#endif // SNAPSHOT_HPP
@@ -0,0 +1,305 @@
+#ifndef STATS_HPP
+#define STATS_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <mutex>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "Trace.hpp"
+
+// ==============================================
+//  Operation latency statistics
+// ==============================================
+// Every manager operation and every file write is timed into a histogram
+// with power-of-two buckets (bucket b holds durations in [2^(b-1), 2^b) ns).
+//
+// Each thread records into its own block, so the hot path is a clock read
+// and a few relaxed stores: no locks and no shared cache lines. A reader
+// adds up all blocks, plus the totals left behind by threads that exited.
+
+enum StatOp {
+    STAT_PATIENT_LOAD = 0,
+    STAT_PATIENT_SAVE,
+    STAT_PATIENT_ADMIT,
+    STAT_PATIENT_DISCHARGE,
+    STAT_MEDICAL_LOAD,
+    STAT_MEDICAL_SAVE,
+    STAT_MEDICAL_ADD,
+    STAT_MEDICAL_USE,
+    STAT_EMERGENCY_LOAD,
+    STAT_EMERGENCY_SAVE,
+    STAT_EMERGENCY_LOG,
+    STAT_EMERGENCY_PROCESS,
+    STAT_AMBULANCE_LOAD,
+    STAT_AMBULANCE_SAVE,
+    STAT_AMBULANCE_REGISTER,
+    STAT_AMBULANCE_ROTATE,
+    STAT_AMBULANCE_STATUS,
+    STAT_FILE_WRITE,
+    STAT_OP_COUNT
+};
+
+inline const char* statName(int op) {
+    static const char* names[STAT_OP_COUNT] = {
+        "patient.load",   "patient.save",   "patient.admit",     "patient.discharge",
+        "medical.load",   "medical.save",   "medical.add",       "medical.use",
+        "emergency.load", "emergency.save", "emergency.log",     "emergency.process",
+        "ambulance.load", "ambulance.save", "ambulance.register", "ambulance.rotate",
+        "ambulance.status", "file.write"
+    };
+    return op >= 0 && op < STAT_OP_COUNT ? names[op] : "?";
+}
+
+const int STAT_BUCKETS = 48;   // up to 2^47 ns, about 39 hours
+
+// Totals for one operation, as shown in the report
+struct StatSummary {
+    std::string name;
+    uint64_t    count;
+    double      meanMicros;
+    double      p50Micros;
+    double      p99Micros;
+    double      maxMicros;
+};
+
+class StatsRegistry {
+public:
+    struct Histogram {
+        uint64_t buckets[STAT_BUCKETS];
+        uint64_t count;
+        uint64_t sumNanos;
+        uint64_t maxNanos;
+    };
+
+private:
+    // Written only by its owning thread; atomics so a reader may look at
+    // any time. Relaxed load + store (not fetch_add) since there is one writer.
+    struct ThreadBlock {
+        std::atomic<uint64_t> buckets[STAT_OP_COUNT][STAT_BUCKETS];
+        std::atomic<uint64_t> count[STAT_OP_COUNT];
+        std::atomic<uint64_t> sumNanos[STAT_OP_COUNT];
+        std::atomic<uint64_t> maxNanos[STAT_OP_COUNT];
+
+        ThreadBlock() {
+            for (int op = 0; op < STAT_OP_COUNT; op++) {
+                for (int b = 0; b < STAT_BUCKETS; b++) buckets[op][b].store(0);
+                count[op].store(0);
+                sumNanos[op].store(0);
+                maxNanos[op].store(0);
+            }
+        }
+    };
+
+    // Registers this thread's block on first use and folds it into
+    // `retired` when the thread exits
+    struct ThreadSlot {
+        ThreadBlock block;
+        ThreadSlot()  { StatsRegistry::instance().add(&block); }
+        ~ThreadSlot() { StatsRegistry::instance().remove(&block); }
+    };
+
+    std::mutex                lock;      // guards the lists, never taken by record()
+    std::vector<ThreadBlock*> live;
+    Histogram                 retired[STAT_OP_COUNT];
+
+    StatsRegistry() {
+        for (int op = 0; op < STAT_OP_COUNT; op++) clear(retired[op]);
+    }
+
+    static void clear(Histogram &h) {
+        for (int b = 0; b < STAT_BUCKETS; b++) h.buckets[b] = 0;
+        h.count = h.sumNanos = h.maxNanos = 0;
+    }
+
+    static void bump(std::atomic<uint64_t> &c, uint64_t by) {
+        c.store(c.load(std::memory_order_relaxed) + by, std::memory_order_relaxed);
+    }
+
+    static void addBlock(const ThreadBlock &t, Histogram *into) {
+        for (int op = 0; op < STAT_OP_COUNT; op++) {
+            for (int b = 0; b < STAT_BUCKETS; b++)
+                into[op].buckets[b] += t.buckets[op][b].load(std::memory_order_relaxed);
+            into[op].count += t.count[op].load(std::memory_order_relaxed);
+            into[op].sumNanos += t.sumNanos[op].load(std::memory_order_relaxed);
+            uint64_t m = t.maxNanos[op].load(std::memory_order_relaxed);
+            if (m > into[op].maxNanos) into[op].maxNanos = m;
+        }
+    }
+
+    void add(ThreadBlock *t) {
+        std::lock_guard<std::mutex> guard(lock);
+        live.push_back(t);
+    }
+
+    void remove(ThreadBlock *t) {
+        std::lock_guard<std::mutex> guard(lock);
+        addBlock(*t, retired);
+        for (size_t i = 0; i < live.size(); i++)
+            if (live[i] == t) { live.erase(live.begin() + i); break; }
+    }
+
+    static int bucketFor(uint64_t nanos) {
+        int b = 0;
+        while (nanos != 0 && b < STAT_BUCKETS - 1) { nanos >>= 1; b++; }
+        return b;
+    }
+
+    // Upper edge of the bucket holding the q-th fraction of samples,
+    // capped at the largest value actually seen
+    static double quantileMicros(const Histogram &h, double q) {
+        if (h.count == 0) return 0;
+        uint64_t rank = (uint64_t)(q * (double)(h.count - 1)) + 1;
+        uint64_t seen = 0;
+        for (int b = 0; b < STAT_BUCKETS; b++) {
+            seen += h.buckets[b];
+            if (seen >= rank) {
+                uint64_t edge = b == 0 ? 0 : (uint64_t)1 << b;
+                if (edge > h.maxNanos) edge = h.maxNanos;
+                return edge / 1000.0;
+            }
+        }
+        return h.maxNanos / 1000.0;
+    }
+
+public:
+    // Never destroyed: threads may still record while statics are torn down
+    static StatsRegistry& instance() {
+        static StatsRegistry* r = new StatsRegistry();
+        return *r;
+    }
+
+    StatsRegistry(const StatsRegistry&) = delete;
+    StatsRegistry& operator=(const StatsRegistry&) = delete;
+
+    static ThreadBlock& threadBlock() {
+        thread_local ThreadSlot slot;
+        return slot.block;
+    }
+
+    // Register the calling thread now instead of on its first record().
+    // A fork()ed child (see Hospital/Backup.cpp) has no other threads, so
+    // it must not find `lock` held by one.
+    void attachThread() { threadBlock(); }
+
+    void record(StatOp op, uint64_t nanos) {
+        ThreadBlock &t = threadBlock();
+        bump(t.buckets[op][bucketFor(nanos)], 1);
+        bump(t.count[op], 1);
+        bump(t.sumNanos[op], nanos);
+        if (nanos > t.maxNanos[op].load(std::memory_order_relaxed))
+            t.maxNanos[op].store(nanos, std::memory_order_relaxed);
+    }
+
+    // Combined histograms of all threads, past and present
+    void collect(Histogram (&out)[STAT_OP_COUNT]) {
+        std::lock_guard<std::mutex> guard(lock);
+        for (int op = 0; op < STAT_OP_COUNT; op++) out[op] = retired[op];
+        for (ThreadBlock *t : live) addBlock(*t, out);
+    }
+
+    // One line per operation that ran at least once
+    std::vector<StatSummary> summary() {
+        Histogram all[STAT_OP_COUNT];
+        collect(all);
+
+        std::vector<StatSummary> rows;
+        for (int op = 0; op < STAT_OP_COUNT; op++) {
+            const Histogram &h = all[op];
+            if (h.count == 0) continue;
+            rows.push_back(StatSummary{statName(op), h.count,
+                                       h.sumNanos / 1000.0 / h.count,
+                                       quantileMicros(h, 0.50),
+                                       quantileMicros(h, 0.99),
+                                       h.maxNanos / 1000.0});
+        }
+        return rows;
+    }
+
+    void printTable(std::ostream &out) {
+        std::vector<StatSummary> rows = summary();
+
+        out << "\n==================== Operation Latency (microseconds) ====================\n";
+        if (rows.empty()) {
+            out << "No operations recorded yet.\n";
+            return;
+        }
+
+        std::ostringstream t;
+        t << std::left << std::setw(22) << "Operation" << std::right
+          << std::setw(10) << "Count" << std::setw(12) << "Mean"
+          << std::setw(12) << "p50" << std::setw(12) << "p99" << std::setw(12) << "Max" << "\n";
+        t << std::string(80, '-') << "\n";
+        t << std::fixed << std::setprecision(1);
+        for (const StatSummary &r : rows) {
+            t << std::left << std::setw(22) << r.name << std::right
+              << std::setw(10) << r.count << std::setw(12) << r.meanMicros
+              << std::setw(12) << r.p50Micros << std::setw(12) << r.p99Micros
+              << std::setw(12) << r.maxMicros << "\n";
+        }
+        t << "p50/p99 are bucket upper bounds (power of two nanoseconds).\n";
+        out << t.str();
+    }
+
+    // {"operations":[{"name":..,"count":..,"mean_us":..,"p50_us":..,"p99_us":..,"max_us":..,
+    //                 "buckets":[[upper_ns,count],...]},...]}
+    std::string json() {
+        Histogram all[STAT_OP_COUNT];
+        collect(all);
+
+        std::ostringstream j;
+        j << std::fixed << std::setprecision(3);
+        j << "{\"operations\":[";
+        bool first = true;
+        for (int op = 0; op < STAT_OP_COUNT; op++) {
+            const Histogram &h = all[op];
+            if (h.count == 0) continue;
+            if (!first) j << ",";
+            first = false;
+
+            j << "{\"name\":\"" << statName(op) << "\",\"count\":" << h.count
+              << ",\"mean_us\":" << h.sumNanos / 1000.0 / h.count
+              << ",\"p50_us\":" << quantileMicros(h, 0.50)
+              << ",\"p99_us\":" << quantileMicros(h, 0.99)
+              << ",\"max_us\":" << h.maxNanos / 1000.0
+              << ",\"buckets\":[";
+            bool firstBucket = true;
+            for (int b = 0; b < STAT_BUCKETS; b++) {
+                if (h.buckets[b] == 0) continue;
+                if (!firstBucket) j << ",";
+                firstBucket = false;
+                j << "[" << (b == 0 ? 0 : (uint64_t)1 << b) << "," << h.buckets[b] << "]";
+            }
+            j << "]}";
+        }
+        j << "]}";
+        return j.str();
+    }
+};
+
+// Times the enclosing scope: StatTimer timer(STAT_PATIENT_ADMIT);
+// Also a trace span of the same name when tracing is on.
+class StatTimer {
+private:
+    StatOp op;
+    TraceSpan span;
+    std::chrono::steady_clock::time_point start;
+
+public:
+    explicit StatTimer(StatOp o) : op(o), span(statName(o)), start(std::chrono::steady_clock::now()) {}
+    ~StatTimer() {
+        auto took = std::chrono::steady_clock::now() - start;
+        StatsRegistry::instance().record(op,
+            (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(took).count());
+    }
+
+    StatTimer(const StatTimer&) = delete;
+    StatTimer& operator=(const StatTimer&) = delete;
+};
+
+#endif // STATS_HPP
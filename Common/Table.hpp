@@ -0,0 +1,185 @@
+#ifndef TABLE_HPP
+#define TABLE_HPP
+
+#include <cstddef>
+#include <cstdlib>
+#include <initializer_list>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <io.h>
+#define tableIsTerminal(fd) _isatty(fd)
+#else
+#include <unistd.h>
+#define tableIsTerminal(fd) isatty(fd)
+#endif
+
+// ==============================================
+//  Buffered, paged table output
+// ==============================================
+// Listings used to go to cout one field at a time, and some flushed on
+// every line. TableWriter pads each cell to its column's fixed width
+// straight into one string and hands the stream a whole page at a time,
+// so a long listing costs one write per page instead of one per line.
+//
+// On a terminal it stops after every page and asks whether to go on, so
+// an operator can quit a long listing early; a row limit cuts it off
+// after a fixed number of rows either way.
+//
+//   HOSPITAL_PAGE_ROWS=N   rows per page on a terminal (default 40,
+//                          0 = never stop)
+//   HOSPITAL_VIEW_LIMIT=N  show at most N rows per listing (default all)
+
+const size_t TABLE_DEFAULT_PAGE_ROWS = 40;
+const size_t TABLE_FLUSH_BYTES = 64 * 1024;   // write in chunks when not paging
+
+struct TableColumn {
+    std::string title;
+    size_t      width;
+    bool        alignRight;
+};
+
+inline size_t tableEnvNumber(const char *name, size_t fallback) {
+    const char *value = getenv(name);
+    return value != nullptr && *value != '\0' ? (size_t)strtoul(value, nullptr, 10) : fallback;
+}
+
+// Set when std::cin stops being the terminal's (a recording or a
+// replay stands in): the lines it reads belong to the session, so a
+// pager must not take them as answers
+inline bool& tableInputRedirected() {
+    static bool redirected = false;
+    return redirected;
+}
+
+// Only ask when someone is there to answer. Recorded and replayed
+// sessions never page, so a replay sees the same input lines.
+inline size_t tablePageRows() {
+    static const size_t rows = tableIsTerminal(0) && tableIsTerminal(1)
+                                   ? tableEnvNumber("HOSPITAL_PAGE_ROWS", TABLE_DEFAULT_PAGE_ROWS) : 0;
+    return tableInputRedirected() ? 0 : rows;
+}
+
+inline size_t tableRowLimit() {
+    static const size_t limit = tableEnvNumber("HOSPITAL_VIEW_LIMIT", 0);
+    return limit;
+}
+
+class TableWriter {
+private:
+    std::ostream&            out;
+    std::vector<TableColumn> columns;
+    bool                     bordered;   // "| a | b |" instead of plain columns
+    size_t                   pageRows;   // 0 = no paging
+    size_t                   limit;      // 0 = no limit
+    size_t                   rows;
+    size_t                   rowsOnPage;
+    bool                     stopped;
+    std::string              buffer;
+
+    // A plain column's last character is always a space; text that does
+    // not fit is cut and ends in "…", so two cells never run together
+    void cell(const std::string &text, const TableColumn &c) {
+        if (c.width == 0) return;
+        size_t room = bordered ? c.width : c.width - 1;
+        size_t n = text.size();
+        bool cut = n > room;
+        if (cut) {
+            n = room > 0 ? room - 1 : 0;
+            while (n > 0 && (text[n] & 0xC0) == 0x80) n--;   // not inside a UTF-8 character
+        }
+        size_t pad = room - n - (cut ? 1 : 0);
+        if (c.alignRight) buffer.append(pad, ' ');
+        buffer.append(text, 0, n);
+        if (cut) buffer += "\xE2\x80\xA6";   // one column wide
+        if (!c.alignRight) buffer.append(pad, ' ');
+        if (!bordered) buffer += ' ';
+    }
+
+    void writeBuffer() {
+        if (buffer.empty()) return;
+        out.write(buffer.data(), (std::streamsize)buffer.size());
+        out.flush();
+        buffer.clear();
+    }
+
+    // End of a page: ask whether to go on
+    bool nextPage() {
+        writeBuffer();
+        out << "-- " << rows << " rows shown. Enter for more, q to stop: " << std::flush;
+        std::string answer;
+        if (!std::getline(std::cin, answer)) return false;
+        return answer != "q" && answer != "Q";
+    }
+
+public:
+    TableWriter(std::ostream &stream, const std::vector<TableColumn> &cols, bool withBorders = false)
+        : out(stream), columns(cols), bordered(withBorders), pageRows(tablePageRows()),
+          limit(tableRowLimit()), rows(0), rowsOnPage(0), stopped(false) {
+        buffer.reserve(TABLE_FLUSH_BYTES);
+    }
+
+    void setPageRows(size_t n) { pageRows = n; }
+    void setLimit(size_t n) { limit = n; }
+
+    // A line that is not a row (banner, rule, note)
+    void line(const std::string &text) {
+        buffer += text;
+        buffer += '\n';
+    }
+
+    // Column titles and a rule under them
+    void header() {
+        size_t width = 0;
+        if (bordered) buffer += "| ";
+        for (size_t i = 0; i < columns.size(); i++) {
+            if (i > 0) buffer += bordered ? " | " : "";
+            cell(columns[i].title, columns[i]);
+            width += columns[i].width + (bordered ? 3 : 0);
+        }
+        if (bordered) buffer += " |";
+        buffer += '\n';
+        line(std::string(width + (bordered ? 1 : 0), '-'));
+    }
+
+    // False once the listing should end (limit reached or the operator
+    // quit); callers stop producing rows then
+    bool row(std::initializer_list<std::string> cells) {
+        if (stopped) return false;
+        if (limit > 0 && rows >= limit) { stopped = true; return false; }
+        if (pageRows > 0 && rowsOnPage >= pageRows) {
+            rowsOnPage = 0;
+            if (!nextPage()) { stopped = true; return false; }
+        }
+
+        if (bordered) buffer += "| ";
+        size_t i = 0;
+        for (const std::string &text : cells) {
+            if (i >= columns.size()) break;
+            if (i > 0 && bordered) buffer += " | ";
+            cell(text, columns[i]);
+            i++;
+        }
+        if (bordered) buffer += " |";
+        buffer += '\n';
+
+        rows++;
+        rowsOnPage++;
+        if (pageRows == 0 && buffer.size() >= TABLE_FLUSH_BYTES) writeBuffer();
+        return true;
+    }
+
+    size_t shown() const { return rows; }
+
+    // totalRows = rows the caller had, to say how many were left out
+    void finish(size_t totalRows, const std::string &footer = "") {
+        if (totalRows > rows)
+            line("... " + std::to_string(totalRows - rows) + " more not shown");
+        if (!footer.empty()) line(footer);
+        writeBuffer();
+    }
+};
+
+#endif // TABLE_HPP
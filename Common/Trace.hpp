@@ -0,0 +1,169 @@
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <process.h>
+#define TRACE_PID _getpid()
+#else
+#include <unistd.h>
+#define TRACE_PID getpid()
+#endif
+
+// ==============================================
+//  Span tracing (Chrome trace-event format)
+// ==============================================
+// Off unless HOSPITAL_TRACE names an output file, e.g.
+//
+//   HOSPITAL_TRACE=trace.json ./Hospital
+//
+// then open the file in chrome://tracing or https://ui.perfetto.dev.
+//
+// A TraceSpan covers the enclosing scope. Spans on one thread nest by
+// time, so a span opened inside another shows up underneath it.
+// Each thread appends finished spans to its own ring buffer (the oldest
+// are overwritten when it is full); nothing is formatted or written
+// until the program exits.
+
+const size_t TRACE_RING_SIZE = 1 << 16;   // spans kept per thread
+
+class Tracer {
+public:
+    struct Event {
+        const char* name;    // string literal, never freed
+        uint64_t    startNs;
+        uint64_t    durNs;
+    };
+
+private:
+    struct Ring {
+        // Left uninitialised: pages are only touched as spans fill them,
+        // so creating a ring does not stall the first traced operation
+        std::unique_ptr<Event[]> events;
+        std::atomic<uint64_t>    written;   // total appended; the slot is written % size
+        int                      tid;
+
+        explicit Ring(int id) : events(new Event[TRACE_RING_SIZE]), written(0), tid(id) {}
+    };
+
+    // Rings are kept after their thread exits so its spans still get written
+    struct ThreadSlot {
+        Ring* ring;
+        ThreadSlot() : ring(Tracer::instance().addRing()) {}
+    };
+
+    bool        on;
+    std::string path;
+    std::chrono::steady_clock::time_point base;
+
+    std::mutex lock;   // guards `rings` and `nextTid`; record() never takes it
+    std::vector<std::unique_ptr<Ring>> rings;
+    int nextTid;
+
+    Tracer() : on(false), base(std::chrono::steady_clock::now()), nextTid(1) {
+        const char* env = getenv("HOSPITAL_TRACE");
+        if (env != nullptr && *env != '\0') {
+            path = env;
+            on = true;
+            atexit([] { Tracer::instance().flush(); });
+        }
+    }
+
+    Ring* addRing() {
+        std::lock_guard<std::mutex> guard(lock);
+        rings.emplace_back(new Ring(nextTid++));
+        return rings.back().get();
+    }
+
+    static void writeEvents(FILE* f, const Ring &r, int pid, bool &first) {
+        uint64_t n = r.written.load(std::memory_order_acquire);
+        uint64_t from = n > TRACE_RING_SIZE ? n - TRACE_RING_SIZE : 0;
+        for (uint64_t i = from; i < n; i++) {
+            const Event &e = r.events[i % TRACE_RING_SIZE];
+            fprintf(f, "%s\n{\"name\":\"%s\",\"cat\":\"hospital\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%d}",
+                    first ? "" : ",", e.name, e.startNs / 1000.0, e.durNs / 1000.0, pid, r.tid);
+            first = false;
+        }
+    }
+
+public:
+    // Never destroyed: threads may still end spans while statics are torn down
+    static Tracer& instance() {
+        static Tracer* t = new Tracer();
+        return *t;
+    }
+
+    Tracer(const Tracer&) = delete;
+    Tracer& operator=(const Tracer&) = delete;
+
+    bool enabled() const { return on; }
+
+    uint64_t now() const {
+        return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now() - base).count();
+    }
+
+    void record(const char* name, uint64_t startNs, uint64_t endNs) {
+        thread_local ThreadSlot slot;
+        Ring &r = *slot.ring;
+        uint64_t n = r.written.load(std::memory_order_relaxed);
+        r.events[n % TRACE_RING_SIZE] = Event{name, startNs, endNs - startNs};
+        r.written.store(n + 1, std::memory_order_release);
+    }
+
+    // Write every buffered span to the HOSPITAL_TRACE file (runs at exit)
+    void flush() {
+        if (!on) return;
+        std::lock_guard<std::mutex> guard(lock);
+
+        FILE* f = fopen(path.c_str(), "w");
+        if (f == nullptr) {
+            fprintf(stderr, "[ERROR] Cannot write trace file: %s\n", path.c_str());
+            return;
+        }
+
+        int pid = (int)TRACE_PID;
+        bool first = true;
+        fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+        for (const auto &r : rings) writeEvents(f, *r, pid, first);
+        fprintf(f, "\n]}\n");
+        fclose(f);
+    }
+};
+
+// Times the enclosing scope as one span: TraceSpan span("emergency.logCase");
+class TraceSpan {
+private:
+    const char* name;
+    uint64_t    start;
+
+public:
+    explicit TraceSpan(const char* n) : name(nullptr), start(0) {
+        Tracer &t = Tracer::instance();
+        if (t.enabled()) { name = n; start = t.now(); }
+    }
+    ~TraceSpan() { end(); }
+
+    // Close the span before the end of the scope (e.g. after a prompt)
+    void end() {
+        if (name != nullptr) {
+            Tracer &t = Tracer::instance();
+            t.record(name, start, t.now());
+            name = nullptr;
+        }
+    }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+};
+
+#endif // TRACE_HPP
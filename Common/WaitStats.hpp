@@ -0,0 +1,135 @@
+#ifndef WAITSTATS_HPP
+#define WAITSTATS_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "Quantile.hpp"
+
+// ==============================================
+//  Queue wait times
+// ==============================================
+// Patients and emergency cases carry the wall-clock time they joined
+// their queue. When one leaves, the wait is added to a quantile sketch
+// for its queue and key ("priority=1", "condition=Asthma Attack"), so a
+// report never looks at past records and each sketch has a fixed size.
+// The whole-queue figures are the per-condition sketches merged. Like
+// archive rows, a wait is added once the departure can't be undone.
+//
+// Conditions are free text, so at most WAIT_MAX_CONDITIONS distinct ones
+// are tracked per queue; later ones share the "condition=(other)" sketch.
+
+const size_t WAIT_MAX_CONDITIONS = 64;
+
+// Milliseconds since the epoch; stored in the data files
+inline int64_t wallClockMillis() {
+    return (int64_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+struct WaitSummary {
+    std::string queue;
+    std::string key;
+    uint64_t    count;
+    double      p50Seconds;
+    double      p90Seconds;
+    double      p99Seconds;
+    double      maxSeconds;
+};
+
+class WaitStatsRegistry {
+private:
+    struct QueueWaits {
+        std::map<int, QuantileSketch>         byPriority;
+        std::map<std::string, QuantileSketch> byCondition;
+    };
+
+    std::mutex lock;
+    std::map<std::string, QueueWaits> queues;
+
+    WaitStatsRegistry() {}
+
+    static WaitSummary summarize(const std::string &queue, const std::string &key, const QuantileSketch &s) {
+        return WaitSummary{queue, key, s.count(), s.quantile(0.50), s.quantile(0.90),
+                           s.quantile(0.99), s.max()};
+    }
+
+public:
+    // Never destroyed: managers may record while statics are torn down
+    static WaitStatsRegistry& instance() {
+        static WaitStatsRegistry* r = new WaitStatsRegistry();
+        return *r;
+    }
+
+    // priority < 0 = the queue has no priorities; leftAtMillis 0 = now
+    void record(const std::string &queue, int64_t enqueuedAtMillis, int priority, const std::string &condition,
+                int64_t leftAtMillis = 0) {
+        int64_t waited = (leftAtMillis != 0 ? leftAtMillis : wallClockMillis()) - enqueuedAtMillis;
+        if (waited < 0) waited = 0;   // clock moved back
+        double seconds = waited / 1000.0;
+
+        std::lock_guard<std::mutex> guard(lock);
+        QueueWaits &q = queues[queue];
+        if (priority >= 0) q.byPriority[priority].add(seconds);
+
+        auto it = q.byCondition.find(condition);
+        if (it == q.byCondition.end()) {
+            // emplace finds "(other)" if it is already there
+            const char* key = q.byCondition.size() < WAIT_MAX_CONDITIONS ? condition.c_str() : "(other)";
+            it = q.byCondition.emplace(key, QuantileSketch()).first;
+        }
+        it->second.add(seconds);
+    }
+
+    // One row per queue ("all"), then per priority and per condition
+    std::vector<WaitSummary> summary() {
+        std::lock_guard<std::mutex> guard(lock);
+        std::vector<WaitSummary> rows;
+        for (const auto &q : queues) {
+            // Every wait is in exactly one condition sketch, so they add
+            // up to the whole queue
+            QuantileSketch all;
+            for (const auto &c : q.second.byCondition) all.merge(c.second);
+            rows.push_back(summarize(q.first, "all", all));
+            for (const auto &p : q.second.byPriority)
+                rows.push_back(summarize(q.first, "priority=" + std::to_string(p.first), p.second));
+            for (const auto &c : q.second.byCondition)
+                rows.push_back(summarize(q.first, "condition=" + c.first, c.second));
+        }
+        return rows;
+    }
+
+    void printTable(std::ostream &out) {
+        std::vector<WaitSummary> rows = summary();
+
+        out << "\n======================= Queue Wait Times (seconds) =======================\n";
+        if (rows.empty()) {
+            out << "Nobody has left a queue yet.\n";
+            return;
+        }
+
+        std::ostringstream t;
+        t << std::left << std::setw(11) << "Queue" << std::setw(27) << "Group" << std::right
+          << std::setw(7) << "Count" << std::setw(9) << "p50" << std::setw(9) << "p90"
+          << std::setw(9) << "p99" << std::setw(9) << "Max" << "\n";
+        t << std::string(81, '-') << "\n";
+        t << std::fixed << std::setprecision(1);
+        for (const WaitSummary &r : rows) {
+            std::string key = r.key.size() > 26 ? r.key.substr(0, 23) + "..." : r.key;
+            t << std::left << std::setw(11) << r.queue << std::setw(27) << key << std::right
+              << std::setw(7) << r.count << std::setw(9) << r.p50Seconds << std::setw(9) << r.p90Seconds
+              << std::setw(9) << r.p99Seconds << std::setw(9) << r.maxSeconds << "\n";
+        }
+        t << "Percentiles are estimates (KLL sketch, about 1% rank error).\n";
+        out << t.str();
+    }
+};
+
+#endif // WAITSTATS_HPP
@@ -0,0 +1,306 @@
+#ifndef CONCURRENT_EMERGENCY_QUEUE_HPP
+#define CONCURRENT_EMERGENCY_QUEUE_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include "Emergency.hpp"
+using namespace std;
+
+const int EMERGENCY_PRIORITIES = 10;     // 1 = critical ... 10 = mild
+const size_t EMERGENCY_RING_SIZE = 128;  // power of two, above MAX_EMERGENCY
+const size_t EMERGENCY_CHANGE_RING_SIZE = 1024;   // power of two; unapplied changes per level
+
+// =======================================================
+// ONE PRIORITY LEVEL: BOUNDED LOCK-FREE FIFO
+// Any number of threads may push and pop. Each slot carries a sequence
+// number saying whose turn it is: a thread claims a position with one
+// compare-and-swap on the read (or write) position and only then touches
+// the slot, so every case is taken by exactly one popper.
+// =======================================================
+class EmergencyRing {
+private:
+    struct Slot {
+        atomic<size_t> sequence;
+        Emergency      value;
+    };
+
+    Slot slots[EMERGENCY_RING_SIZE];
+    alignas(64) atomic<size_t> writePos;   // own cache lines: pushers and
+    alignas(64) atomic<size_t> readPos;    // poppers don't slow each other
+
+public:
+    EmergencyRing() : writePos(0), readPos(0) {
+        for (size_t i = 0; i < EMERGENCY_RING_SIZE; i++) slots[i].sequence.store(i, memory_order_relaxed);
+    }
+
+    EmergencyRing(const EmergencyRing&) = delete;
+    EmergencyRing& operator=(const EmergencyRing&) = delete;
+
+    // False when full
+    bool push(const Emergency& e) {
+        size_t pos = writePos.load(memory_order_relaxed);
+        while (true) {
+            Slot& s = slots[pos & (EMERGENCY_RING_SIZE - 1)];
+            intptr_t diff = (intptr_t)s.sequence.load(memory_order_acquire) - (intptr_t)pos;
+            if (diff == 0) {
+                if (writePos.compare_exchange_weak(pos, pos + 1, memory_order_relaxed)) {
+                    s.value = e;
+                    s.sequence.store(pos + 1, memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = writePos.load(memory_order_relaxed);
+            }
+        }
+    }
+
+    // False when empty
+    bool pop(Emergency& out) {
+        size_t pos = readPos.load(memory_order_relaxed);
+        while (true) {
+            Slot& s = slots[pos & (EMERGENCY_RING_SIZE - 1)];
+            intptr_t diff = (intptr_t)s.sequence.load(memory_order_acquire) - (intptr_t)(pos + 1);
+            if (diff == 0) {
+                if (readPos.compare_exchange_weak(pos, pos + 1, memory_order_relaxed)) {
+                    out = move(s.value);
+                    s.sequence.store(pos + EMERGENCY_RING_SIZE, memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = readPos.load(memory_order_relaxed);
+            }
+        }
+    }
+
+    // A hint only while other threads are at work
+    bool empty() const {
+        return readPos.load(memory_order_acquire) >= writePos.load(memory_order_acquire);
+    }
+};
+
+// =======================================================
+// CHANGES TO ONE PRIORITY LEVEL
+// Logs and takes of a level, in the order they claimed a place, until
+// the applier (one thread at a time) reads them. Slots are allocated
+// once and carry sequence numbers as in EmergencyRing, so a change costs
+// one compare-and-swap on its own level's position and no allocation.
+// When the applier falls a whole ring behind, the level's loggers and
+// officers wait for it.
+// =======================================================
+struct EmergencyChange {
+    bool      logged;   // false: taken by an officer
+    int64_t   stamp;    // steady clock ns when noted: the order across levels
+    Emergency value;
+};
+
+class EmergencyChangeRing {
+private:
+    struct Slot {
+        atomic<size_t>  sequence;
+        EmergencyChange change;
+    };
+
+    unique_ptr<Slot[]> slots;
+    alignas(64) atomic<size_t> writePos;
+    alignas(64) atomic<size_t> readPos;   // the applier's
+
+public:
+    EmergencyChangeRing() : slots(new Slot[EMERGENCY_CHANGE_RING_SIZE]), writePos(0), readPos(0) {
+        for (size_t i = 0; i < EMERGENCY_CHANGE_RING_SIZE; i++) slots[i].sequence.store(i, memory_order_relaxed);
+    }
+
+    EmergencyChangeRing(const EmergencyChangeRing&) = delete;
+    EmergencyChangeRing& operator=(const EmergencyChangeRing&) = delete;
+
+    void add(bool logged, const Emergency& e) {
+        size_t pos = writePos.load(memory_order_relaxed);
+        while (true) {
+            Slot& s = slots[pos & (EMERGENCY_CHANGE_RING_SIZE - 1)];
+            intptr_t diff = (intptr_t)s.sequence.load(memory_order_acquire) - (intptr_t)pos;
+            if (diff == 0) {
+                if (writePos.compare_exchange_weak(pos, pos + 1, memory_order_relaxed)) {
+                    s.change.logged = logged;
+                    s.change.stamp = chrono::steady_clock::now().time_since_epoch().count();
+                    s.change.value = e;
+                    s.sequence.store(pos + 1, memory_order_release);
+                    return;
+                }
+            } else {
+                if (diff < 0) this_thread::yield();   // full: the applier is behind
+                pos = writePos.load(memory_order_relaxed);
+            }
+        }
+    }
+
+    // Applier only: the oldest change, or null when none is complete
+    const EmergencyChange* peek() const {
+        size_t pos = readPos.load(memory_order_relaxed);
+        const Slot& s = slots[pos & (EMERGENCY_CHANGE_RING_SIZE - 1)];
+        return s.sequence.load(memory_order_acquire) == pos + 1 ? &s.change : nullptr;
+    }
+
+    // Applier only: done with what peek() returned
+    void consume() {
+        size_t pos = readPos.load(memory_order_relaxed);
+        slots[pos & (EMERGENCY_CHANGE_RING_SIZE - 1)].sequence.store(pos + EMERGENCY_CHANGE_RING_SIZE,
+                                                                     memory_order_release);
+        readPos.store(pos + 1, memory_order_release);
+    }
+
+    // Noted but not yet consumed (a hint while other threads are at work)
+    size_t unapplied() const {
+        size_t written = writePos.load(memory_order_acquire);
+        size_t read = readPos.load(memory_order_acquire);
+        return written > read ? written - read : 0;
+    }
+};
+
+// =======================================================
+// CONCURRENT EMERGENCY QUEUE (dispatch board)
+// One lock-free FIFO per priority level. Intake desks log cases and
+// triage officers take the most critical one at the same time, with no
+// mutex anywhere: an officer pops the front of the first non-empty level,
+// so officers only ever contend on the read position of the level they
+// are emptying, and intake never waits for an officer.
+//
+// The order is relaxed: a case logged while an officer is already
+// looking past its level waits for the next officer. Within one level it
+// is first come, first served, as in EmergencyManager.
+//
+// Every log and take is also noted in its level's change ring, so the
+// cases can be applied to an EmergencyManager later (see applyTo): the
+// manager keeps the file, undo history, archive and change log.
+// =======================================================
+class ConcurrentEmergencyQueue {
+private:
+    EmergencyRing       levels[EMERGENCY_PRIORITIES];
+    EmergencyChangeRing changes[EMERGENCY_PRIORITIES];
+    atomic<int>         size;      // cases on the board, reserved before a push
+
+    static int level(int priority) {
+        return priority < 1 ? 0 : (priority > EMERGENCY_PRIORITIES ? EMERGENCY_PRIORITIES - 1 : priority - 1);
+    }
+
+    static size_t changeBytes() {
+        return EMERGENCY_PRIORITIES * EMERGENCY_CHANGE_RING_SIZE * sizeof(EmergencyChange);
+    }
+
+public:
+    ConcurrentEmergencyQueue() : size(0) {
+        MemoryRegistry::instance().allocated(MEM_EMERGENCY_BOARD, sizeof(levels) + changeBytes());
+    }
+
+    ~ConcurrentEmergencyQueue() {
+        MemoryRegistry::instance().released(MEM_EMERGENCY_BOARD, sizeof(levels) + changeBytes());
+    }
+
+    ConcurrentEmergencyQueue(const ConcurrentEmergencyQueue&) = delete;
+    ConcurrentEmergencyQueue& operator=(const ConcurrentEmergencyQueue&) = delete;
+
+    int count() const { return size.load(memory_order_acquire); }
+
+    int unapplied() const {
+        size_t n = 0;
+        for (const EmergencyChangeRing& c : changes) n += c.unapplied();
+        return (int)n;
+    }
+
+    // =======================================================
+    // LOG (any thread). False when MAX_EMERGENCY cases are waiting.
+    // The change is noted before the case can be taken, so an applier
+    // never sees a take before its log.
+    // =======================================================
+    bool logCase(const Emergency& e) {
+        if (!reserve()) return false;
+        logReserved(e);
+        return true;
+    }
+
+    // logCase in two steps, for a caller that has work to do (register
+    // the person) only once the case is sure to fit: a true reserve()
+    // must be followed by logReserved()
+    bool reserve() {
+        if (size.fetch_add(1, memory_order_acq_rel) >= MAX_EMERGENCY) {
+            size.fetch_sub(1, memory_order_acq_rel);
+            return false;
+        }
+        return true;
+    }
+
+    void logReserved(const Emergency& e) {
+        int l = level(e.priority);
+        changes[l].add(true, e);
+        levels[l].push(e);   // a level holds at most MAX_EMERGENCY
+    }
+
+    // =======================================================
+    // TAKE THE MOST CRITICAL CASE (any thread). False when empty.
+    // The take is noted before its place is given up, so a log that only
+    // fit because of it is stamped, and applied, after it.
+    // =======================================================
+    bool popCritical(Emergency& out) {
+        for (int l = 0; l < EMERGENCY_PRIORITIES; l++) {
+            if (levels[l].empty() || !levels[l].pop(out)) continue;
+            changes[l].add(false, out);
+            size.fetch_sub(1, memory_order_acq_rel);
+            return true;
+        }
+        return false;
+    }
+
+    // =======================================================
+    // Refill from a list (in list order), dropping unapplied changes.
+    // Only while no other thread uses the board.
+    // =======================================================
+    void reset(const EmergencyVersion& cases) {
+        Emergency e;
+        for (int l = 0; l < EMERGENCY_PRIORITIES; l++)
+            while (levels[l].pop(e)) {}
+        size.store(0);
+        applyTo([](const Emergency&) {}, [](const Emergency&) {});
+
+        cases.forEach([&](size_t, const Emergency& c) {
+            if (levels[level(c.priority)].push(c)) size.fetch_add(1);
+            return true;
+        });
+    }
+
+    // =======================================================
+    // Hand every noted change to onLogged or onTaken: the levels merged
+    // by stamp, each level in its own order, a take first on a tie. One
+    // thread at a time; returns how many there were.
+    // =======================================================
+    template <class Logged, class Taken>
+    int applyTo(Logged onLogged, Taken onTaken) {
+        int n = 0;
+        while (true) {
+            int best = -1;
+            const EmergencyChange* next = nullptr;
+            for (int l = 0; l < EMERGENCY_PRIORITIES; l++) {
+                const EmergencyChange* c = changes[l].peek();
+                if (c == nullptr) continue;
+                if (next == nullptr || c->stamp < next->stamp ||
+                    (c->stamp == next->stamp && !c->logged && next->logged)) {
+                    best = l;
+                    next = c;
+                }
+            }
+            if (best < 0) break;
+
+            if (next->logged) onLogged(next->value);
+            else onTaken(next->value);
+            changes[best].consume();
+            n++;
+        }
+        return n;
+    }
+};
+
+#endif
@@ -1,29 +1,167 @@
 #include "Emergency.hpp"
+#include "../Common/Persistence.hpp"
+#include "../Common/Snapshot.hpp"
+#include "../Common/Stats.hpp"
+#include "../Common/Trace.hpp"
+#include "../Common/Recorder.hpp"
+#include "../Common/Table.hpp"
+#include "../Common/WaitStats.hpp"
+#include "../Common/Archive.hpp"
 #include <iostream>
 #include <fstream>
 #include <sstream>
 #include <iomanip>
 #include <algorithm>
+#include <cstdlib>
+#include <functional>
 using namespace std;
 
 // Constructor
-EmergencyManager::EmergencyManager() {
-    size = 0;
-    nextID = 1;
-    loadFromCSV();
+EmergencyManager::EmergencyManager(bool load) {
+    sharedGeneration = 0;
+    if (load)
+        loadFromCSV();
 }
 
 // Helpers
 bool EmergencyManager::isFull() const {
-    return size >= MAX_EMERGENCY;
+    return cases.size() >= (size_t)MAX_EMERGENCY;
 }
 
 bool EmergencyManager::isEmpty() const {
-    return size == 0;
+    return cases.empty();
+}
+
+int EmergencyManager::count() const {
+    return (int)cases.size();
+}
+
+string caseIDFor(PatientHandle patient) {
+    char buffer[16];
+    sprintf(buffer, "P%03d", PatientRegistry::instance().get(patient).id);
+    return buffer;
+}
+
+// "P012" is patient 12; other IDs belong to no known patient (0)
+static int casePatientNumber(const string &id) {
+    return id.size() > 1 && id[0] == 'P' ? atoi(id.c_str() + 1) : 0;
+}
+
+// Registry entry for a case read from the CSV, a snapshot or shared memory
+PatientHandle adoptCasePatient(const string &id, const string &name, const string &type) {
+    return PatientRegistry::instance().adopt(casePatientNumber(id), name, type);
+}
+
+// Registry entries for a whole list of loaded cases (names[i] is the name
+// of loaded[i]). A case keeps the ID it was saved with even when that
+// patient ID belongs to someone else here (an admission patient, say):
+// its person then gets a fresh ID, above every ID in the list, and the
+// case stays under its own.
+static void adoptCasePatients(vector<Emergency> &loaded, const vector<string> &names) {
+    int highest = 0;
+    for (const Emergency &e : loaded)
+        highest = max(highest, casePatientNumber(e.id));
+    PatientRegistry::instance().reserveIDs(highest);
+
+    for (size_t i = 0; i < loaded.size(); i++) {
+        Emergency &e = loaded[i];
+        e.patient = adoptCasePatient(e.id, names[i], e.type);
+        if (e.id.empty())
+            e.id = caseIDFor(e.patient);
+    }
+}
+
+// Index of the most critical case, -1 if empty
+int EmergencyManager::findCritical() const {
+    return mostCriticalIndex(cases);
+}
+
+int EmergencyManager::findByID(const string &id) const {
+    int found = -1;
+    cases.forEach([&](size_t i, const Emergency &e) {
+        if (e.id == id)
+            found = (int)i;
+        return found < 0;
+    });
+    return found;
+}
+
+void EmergencyManager::eraseAt(int index) {
+    cases.eraseAt(index);
+}
+
+// Shared memory: copy the segment into cases if another process changed it
+void EmergencyManager::pullShared(bool force) {
+    EmergencyTable::Layout *seg = shared->get();
+    if (!force && seg->generation == sharedGeneration)
+        return;
+
+    vector<Emergency> loaded(seg->count);
+    vector<string> names(seg->count);
+    for (int i = 0; i < seg->count; i++) {
+        loaded[i].id = seg->records[i].id;
+        loaded[i].type = seg->records[i].type;
+        names[i] = seg->records[i].name;
+        loaded[i].priority = seg->records[i].priority;
+        loaded[i].loggedAt = seg->records[i].loggedAt;
+    }
+    adoptCasePatients(loaded, names);
+    cases.assign(loaded);
+    history.clear();   // our old versions would undo someone else's work
+    sharedGeneration = seg->generation;
+}
+
+// Shared memory: publish cases after a change
+void EmergencyManager::pushShared() {
+    EmergencyTable::Layout *seg = shared->get();
+
+    cases.forEach([&](size_t i, const Emergency &e) {
+        copyText(seg->records[i].id, e.id);
+        copyText(seg->records[i].name, e.name());
+        copyText(seg->records[i].type, e.type);
+        seg->records[i].priority = e.priority;
+        seg->records[i].loggedAt = e.loggedAt;
+        return true;
+    });
+    seg->count = count();
+    sharedGeneration = ++seg->generation;
+}
+
+bool EmergencyManager::enableSharedMemory(const string &name) {
+    unique_ptr<EmergencyTable> table(new EmergencyTable());
+    string error;
+    if (!table->attach(name, error)) {
+        cout << "[Warning] Shared memory unavailable (" << error << "). Using private data." << endl;
+        return false;
+    }
+
+    shared = move(table);
+    SharedScope<EmergencyTable> scope(shared.get());
+    if (!shared->get()->loaded) {
+        pushShared();   // first process: seed the segment from our CSV
+        shared->get()->loaded = 1;
+    } else {
+        pullShared(true);
+    }
+    return true;
+}
+
+void EmergencyManager::refresh() {
+    SharedScope<EmergencyTable> scope(shared.get());
+    if (scope.active())
+        pullShared();
+}
+
+bool EmergencyManager::getAt(int index, Emergency &out) const {
+    if (index < 0 || index >= count())
+        return false;
+    out = cases.at(index);
+    return true;
 }
 
 // Safe Input
 string EmptyVal(const string &prompt) {
+    TraceSpan span("emergency.prompt");
     string input;
     while (true) {
         cout << prompt;
@@ -78,73 +216,135 @@ int MenuChoiceVal(const string &prompt, int min, int max) {
     }
 }
 
+// Fixed-width snapshot record (strings live in the snapshot heap)
+struct EmergencyRecord {
+    StrRef  id;
+    StrRef  name;
+    StrRef  type;
+    int32_t priority;
+    int64_t loggedAt;
+};
+
+// Load Snapshot (returns false if there is no usable snapshot)
+bool EmergencyManager::loadFromSnapshot() {
+    TraceSpan span("emergency.loadSnapshot");
+    SnapshotView snap;
+    if (!snap.open<EmergencyRecord>(EMERGENCY_CSV, SNAPSHOT_EMERGENCY))
+        return false;
+
+    vector<Emergency> loaded;
+    vector<string> names;
+    for (size_t i = 0; i < snap.count() && loaded.size() < (size_t)MAX_EMERGENCY; i++) {
+        const EmergencyRecord &r = snap.record<EmergencyRecord>(i);
+        Emergency e;
+        e.id = snap.text(r.id);
+        e.type = snap.text(r.type);
+        e.priority = r.priority;
+        e.loggedAt = r.loggedAt;
+        loaded.push_back(e);
+        names.push_back(snap.text(r.name));
+    }
+    adoptCasePatients(loaded, names);
+    cases.assign(loaded);
+    return true;
+}
+
 // Load CSV
 void EmergencyManager::loadFromCSV() {
+    StatTimer timer(STAT_EMERGENCY_LOAD);
+    if (loadFromSnapshot())
+        return;
+
+    TraceSpan span("emergency.parseCSV");
     ifstream file(EMERGENCY_CSV);
     if (!file.is_open()) 
         return;
 
     string line;
-    size = 0;
+    vector<Emergency> loaded;
+    vector<string> names;
 
     getline(file, line);
 
+    // Files without a Logged At column: count waits from now
+    int64_t loadedAt = wallClockMillis();
+
     while (getline(file, line)) {
         if (line.empty()) 
             continue;
 
         stringstream ss(line);
-        string idStr, name, type, priStr;
+        string idStr, name, type, priStr, loggedStr;
 
         getline(ss, idStr, ',');
         getline(ss, name, ',');
         getline(ss, type, ',');
         getline(ss, priStr, ',');
+        getline(ss, loggedStr, ',');
 
         idStr.erase(0, idStr.find_first_not_of(" "));
         name.erase(0, name.find_first_not_of(" "));
         type.erase(0, type.find_first_not_of(" "));
         priStr.erase(0, priStr.find_first_not_of(" "));
+        loggedStr.erase(0, loggedStr.find_first_not_of(" "));
 
         Emergency e;
-        e.id = idStr;
-        e.name = name;
+        e.id = idStr.substr(0, idStr.find_last_not_of(" ") + 1);
         e.type = type;
         e.priority = stoi(priStr);
+        e.loggedAt = loggedStr.empty() ? loadedAt : atoll(loggedStr.c_str());
 
-        cases[size++] = e;
+        loaded.push_back(e);
+        names.push_back(name);
 
-        if (idStr[0] == 'P') {
-            int num = stoi(idStr.substr(1));
-            if (num >= nextID) 
-                nextID = num + 1;
-        }
-
-        if (size >= MAX_EMERGENCY) 
+        if (loaded.size() >= (size_t)MAX_EMERGENCY) 
             break;
     }
 
     file.close();
+    adoptCasePatients(loaded, names);
+    cases.assign(loaded);
 }
 
 // Save CSV
 void EmergencyManager::saveToCSV() const {
-    ofstream file(EMERGENCY_CSV);
-
-    file << "ID, Patient Name, Emergency Type, Priority Level" << endl;
-
-    for (int i = 0; i < size; i++) {
-        file << cases[i].id << ", "
-             << cases[i].name << ", "
-             << cases[i].type << ", "
-             << cases[i].priority << endl;
-    }
-
-    file.close();
+    StatTimer timer(STAT_EMERGENCY_SAVE);
+    ostringstream file;
+
+    file << "ID, Patient Name, Emergency Type, Priority Level, Logged At" << endl;
+
+    SnapshotWriter snap;
+    EmergencyVersion saved = cases;   // frozen: later changes don't show up
+    saved.forEach([&](size_t, const Emergency &e) {
+        file << e.id << ", "
+             << e.name() << ", "
+             << e.type << ", "
+             << e.priority << ", "
+             << e.loggedAt << endl;
+
+        EmergencyRecord r;
+        r.id = snap.addString(e.id);
+        r.name = snap.addString(e.name());
+        r.type = snap.addString(e.type);
+        r.priority = e.priority;
+        r.loggedAt = e.loggedAt;
+        snap.addRecord(r);
+        return true;
+    });
+
+    string csv = file.str();
+
+    // Queued on the background writer unless processes share the data.
+    // The snapshot goes second so it is never newer than a stale CSV.
+    bool sync = shared != nullptr;
+    persistFile(EMERGENCY_CSV, csv, sync);
+    persistFile(snapshotPathFor(EMERGENCY_CSV),
+                snap.finish<EmergencyRecord>(SNAPSHOT_EMERGENCY, PatientRegistry::instance().getLastID(), csv), sync);
 }
 
 // Log Case
 void EmergencyManager::logCase() {
+    TraceSpan span("emergency.logCase");
     if (isFull()) {
         cout << "Emergency list is full!" << endl << endl;
         return;
@@ -152,40 +352,107 @@ void EmergencyManager::logCase() {
 
     cout << endl << "============= Log Emergency Case ==============" << endl;
 
-    Emergency e;
+    // A patient already in the system keeps their record and ID
+    PatientHandle patient = NO_PATIENT;
+    TraceSpan prompt("emergency.prompt");
+    cout << "Existing patient ID (blank for new patient): ";
+    string idText;
+    getline(cin, idText);
+    prompt.end();
+    if (!idText.empty()) {
+        if (toupper(idText[0]) == 'P')
+            idText.erase(0, 1);
+        patient = PatientRegistry::instance().find(atoi(idText.c_str()));
+        if (patient == NO_PATIENT) {
+            cout << "No patient with that ID, logging a new patient." << endl;
+        } else if (findByID(caseIDFor(patient)) >= 0) {
+            cout << "This patient already has a pending emergency case!" << endl << endl;
+            return;
+        } else {
+            cout << "Patient: " << PatientRegistry::instance().get(patient).name << endl;
+        }
+    }
 
-    char buffer[10];
-    sprintf(buffer, "P%03d", nextID++);
-    e.id = buffer;
+    string name;
+    if (patient == NO_PATIENT)
+        name = EmptyVal("Enter patient name: ");
+    string type = EmptyVal("Enter emergency type: ");
+    int priority = PriorityVal("Priority (1 = critical, 10 = mild): ");
 
-    e.name = EmptyVal("Enter patient name: ");
-    e.type = EmptyVal("Enter emergency type: ");
-    e.priority = PriorityVal("Priority (1 = critical, 10 = mild): ");
+    string id = patient == NO_PATIENT ? addCase(name, type, priority) : addCaseFor(patient, type, priority);
+    if (id.empty())
+        cout << "Emergency list is full!" << endl << endl;
+    else
+        cout << "Emergency case " << id << " added!" << endl << endl;
+}
 
-    cases[size++] = e;
+// Add Case for a new patient (no prompts). Returns the new ID, or "" when the list is full.
+string EmergencyManager::addCase(const string &name, const string &type, int priority, bool save) {
+    if (isFull())
+        return "";
+    return addCaseFor(PatientRegistry::instance().registerPerson(name, type), type, priority, save);
+}
 
-    saveToCSV();
-    cout << "Emergency case added!" << endl << endl;
+// Add Case for a registered patient (no prompts). Returns "" when the
+// list is full or the case ID is taken.
+string EmergencyManager::addCaseFor(PatientHandle patient, const string &type, int priority, bool save,
+                                    int64_t loggedAt, const string &caseID) {
+    StatTimer timer(STAT_EMERGENCY_LOG);
+    SharedScope<EmergencyTable> scope(shared.get());
+    if (scope.active())
+        pullShared();
+
+    string id = caseID.empty() ? caseIDFor(patient) : caseID;
+    if (isFull() || findByID(id) >= 0)
+        return "";
+
+    Emergency e;
+    e.id = id;
+    e.patient = patient;
+    e.type = type;
+    e.priority = priority;
+    e.loggedAt = loggedAt != 0 ? loggedAt : wallClockMillis();
+
+    history.record(cases, "logging of case " + e.id + " " + e.name());
+    cases.pushBack(e);
+    if (changeLogOn())
+        logChange("emergency", "log", changeFields(e));
+
+    if (scope.active())
+        pushShared();
+    if (save)
+        saveToCSV();
+    return e.id;
+}
+
+// A processed case leaves its wait in the stats and its row in the
+// archive; the undo history does both once it can't be undone any more
+static function<void()> departureOf(const Emergency &c) {
+    if (!departuresRecorded())
+        return function<void()>();
+    ArchivedRecord row{wallClockMillis(), c.loggedAt, PatientRegistry::instance().get(c.patient).id,
+                       c.priority, c.type, c.name()};
+    return [row]() {
+        WaitStatsRegistry::instance().record("emergency", row.enqueuedAt, row.priority, row.type, row.removedAt);
+        RecordArchive(EMERGENCY_ARCHIVE).append(row);
+    };
 }
 
 // Process Critical Case
 void EmergencyManager::processCritical() {
+    TraceSpan span("emergency.processCritical");
     if (isEmpty()) {
         cout << endl << "No emergency cases available!" << endl;
         return;
     }
 
-    int bestIndex = 0;
-    for (int i = 1; i < size; i++) {
-        if (cases[i].priority < cases[bestIndex].priority)
-            bestIndex = i;
-    }
+    int bestIndex = findCritical();
 
-    Emergency c = cases[bestIndex];
+    Emergency c = cases.at(bestIndex);
 
     cout << endl << "============== Most Critical Case ==============" << endl;
     cout << "ID       : " << c.id << endl;
-    cout << "Name     : " << c.name << endl;
+    cout << "Name     : " << c.name() << endl;
     cout << "Type     : " << c.type << endl;
     cout << "Priority : " << c.priority << endl;
     cout << "===============================================" << endl;
@@ -209,42 +476,167 @@ void EmergencyManager::processCritical() {
         }
     }
 
-    for (int i = bestIndex; i < size - 1; i++) {
-        cases[i] = cases[i + 1];
+    // Another officer may have taken it while we were confirming
+    Emergency removed;
+    if (!processByID(c.id, removed)) {
+        cout << "Case was already processed by another officer!" << endl << endl;
+        return;
     }
 
-    size--;
-    saveToCSV();
-
     cout << "Case processed and removed!" << endl << endl;
 }
 
+// Process Critical Case (no prompts)
+bool EmergencyManager::popCritical(Emergency &out, bool save) {
+    StatTimer timer(STAT_EMERGENCY_PROCESS);
+    SharedScope<EmergencyTable> scope(shared.get());
+    if (scope.active())
+        pullShared();
+
+    int bestIndex = findCritical();
+    if (bestIndex < 0)
+        return false;
+
+    out = cases.at(bestIndex);
+    history.record(cases, "processing of case " + out.id + " " + out.name(), departureOf(out));
+    eraseAt(bestIndex);
+    if (changeLogOn())
+        logChange("emergency", "process", ChangeFields{{"id", out.id}});
+
+    if (scope.active())
+        pushShared();
+    if (save)
+        saveToCSV();
+    return true;
+}
+
+// Process a specific case (no prompts)
+bool EmergencyManager::processByID(const string &id, Emergency &out, bool save) {
+    return takeByID(id, out, save, "processing");
+}
+
+// Take a specific case out of the list (no prompts)
+bool EmergencyManager::popByID(const string &id, Emergency &out, bool save) {
+    return takeByID(id, out, save, "removal");
+}
+
+// what names the change for the undo history
+bool EmergencyManager::takeByID(const string &id, Emergency &out, bool save, const string &what) {
+    StatTimer timer(STAT_EMERGENCY_PROCESS);
+    SharedScope<EmergencyTable> scope(shared.get());
+    if (scope.active())
+        pullShared();
+
+    int index = findByID(id);
+    if (index < 0)
+        return false;
+
+    out = cases.at(index);
+    // Only a processed case is archived; a removed one moved elsewhere
+    history.record(cases, what + " of case " + out.id + " " + out.name(),
+                   what == "processing" ? departureOf(out) : function<void()>());
+    eraseAt(index);
+    if (changeLogOn())
+        logChange("emergency", what == "processing" ? "process" : "remove", ChangeFields{{"id", out.id}});
+
+    if (scope.active())
+        pushShared();
+    if (save)
+        saveToCSV();
+    return true;
+}
+
+// Remove a specific case (no prompts)
+bool EmergencyManager::removeByID(const string &id, bool save) {
+    Emergency removed;
+    return popByID(id, removed, save);
+}
+
+// Undo (no prompts)
+bool EmergencyManager::undoLastChange(bool save) {
+    SharedScope<EmergencyTable> scope(shared.get());
+    if (scope.active())
+        pullShared();   // changes from elsewhere clear the history
+
+    if (!history.undo(cases))
+        return false;
+    if (changeLogOn())
+        logChange("emergency", "undo");
+
+    if (scope.active())
+        pushShared();
+    if (save)
+        saveToCSV();
+    return true;
+}
+
+string EmergencyManager::lastChange() const {
+    return history.canUndo() ? history.lastChange() : "";
+}
+
+// Undo Last Change
+void EmergencyManager::undoPrompt() {
+    TraceSpan span("emergency.undo");
+    string what = lastChange();
+    if (what.empty()) {
+        cout << endl << "Nothing to undo!" << endl << endl;
+        return;
+    }
+
+    string confirm;
+    while (true) {
+        confirm = EmptyVal("Undo " + what + "? (Y/N): ");
+
+        for (char &ch : confirm)
+            ch = toupper(ch);
+
+        if (confirm == "Y") {
+            break;
+        }
+        else if (confirm == "N") {
+            cout << "Cancelled! Returning to menu..." << endl << endl;
+            return;
+        }
+        else {
+            cout << "Please enter Y or N only!" << endl;
+        }
+    }
+
+    if (!undoLastChange()) {
+        cout << "List was changed by another officer, nothing to undo!" << endl << endl;
+        return;
+    }
+
+    cout << "Undone: " << what << endl << endl;
+}
+
 // View Cases
 void EmergencyManager::viewCases() const {
+    TraceSpan span("emergency.viewCases");
     if (isEmpty()) {
         cout << endl << "No cases available!" << endl << endl;
         return;
     }
 
-    cout << endl << "================ Pending Emergency Cases ===============" << endl;
-
-    Emergency sorted[MAX_EMERGENCY];
-    for (int i = 0; i < size; i++) sorted[i] = cases[i];
+    vector<Emergency> sorted;
+    version().forEach([&](size_t, const Emergency &e) {
+        sorted.push_back(e);
+        return true;
+    });
 
-    sort(sorted, sorted + size,
+    sort(sorted.begin(), sorted.end(),
          [](const Emergency &a, const Emergency &b) {
              return a.priority < b.priority;
          });
 
-    cout << left << setw(10) << "ID" << setw(16) << "Name" << setw(18) << "Type" << setw(10) << "Priority" << endl;
-
-    cout << string(56, '-') << endl;
+    TableWriter table(cout, {{"ID", 10, false}, {"Name", 16, false}, {"Type", 18, false}, {"Priority", 10, false}});
+    table.line("\n================ Pending Emergency Cases ===============");
+    table.header();
 
-    for (int i = 0; i < size; i++) {
-        cout << setw(8) << sorted[i].id << setw(15) << sorted[i].name << setw(24) << sorted[i].type << sorted[i].priority << endl;
-    }
+    for (size_t i = 0; i < sorted.size(); i++)
+        if (!table.row({sorted[i].id, sorted[i].name(), sorted[i].type, to_string(sorted[i].priority)})) break;
 
-    cout << string(56, '-') << endl << endl;
+    table.finish(sorted.size(), string(56, '-') + "\n");
 }
 
 // Menu
@@ -257,9 +649,11 @@ void emergencyMenu(EmergencyManager &manager) {
         cout << "2. Process Most Critical Case" << endl;
         cout << "3. View Pending Emergency Cases" << endl;
         cout << "4. Back to Main Menu" << endl;
+        cout << "5. Undo Last Change" << endl;
         cout << "===============================================" << endl;
 
-        choice = MenuChoiceVal("Enter your choice: ", 1, 4);
+        choice = MenuChoiceVal("Enter your choice: ", 1, 5);
+        manager.refresh();
 
         if (choice == 1) 
             manager.logCase();
@@ -267,15 +661,23 @@ void emergencyMenu(EmergencyManager &manager) {
             manager.processCritical();
         else if (choice == 3) 
             manager.viewCases();
-        else if (choice == 4) 
+        else if (choice == 4) {
             cout << "Exiting Emergency Department Officer. Goodbye!" << endl;
             cout << "Returning to main menu..." << endl;
+        }
+        else if (choice == 5) 
+            manager.undoPrompt();
 
     } while (choice != 4);
 }
 
+#ifndef HOSPITAL_SINGLE_PROCESS
 int main() {
+    startRecordingFromEnv("emergency");
     EmergencyManager manager;
+    if (getenv("HOSPITAL_SHM"))
+        manager.enableSharedMemory();
     emergencyMenu(manager);
     return 0;
-}
\ No newline at end of file
+}
+#endif
@@ -1,43 +1,145 @@
 #ifndef EMERGENCY_HPP
 #define EMERGENCY_HPP
 
+#include <memory>
 #include <string>
+#include "../Common/SharedTable.hpp"
+#include "../Common/Persistent.hpp"
+#include "../Common/ChangeLog.hpp"
+#include "../Patient/PatientRegistry.hpp"
 using namespace std;
 
 const string EMERGENCY_CSV = "Emergency/Emergency.csv";
+const string EMERGENCY_SHM = "/hospital_emergency";
+const string EMERGENCY_ARCHIVE = "Emergency/Emergency.archive"; // processed cases
 const int MAX_EMERGENCY = 100;
 
+// The case ID is the patient's registry ID ("P007"), so a person keeps
+// the same ID across admission and emergency. A loaded case keeps the ID
+// it was saved with, even if its person was given another one.
 struct Emergency {
     string id; 
-    string name;
+    PatientHandle patient;
     string type;
     int priority;
+    int64_t loggedAt;   // wall clock ms when the case was logged
+
+    const string& name() const { return PatientRegistry::instance().get(patient).name; }
 };
 
-// Emergency Manager (Priority Queue using Array)
+// The name is the registry's; only the case's own strings count here
+inline void accountStrings(const Emergency &e, MemoryAccount account, int sign) {
+    accountString(account, e.id, sign);
+    accountString(account, e.type, sign);
+}
+
+// Change log line for a logged case (see Common/ChangeLog.hpp)
+inline ChangeFields changeFields(const Emergency &e) {
+    return ChangeFields{{"id", e.id}, {"name", e.name()}, {"type", e.type},
+                        {"priority", to_string(e.priority)}, {"logged", to_string(e.loggedAt)}};
+}
+
+// Fixed-layout copy of Emergency kept in shared memory
+struct SharedEmergency {
+    char id[8];
+    char name[64];
+    char type[64];
+    int  priority;
+    int64_t loggedAt;
+};
+
+typedef SharedTable<SharedEmergency, MAX_EMERGENCY> EmergencyTable;
+
+// Cases in logging order; a copy is a frozen version
+typedef PersistentSeq<Emergency, MEM_EMERGENCY_NODES, MEM_EMERGENCY_STRINGS> EmergencyVersion;
+
+// The case to treat next: lowest priority number, earliest logged among
+// equals; -1 when there is none. Cases is anything with empty() and
+// forEach(f(index, case)) in logging order (the manager's list, or the
+// capacity simulator's fixed array).
+template <class Cases>
+int mostCriticalIndex(const Cases &cases) {
+    if (cases.empty())
+        return -1;
+
+    int bestIndex = -1;
+    int bestPriority = 0;
+    cases.forEach([&](size_t i, const auto &e) {
+        if (bestIndex < 0 || e.priority < bestPriority) {
+            bestIndex = (int)i;
+            bestPriority = e.priority;
+        }
+        return true;
+    });
+    return bestIndex;
+}
+
+// Emergency Manager (Priority Queue over a persistent sequence)
 class EmergencyManager {
 private:
-    Emergency cases[MAX_EMERGENCY];
-    int size;                       
-    int nextID;
-    string generateID();
+    EmergencyVersion cases;
+    UndoHistory<EmergencyVersion> history;   // versions before recent changes
+    int findCritical() const;
+    int findByID(const string &id) const;
+    void eraseAt(int index);
+    bool takeByID(const string &id, Emergency &out, bool save, const string &what);
+
+    // Shared memory mode (null when off)
+    unique_ptr<EmergencyTable> shared;
+    uint64_t sharedGeneration;
+    void pullShared(bool force = false);
+    void pushShared();
 
 public:
-    EmergencyManager();
+    // load = false starts empty without reading the CSV (standby)
+    explicit EmergencyManager(bool load = true);
 
     bool isFull() const;
     bool isEmpty() const;
+    int count() const;
 
-    void loadFromCSV();
-    void saveToCSV() const;
+    void loadFromCSV();     // uses the binary snapshot when it is current
+    bool loadFromSnapshot();
+    void saveToCSV() const; // writes the CSV and its snapshot
 
-    void logCase();
+    void logCase();     // existing patient ID, or a new walk-in
     void processCritical();
     void viewCases() const;
+    void undoPrompt();
+
+    // Non-interactive versions (no prompts)
+    string addCase(const string &name, const string &type, int priority, bool save = true);
+    // loggedAt 0 = now; caseID "" = the patient's ID (a standby passes the
+    // primary's, which may differ for a case loaded under its own ID)
+    string addCaseFor(PatientHandle patient, const string &type, int priority, bool save = true,
+                      int64_t loggedAt = 0, const string &caseID = "");
+    bool popCritical(Emergency &out, bool save = true);
+    bool processByID(const string &id, Emergency &out, bool save = true);   // treated: archived
+    bool popByID(const string &id, Emergency &out, bool save = true);       // moved elsewhere
+    bool getAt(int index, Emergency &out) const;
+    bool hasCase(const string &id) const { return findByID(id) >= 0; }
+    bool removeByID(const string &id, bool save = true);
+    EmergencyVersion version() const { return cases; }
+
+    // Restore the list as it was before the last change made by this
+    // process; lastChange() describes it ("" when there is nothing)
+    bool undoLastChange(bool save = true);
+    string lastChange() const;
+    // After a change the other modules share (a transfer): undo stops here
+    void forgetHistory() { history.clear(); }
+
+    // Keep cases in a named shared-memory segment so several processes
+    // see the same live list. The first process to attach seeds it.
+    bool enableSharedMemory(const string &name = EMERGENCY_SHM);
+    void refresh();   // pick up changes made by other processes
+    bool isShared() const { return shared != nullptr; }
 };
 
 void emergencyMenu(EmergencyManager &manager);
 
+string caseIDFor(PatientHandle patient);
+PatientHandle adoptCasePatient(const string &id, const string &name, const string &type);
+
 string EmptyVal(const string &prompt);
 int PriorityVal(const string &prompt);
 int MenuChoiceVal(const string &prompt, int min, int max);
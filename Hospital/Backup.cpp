@@ -0,0 +1,203 @@
+#include "Backup.hpp"
+#include "../Common/Persistence.hpp"
+#include "../Common/Trace.hpp"
+#include "../Common/WaitStats.hpp"
+
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+#ifndef _WIN32
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+static mutex  statusLock;
+static string lastDir;
+static string lastStatus = "none";
+
+string lastBackupStatus(string &dir) {
+    lock_guard<mutex> guard(statusLock);
+    dir = lastDir;
+    return lastStatus;
+}
+
+#ifdef _WIN32
+
+bool startBackup(HospitalSystem &, const string &, BackupStart &, string &error) {
+    error = "online backup is only available on POSIX systems";
+    return false;
+}
+
+#else
+
+static string timeName() {
+    time_t now = time(nullptr);
+    tm local;
+    localtime_r(&now, &local);
+    char buffer[32];
+    strftime(buffer, sizeof(buffer), "%Y%m%d-%H%M%S", &local);
+    return buffer;
+}
+
+// Backup names become directory names
+static bool validBackupName(const string &name) {
+    if (name.empty() || name.size() > 64 || name[0] == '.') return false;
+    for (char c : name)
+        if (!isalnum((unsigned char)c) && c != '_' && c != '-' && c != '.') return false;
+    return true;
+}
+
+// ===============================
+// Child: write everything, then _exit
+// ===============================
+// The only thread here is the one that forked; every other thread of the
+// parent (background writer, server workers) is gone, and so is any lock
+// one of them held. Saves therefore go straight to disk (persistRedirect)
+// and the child leaves with _exit, running no destructors or exit hooks.
+//
+// Every descriptor but standard input and output is closed first: a
+// listening socket, client connection or standby link held open here
+// would outlive the parent's close() of it for as long as the backup runs.
+static void closeInheritedFiles() {
+#ifdef SYS_close_range
+    if (syscall(SYS_close_range, 3, ~0U, 0) == 0) return;
+#endif
+    long maxFd = sysconf(_SC_OPEN_MAX);
+    for (long fd = 3; fd < (maxFd > 0 ? maxFd : 1024); fd++) close((int)fd);
+}
+
+static int writeBackup(HospitalSystem &hospital, const string &dir, int64_t takenAt) {
+    closeInheritedFiles();
+
+    PersistRedirect &redirect = persistRedirect();
+    redirect.dir = dir;
+    redirect.failures = 0;
+
+    hospital.getPatients().saveToCSV("Patient.csv");
+    hospital.getSupplies().saveAll();
+    hospital.getEmergency().saveToCSV();
+    hospital.getAmbulance().saveToFile();
+    if (redirect.failures > 0) return 1;
+
+    ostringstream manifest;
+    manifest << "taken_at=" << takenAt << "\n"
+             << "patients=" << hospital.getPatients().count() << "\n"
+             << "supplies=" << hospital.getSupplies().count() << "\n"
+             << "store_rooms=" << hospital.getSupplies().roomNames().size() << "\n"
+             << "emergency_cases=" << hospital.getEmergency().count() << "\n"
+             << "ambulances=" << hospital.getAmbulance().getQueue().size() << "\n";
+    return writeFileAtomically(dir + "/" + BACKUP_MANIFEST, manifest.str()) ? 0 : 1;
+}
+
+// Parent: reap the child so it doesn't linger as a zombie
+static void awaitBackup(pid_t pid, string dir) {
+    int status = 0;
+    bool ok = waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    {
+        lock_guard<mutex> guard(statusLock);
+        if (lastDir == dir) lastStatus = ok ? "done" : "failed";
+    }
+    if (!ok) cerr << "[ERROR] Backup to " << dir << " failed.\n";
+}
+
+bool startBackup(HospitalSystem &hospital, const string &name, BackupStart &started, string &error) {
+    string chosen = name.empty() ? timeName() : name;
+    if (!validBackupName(chosen)) {
+        error = "backup name must be letters, digits, '.', '-' or '_'";
+        return false;
+    }
+    {
+        lock_guard<mutex> guard(statusLock);
+        if (lastStatus == "running") {
+            error = "a backup is already running (" + lastDir + ")";
+            return false;
+        }
+    }
+
+    string dir = BACKUP_DIR + "/" + chosen;
+    error_code ec;
+    if (filesystem::exists(dir, ec)) {
+        error = dir + " already exists";
+        return false;
+    }
+    for (const char *sub : {"Medical", "Emergency", "Ambulance"}) {
+        if (!filesystem::create_directories(dir + "/" + sub, ec)) {
+            error = "cannot create " + dir + ": " + ec.message();
+            return false;
+        }
+    }
+
+    // What the child uses must not be locked by a thread it won't have
+    StatsRegistry::instance().attachThread();
+    TraceSpan freeze("hospital.backupFreeze");
+
+    auto start = chrono::steady_clock::now();
+    pid_t pid;
+    {
+        unique_lock<shared_mutex> patientGuard(hospital.lockFor(DATA_PATIENT));
+        unique_lock<shared_mutex> medicalGuard(hospital.lockFor(DATA_MEDICAL));
+        unique_lock<shared_mutex> emergencyGuard(hospital.lockFor(DATA_EMERGENCY));
+        unique_lock<shared_mutex> ambulanceGuard(hospital.lockFor(DATA_AMBULANCE));
+        lock_guard<mutex> dispatchGuard(hospital.dispatchLock());
+
+        // Take in what is still on its way to the managers
+        if (hospital.drainAdmissions() > 0) hospital.saveDataset(DATA_PATIENT);
+        hospital.applyDispatch();
+        // Modules that share memory pick up other processes' changes (any
+        // of them may have attached without the rest)
+        hospital.getPatients().refresh();
+        hospital.getMedical().refresh();
+        hospital.getEmergency().refresh();
+        hospital.getAmbulance().refresh();
+
+        shared_lock<shared_mutex> registryGuard = PatientRegistry::instance().holdStill();
+        freeze.end();   // the span is recorded here, not in the child
+        cout.flush();   // or the child would hold a copy of unwritten output
+        int64_t takenAt = wallClockMillis();
+        pid = fork();
+        if (pid == 0) _exit(writeBackup(hospital, dir, takenAt));
+    }
+    started.pauseMillis = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+    if (pid < 0) {
+        error = string("fork failed: ") + strerror(errno);
+        return false;
+    }
+
+    {
+        lock_guard<mutex> guard(statusLock);
+        lastDir = dir;
+        lastStatus = "running";
+    }
+    thread(awaitBackup, pid, dir).detach();
+
+    started.dir = dir;
+    started.pid = (int)pid;
+    return true;
+}
+
+#endif
+
+void backupMenu(HospitalSystem &hospital) {
+    BackupStart started;
+    string error;
+    if (!startBackup(hospital, "", started, error)) {
+        cout << "[ERROR] " << error << "\n";
+        return;
+    }
+    cout << "[INFO] Backup started in " << started.dir << " (operations paused "
+         << fixed << setprecision(2) << started.pauseMillis << " ms).\n"
+         << "       It is complete once " << started.dir << "/" << BACKUP_MANIFEST << " exists.\n";
+    cout.unsetf(ios::floatfield);
+}
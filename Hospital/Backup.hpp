@@ -0,0 +1,42 @@
+#ifndef BACKUP_HPP
+#define BACKUP_HPP
+
+#include <string>
+
+#include "Hospital.hpp"
+
+// Online backup of every data set as it was at one moment.
+//
+// startBackup() takes all four module locks (patient first, as
+// everywhere else), so no change is half done, and forks. The parent
+// lets go of the locks as soon as fork() returns and carries on serving:
+// operators wait only for the fork itself. The child has the managers
+// exactly as they were at that moment, since the kernel shares memory
+// copy-on-write and copies a page only when the parent changes it, and
+// writes them with the normal save code under BACKUP_DIR/<name>, laid
+// out like the working directory. BACKUP_MANIFEST is written last: a
+// backup without it is unfinished or failed.
+//
+// POSIX only.
+
+const std::string BACKUP_DIR = "backups";
+const std::string BACKUP_MANIFEST = "backup.txt";
+
+struct BackupStart {
+    std::string dir;
+    int         pid;           // the child writing it
+    double      pauseMillis;   // how long operators were held up
+};
+
+// name "" = the current local time (YYYYMMDD-HHMMSS). False, with error
+// saying why, when no backup was started.
+bool startBackup(HospitalSystem &hospital, const std::string &name, BackupStart &started, std::string &error);
+
+// The most recent backup of this process: "none", "running", "done" or
+// "failed"; dir is where it went
+std::string lastBackupStatus(std::string &dir);
+
+// Main menu option
+void backupMenu(HospitalSystem &hospital);
+
+#endif // BACKUP_HPP
@@ -0,0 +1,606 @@
+#include "Hospital.hpp"
+#include "ThreadPool.hpp"
+#include "Script.hpp"
+#include "Server.hpp"
+#include "Replay.hpp"
+#include "Replica.hpp"
+#include "Backup.hpp"
+#include "Simulation.hpp"
+#include "../Common/Recorder.hpp"
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <future>
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <cctype>
+#include <algorithm>
+#include <thread>
+
+using namespace std;
+
+// ===============================
+// Timing helper
+// ===============================
+static double millisSince(chrono::steady_clock::time_point start) {
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+// ===============================
+// Constructor
+// ===============================
+HospitalSystem::HospitalSystem() : dispatchReady(false), dispatchDiverged(0), totalLoadMillis(0), sharedMemory(false) {
+    for (int i = 0; i < HOSPITAL_DATASETS; i++)
+        reports[i] = LoadReport{"", 0, 0};
+}
+
+// ===============================
+// Parallel startup loader
+// ===============================
+void HospitalSystem::loadAll(int threads) {
+    TraceSpan span("hospital.loadAll");
+    auto start = chrono::steady_clock::now();
+
+    {
+        ThreadPool pool(threads);
+        future<LoadReport> jobs[HOSPITAL_DATASETS];
+
+        // Emergency cases join the patient registry after the admission
+        // queue has, so an ID that both files use (for different people)
+        // is always kept by the patient file
+        promise<void> patientsDone;
+        shared_future<void> patientsLoaded = patientsDone.get_future().share();
+
+        jobs[DATA_PATIENT] = pool.submit([this, &patientsDone] {
+            auto t = chrono::steady_clock::now();
+            patients.loadFromCSV("Patient.csv");
+            patientsDone.set_value();
+            return LoadReport{"Patient.csv", patients.count(), millisSince(t)};
+        });
+
+        jobs[DATA_MEDICAL] = pool.submit([this] {
+            auto t = chrono::steady_clock::now();
+            medical.reset(new SupplyStore());
+            return LoadReport{"Medical/Medical*.csv", medical->count(), millisSince(t)};
+        });
+
+        jobs[DATA_EMERGENCY] = pool.submit([this, patientsLoaded] {
+            patientsLoaded.wait();
+            auto t = chrono::steady_clock::now();
+            emergency.reset(new EmergencyManager());
+            return LoadReport{EMERGENCY_CSV, emergency->count(), millisSince(t)};
+        });
+
+        jobs[DATA_AMBULANCE] = pool.submit([this] {
+            auto t = chrono::steady_clock::now();
+            ambulance.loadFromFile();
+            return LoadReport{"Ambulance/Ambulance.csv", ambulance.getQueue().size(), millisSince(t)};
+        });
+
+        // Join before the menu appears
+        for (int i = 0; i < HOSPITAL_DATASETS; i++)
+            reports[i] = jobs[i].get();
+    }
+
+    totalLoadMillis = millisSince(start);
+}
+
+void HospitalSystem::startEmpty() {
+    patients = PatientQueue();
+    medical.reset(new SupplyStore(false));
+    emergency.reset(new EmergencyManager(false));
+    ambulance = AmbulanceManager();
+    triaged.clear();
+    dispatchReady = false;
+    PatientRegistry::instance().clear();   // nothing refers to it any more
+}
+
+void HospitalSystem::enableSharedMemory() {
+    bool ok = patients.enableSharedMemory();
+    ok = medical->mainRoom().enableSharedMemory() && ok;   // other store rooms stay private
+    ok = emergency->enableSharedMemory() && ok;
+    ok = ambulance.enableSharedMemory() && ok;
+    sharedMemory = ok;
+}
+
+int HospitalSystem::drainAdmissions() {
+    int moved = 0;
+    Admission a;
+    while (admissions.dischargePatient(a)) {
+        // Only a shared segment fills up; the desk was already told "ok"
+        if (patients.admitPatient(a.id, a.name, a.condition, false, a.enqueuedAt) < 0) {
+            cerr << "[WARN] Patient queue full: admission of " << a.name << " (ID " << a.id << ") lost.\n";
+            continue;
+        }
+        moved++;
+    }
+    return moved;
+}
+
+// Changes come oldest first, a log always before the take of its case,
+// and whole-list changes apply the board before they start: every take
+// finds its case in the list
+// A change the list refuses means board and list no longer agree (the
+// board is only as good as its last refill); it is reported and counted
+int HospitalSystem::applyDispatch() {
+    int applied = dispatch.applyTo(
+        [this](const Emergency &e) {
+            if (emergency->addCaseFor(e.patient, e.type, e.priority, false, e.loggedAt, e.id) == e.id) return;
+            dispatchDiverged++;
+            cerr << "[WARN] Dispatch board logged case " << e.id << ", but the emergency list refused it.\n";
+        },
+        [this](const Emergency &e) {
+            Emergency out;
+            if (emergency->processByID(e.id, out, false)) return;
+            dispatchDiverged++;
+            cerr << "[WARN] Dispatch board took case " << e.id << ", but the emergency list does not have it.\n";
+        });
+    if (applied > 0)
+        saveDataset(DATA_EMERGENCY);
+    return applied;
+}
+
+void HospitalSystem::refillDispatch() {
+    applyDispatch();
+    dispatch.reset(emergency->version());
+    dispatchReady = true;
+}
+
+void HospitalSystem::releaseDispatch() {
+    applyDispatch();
+    dispatchReady = false;
+}
+
+// ===============================
+// Transfers between admission and emergency
+// ===============================
+string HospitalSystem::triageNextPatient(const string &type, int priority, string &error, bool save) {
+    emergency->refresh();
+    if (emergency->isFull()) {
+        error = "emergency list full";
+        return "";
+    }
+
+    Patient p;
+    if (!patients.takeForTriage(p, save)) {
+        error = "queue empty";
+        return "";
+    }
+
+    string caseID = emergency->addCaseFor(p.person, type, priority, save);
+    if (caseID.empty()) {
+        // Filled up by another process, or the case ID is taken: by the
+        // patient's own case, or by a case loaded under that ID
+        patients.restoreTriaged(p, save);
+        error = "emergency case " + caseIDFor(p.person) + " already exists";
+        return "";
+    }
+
+    // Cases processed or returned since need their entries no more
+    for (auto it = triaged.begin(); it != triaged.end(); ) {
+        if (!emergency->hasCase(it->first)) it = triaged.erase(it);
+        else ++it;
+    }
+    triaged[caseID] = p;
+    // Undoing the new case alone would leave the patient in neither module
+    emergency->forgetHistory();
+    return caseID;
+}
+
+int HospitalSystem::returnToAdmission(const string &caseID, string &error, bool save) {
+    Emergency e;
+    if (!emergency->popByID(caseID, e, save)) {
+        error = "no such case";
+        return -1;
+    }
+
+    // Triaged here: back to their old place; otherwise to the back
+    auto it = triaged.find(caseID);
+    bool back = it != triaged.end() && it->second.person == e.patient
+                    ? patients.restoreTriaged(it->second, save)
+                    : patients.admitHandle(e.patient, save);
+    if (!back) {
+        emergency->addCaseFor(e.patient, e.type, e.priority, save, e.loggedAt, e.id);
+        error = "patient queue full";
+        return -1;
+    }
+    if (it != triaged.end()) triaged.erase(it);
+    // Either side undone alone would put the patient in both modules or
+    // in neither
+    emergency->forgetHistory();
+    patients.forgetHistory();
+    return PatientRegistry::instance().get(e.patient).id;
+}
+
+void HospitalSystem::triageMenu() {
+    patients.refresh();
+    Patient next;
+    if (!patients.peekFront(next)) {
+        cout << "\nNo patients waiting for admission.\n";
+        return;
+    }
+
+    cout << "\nNext patient: " << next.id << " " << next.name() << " (" << next.condition() << ")\n";
+    string type = EmptyVal("Enter emergency type: ");
+    int priority = PriorityVal("Priority (1 = critical, 10 = mild): ");
+
+    string error;
+    string caseID = triageNextPatient(type, priority, error);
+    if (caseID.empty())
+        cout << "[ERROR] Could not triage: " << error << "\n";
+    else
+        cout << "Patient moved to emergency as case " << caseID << ".\n";
+}
+
+void HospitalSystem::returnMenu() {
+    emergency->viewCases();
+    string caseID = EmptyVal("Case ID to return to admission: ");
+    for (char &c : caseID) c = toupper(c);
+
+    string error;
+    int id = returnToAdmission(caseID, error);
+    if (id < 0)
+        cout << "[ERROR] Could not return case: " << error << "\n";
+    else
+        cout << "Patient " << id << " is back in the admission queue.\n";
+}
+
+void HospitalSystem::saveDataset(Dataset which) {
+    switch (which) {
+        case DATA_PATIENT:   patients.saveToCSV("Patient.csv"); break;
+        case DATA_MEDICAL:   medical->saveChanged(); break;
+        case DATA_EMERGENCY: emergency->saveToCSV(); break;
+        case DATA_AMBULANCE: ambulance.saveToFile(); break;
+    }
+}
+
+void HospitalSystem::memoryRecords(int records[MEM_MODULE_COUNT]) {
+    {
+        shared_lock<shared_mutex> guard(locks[DATA_PATIENT]);
+        records[MEM_MODULE_PATIENT] = patients.count();
+    }
+    {
+        shared_lock<shared_mutex> guard(locks[DATA_MEDICAL]);
+        records[MEM_MODULE_MEDICAL] = medical->count();
+    }
+    {
+        shared_lock<shared_mutex> guard(locks[DATA_EMERGENCY]);
+        lock_guard<mutex> apply(dispatchApply);   // board appliers only hold the shared lock
+        records[MEM_MODULE_EMERGENCY] = emergency->count();
+    }
+    {
+        shared_lock<shared_mutex> guard(locks[DATA_AMBULANCE]);
+        records[MEM_MODULE_AMBULANCE] = ambulance.getQueue().size();
+    }
+}
+
+void HospitalSystem::printLoadReport() const {
+    double sum = 0;
+
+    cout << "\n=============== Startup Load Report ===============\n";
+    cout << left << setw(28) << "File" << right << setw(8) << "Rows" << setw(14) << "Time (ms)" << "\n";
+    cout << string(50, '-') << "\n";
+
+    for (int i = 0; i < HOSPITAL_DATASETS; i++) {
+        cout << left << setw(28) << reports[i].file
+             << right << setw(8) << reports[i].rows
+             << setw(14) << fixed << setprecision(3) << reports[i].millis << "\n";
+        sum += reports[i].millis;
+    }
+
+    cout << string(50, '-') << "\n";
+    cout << "Wall time (parallel) : " << totalLoadMillis << " ms\n";
+    cout << "Sum of file times    : " << sum << " ms\n";
+    cout << "===================================================\n";
+    cout.unsetf(ios::floatfield);
+}
+
+// ===============================
+// Operation statistics
+// ===============================
+void HospitalSystem::statisticsMenu() {
+    StatsRegistry::instance().printTable(cout);
+    WaitStatsRegistry::instance().printTable(cout);
+    int records[MEM_MODULE_COUNT];
+    memoryRecords(records);
+    MemoryRegistry::instance().printTable(cout, records);
+
+    cout << "\nSave as JSON to " << STATS_JSON << "? (Y/N): ";
+    string answer;
+    if (!getline(cin, answer) || (answer != "Y" && answer != "y")) return;
+
+    if (writeFileAtomically(STATS_JSON, StatsRegistry::instance().json() + "\n"))
+        cout << "[INFO] Statistics written to " << STATS_JSON << ".\n";
+}
+
+// ===============================
+// Archive of discharged patients and processed cases
+// ===============================
+static bool askTime(const string &prompt, bool endOfDay, int64_t &out) {
+    while (true) {
+        cout << prompt;
+        string text;
+        if (!getline(cin, text) || text.empty()) return false;
+        if (parseTimeArg(text, endOfDay, out)) return true;
+        cout << "[ERROR] Use YYYY-MM-DD or YYYY-MM-DD HH:MM.\n";
+    }
+}
+
+void HospitalSystem::archiveMenu() {
+    string which;
+    while (which != "1" && which != "2") {
+        cout << "\nArchive (1 = discharged patients, 2 = processed emergencies): ";
+        if (!getline(cin, which)) return;
+    }
+    bool emergencies = which == "2";
+
+    ArchiveQuery q;
+    q.limit = 20;
+    askTime("From (blank = beginning): ", false, q.from);
+    askTime("To   (blank = now): ", true, q.to);
+    cout << (emergencies ? "Emergency type" : "Condition") << " (blank = any): ";
+    getline(cin, q.type);
+    if (emergencies) {
+        cout << "Priority (blank = any): ";
+        string p;
+        getline(cin, p);
+        if (!p.empty()) q.priority = atoi(p.c_str());
+    }
+
+    ArchiveResult r = RecordArchive(emergencies ? EMERGENCY_ARCHIVE : PATIENT_ARCHIVE).query(q);
+
+    cout << "\n" << left << setw(7) << "ID" << setw(20) << "Name" << setw(22) << (emergencies ? "Type" : "Condition")
+         << setw(5) << "Pri" << setw(21) << "Left at" << right << setw(10) << "Wait (s)" << "\n";
+    cout << string(85, '-') << "\n";
+    for (const ArchivedRecord &a : r.rows)
+        cout << left << setw(7) << a.id << setw(20) << a.name.substr(0, 19) << setw(22) << a.type.substr(0, 21)
+             << setw(5) << a.priority << setw(21) << formatMillis(a.removedAt) << right << setw(10)
+             << fixed << setprecision(1) << (a.removedAt - a.enqueuedAt) / 1000.0 << "\n";
+    if (r.matched > r.rows.size())
+        cout << "... " << r.matched - r.rows.size() << " more\n";
+
+    cout << "\nMatched " << r.matched << " of " << r.rowsScanned << " rows scanned; "
+         << r.blocksSkipped << " of " << r.blocks << " blocks skipped; "
+         << setprecision(2) << r.millis << " ms\n";
+    if (r.matched > 0)
+        cout << "Mean wait " << setprecision(1) << r.totalWaitSeconds / r.matched
+             << " s, longest " << r.maxWaitSeconds << " s\n";
+    cout.unsetf(ios::floatfield);
+}
+
+// Store room for the supply menu: asked only once there is more than one
+MedicalSupplyManager& HospitalSystem::chooseStoreRoom() {
+    vector<string> rooms = medical->roomNames();
+    if (rooms.size() < 2) return medical->mainRoom();
+
+    cout << "\nStore rooms:";
+    for (const string &r : rooms) cout << " " << r;
+    while (true) {
+        cout << "\nStore room (Enter = " << MEDICAL_MAIN_ROOM << "): ";
+        string room;
+        if (!getline(cin, room) || room.empty()) return medical->mainRoom();
+        if (validRoomName(room)) return medical->roomManager(room);
+        cout << "[ERROR] Letters, digits, '-' and '_' only.";
+    }
+}
+
+// ===============================
+// Integrated menu
+// ===============================
+void HospitalSystem::run() {
+    while (true) {
+        cout << "\n=========================================\n";
+        cout << "      HOSPITAL PATIENT CARE SYSTEM\n";
+        cout << "=========================================\n";
+        cout << "1. Patient Admission Clerk\n";
+        cout << "2. Medical Supply Manager\n";
+        cout << "3. Emergency Department Officer\n";
+        cout << "4. Ambulance Dispatcher\n";
+        cout << "5. Startup Load Report\n";
+        cout << "6. Operation Statistics\n";
+        cout << "7. Triage Next Patient to Emergency\n";
+        cout << "8. Return Emergency Case to Admission\n";
+        cout << "9. Query Discharge Archive\n";
+        cout << "10. Online Backup\n";
+        cout << "0. Exit\n";
+        cout << "Choose option: ";
+
+        string choice;
+        if (!getline(cin, choice)) break;
+
+        if (choice == "1") patientMenu(patients);
+        else if (choice == "2") medicalSupplyMenu(chooseStoreRoom());
+        else if (choice == "3") emergencyMenu(*emergency);
+        else if (choice == "4") ambulanceMenu(ambulance);
+        else if (choice == "5") printLoadReport();
+        else if (choice == "6") statisticsMenu();
+        else if (choice == "7") triageMenu();
+        else if (choice == "8") returnMenu();
+        else if (choice == "9") archiveMenu();
+        else if (choice == "10") backupMenu(*this);
+        else if (choice == "0") break;
+        else cout << "[ERROR] Invalid choice. Try again.\n";
+    }
+
+    cout << "\nExiting system. Goodbye!\n";
+}
+
+// ===============================
+// Main Program
+// ===============================
+static void printUsage() {
+    cout << "Usage:\n"
+         << "  Hospital                              interactive menu\n"
+         << "  Hospital --script FILE [--batch N]   run commands from FILE ('-' = stdin)\n"
+         << "  Hospital --exec CMD [CMD ...]         run commands given as arguments\n"
+         << "  Hospital --serve PORT|PATH [--threads N]\n"
+         << "                                        serve commands on 127.0.0.1:PORT or a Unix socket\n"
+         << "  Hospital --replay FILE [--pace fast|original] [--show]\n"
+         << "                                        replay a recorded session and report latencies\n"
+         << "  Hospital --standby DIR|unix:PATH [--serve PORT|PATH]\n"
+         << "                                        hot standby: apply a primary's change log until\n"
+         << "                                        'promote' is typed (run it in its own directory)\n"
+         << "  Hospital --simulate [--cases N] [--days N] [--ambulances LIST] [--officers LIST]\n"
+         << "                      [--seed N] [--threads N]\n"
+         << "                                        capacity planning: simulate every fleet size /\n"
+         << "                                        officer count pair (LIST: 6,9,12 or 6-12), in parallel\n"
+         << "\nCommands (one per line, results are tab-separated):\n"
+         << "  patient   admit name=.. condition=.. | discharge | view | lanes | undo\n"
+         << "            lanes by condition (PatientLanes.csv), discharged by weighted round robin\n"
+         << "            remove id=..                   (any waiting patient: left early, transferred)\n"
+         << "            triage type=.. priority=1-10   (front of the queue -> emergency)\n"
+         << "  emergency log name=.. type=.. priority=1-10 | process | view | undo\n"
+         << "            return id=..                   (case -> admission queue, old place if triaged)\n"
+         << "  medical   add type=.. quantity=.. batch=.. | use | view | undo   [room=..] (default main)\n"
+         << "            transfer from=.. to=.. [quantity=..]  (top batch, all of it by default)\n"
+         << "            stock [type=..] | rooms        (totals across store rooms)\n"
+         << "  ambulance register plate=.. driver=.. shift=1-3 [id=..] | rotate | view\n"
+         << "            status id=.. state=available|dispatched|returning|off-shift\n"
+         << "            utilization | telemetry     (busy/idle time; time series to " << TELEMETRY_FILE << ")\n"
+         << "  archive   query [module=patient|emergency] [from=..] [to=..] [type=..] [priority=..] [limit=20]\n"
+         << "            discharged patients / processed cases; times are epoch ms or YYYY-MM-DD [HH:MM]\n"
+         << "  backup    start [name=..] | status     (every data set as of one moment, to " << BACKUP_DIR << "/NAME;\n"
+         << "                                        written in the background by a forked process)\n"
+         << "  commit    write modified files now (otherwise once per batch)\n"
+         << "  sync      commit, then wait until every file is on disk\n"
+         << "  stats     operation latency histograms as JSON\n"
+         << "  waits     queue wait percentiles (seconds) per priority and condition\n"
+         << "  memory    live/peak bytes and allocations per module and structure\n"
+         << "  quit      close the connection (server mode)\n"
+         << "\nEnvironment:\n"
+         << "  HOSPITAL_SHM=1          share live data with other module processes (POSIX shared memory)\n"
+         << "  HOSPITAL_TRACE=FILE     write a Chrome trace of every operation to FILE at exit\n"
+         << "  HOSPITAL_RECORD=FILE    record menu input (and the starting data) for --replay\n"
+         << "  HOSPITAL_CHANGELOG=DIR  log every change to DIR/changes.log and DIR/changes.sock for a standby\n";
+}
+
+int main(int argc, char *argv[]) {
+    string scriptFile;
+    string execCommands;
+    string serveAddress;
+    string replayFile;
+    string standbySource;
+    bool originalPacing = false;
+    bool showReplay = false;
+    int batchSize = 1000;
+    int threads = 4;
+    bool scripted = false;
+    bool simulate = false;
+    bool threadsGiven = false;
+    SimulationConfig sim;
+    sim.casesPerDay = 300;
+    sim.days = 30;
+    sim.seed = 1;
+    sim.ambulances = {12, 18, 24, 30};
+    sim.officers = {6, 8, 10};
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--script" && i + 1 < argc) {
+            scriptFile = argv[++i];
+            scripted = true;
+        } else if (arg == "--batch" && i + 1 < argc) {
+            batchSize = atoi(argv[++i]);
+            if (batchSize < 1) batchSize = 1;
+        } else if (arg == "--serve" && i + 1 < argc) {
+            serveAddress = argv[++i];
+        } else if (arg == "--replay" && i + 1 < argc) {
+            replayFile = argv[++i];
+        } else if (arg == "--standby" && i + 1 < argc) {
+            standbySource = argv[++i];
+        } else if (arg == "--pace" && i + 1 < argc) {
+            string pace = argv[++i];
+            if (pace != "fast" && pace != "original") { printUsage(); return 2; }
+            originalPacing = pace == "original";
+        } else if (arg == "--show") {
+            showReplay = true;
+        } else if (arg == "--threads" && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+            if (threads < 1) threads = 1;
+            threadsGiven = true;
+        } else if (arg == "--simulate") {
+            simulate = true;
+        } else if (arg == "--cases" && i + 1 < argc) {
+            sim.casesPerDay = atoi(argv[++i]);
+            if (sim.casesPerDay < 1) { printUsage(); return 2; }
+        } else if (arg == "--days" && i + 1 < argc) {
+            sim.days = atoi(argv[++i]);
+            if (sim.days < 1) { printUsage(); return 2; }
+        } else if (arg == "--seed" && i + 1 < argc) {
+            sim.seed = strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--ambulances" && i + 1 < argc) {
+            if (!parseCountList(argv[++i], 1, MAX_AMBULANCES, sim.ambulances)) { printUsage(); return 2; }
+        } else if (arg == "--officers" && i + 1 < argc) {
+            if (!parseCountList(argv[++i], 1, 1000, sim.officers)) { printUsage(); return 2; }
+        } else if (arg == "--exec") {
+            // Everything after --exec is one command per argument
+            for (i++; i < argc; i++) execCommands += string(argv[i]) + "\n";
+            scripted = true;
+        } else {
+            printUsage();
+            return arg == "--help" ? 0 : 2;
+        }
+    }
+
+    if (simulate) {
+        // Scenarios use no data files: no need to load anything
+        sim.threads = threadsGiven ? threads : max(1, (int)thread::hardware_concurrency());
+        return runSimulation(sim);
+    }
+
+    HospitalSystem hospital;
+
+    bool useShm = getenv("HOSPITAL_SHM") != nullptr;
+    const char *changeLogDir = getenv("HOSPITAL_CHANGELOG");
+    string logDir = changeLogDir != nullptr ? changeLogDir : "";
+
+    if (!replayFile.empty())
+        return runReplay(hospital, replayFile, originalPacing, showReplay);
+
+    if (!standbySource.empty())
+        return runStandby(hospital, standbySource, logDir, serveAddress, threads);
+
+    if (!serveAddress.empty()) {
+        hospital.loadAll();
+        hospital.printLoadReport();
+        if (useShm) hospital.enableSharedMemory();
+        if (!logDir.empty() && !startChangeLog(hospital, logDir)) return 2;
+        return runServer(hospital, serveAddress, threads);
+    }
+
+    if (scripted) {
+        // Keep stdout machine-readable: drop the modules' load messages
+        cout.setstate(ios::badbit);
+        hospital.loadAll();
+        if (useShm) hospital.enableSharedMemory();
+        cout.clear();
+        if (!logDir.empty() && !startChangeLog(hospital, logDir)) return 2;
+
+        int errors;
+        if (!execCommands.empty()) {
+            istringstream in(execCommands);
+            errors = runScript(hospital, in, cout, batchSize);
+        } else if (scriptFile == "-") {
+            errors = runScript(hospital, cin, cout, batchSize);
+        } else {
+            ifstream in(scriptFile);
+            if (!in.is_open()) {
+                cerr << "[ERROR] Cannot open script: " << scriptFile << "\n";
+                return 2;
+            }
+            errors = runScript(hospital, in, cout, batchSize);
+        }
+        return errors == 0 ? 0 : 1;
+    }
+
+    startRecordingFromEnv("hospital");
+    hospital.loadAll();
+    hospital.printLoadReport();
+    if (useShm) hospital.enableSharedMemory();
+    if (!logDir.empty() && !startChangeLog(hospital, logDir)) return 2;
+
+    hospital.run();
+    return 0;
+}
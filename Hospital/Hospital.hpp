@@ -0,0 +1,135 @@
+#ifndef HOSPITAL_HPP
+#define HOSPITAL_HPP
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+
+#include "../Patient/Patient.hpp"
+#include "../Patient/ConcurrentPatientQueue.hpp"
+#include "../Medical/Medical.hpp"
+#include "../Medical/SupplyStore.hpp"
+#include "../Emergency/Emergency.hpp"
+#include "../Emergency/ConcurrentEmergencyQueue.hpp"
+#include "../Ambulance/Ambulance.hpp"
+
+// Result of loading one data set at startup
+struct LoadReport {
+    std::string file;
+    int         rows;
+    double      millis;
+};
+
+enum Dataset { DATA_PATIENT = 0, DATA_MEDICAL, DATA_EMERGENCY, DATA_AMBULANCE };
+const int HOSPITAL_DATASETS = 4;
+
+const std::string STATS_JSON = "stats.json";
+
+// All four modules resident in one process.
+class HospitalSystem {
+private:
+    PatientQueue                          patients;
+    // Medical and Emergency read their CSV in the constructor, so they are
+    // built on a loader thread instead of as plain members.
+    std::unique_ptr<SupplyStore>          medical;   // one stack per store room
+    std::unique_ptr<EmergencyManager>     emergency;
+    AmbulanceManager                      ambulance;
+
+    // Lock-free intake for concurrent admission desks (server mode);
+    // drained into `patients` by whoever holds the patient lock
+    ConcurrentPatientQueue                admissions;
+
+    // Board for concurrent triage officers and intake desks (server
+    // mode). Its logs and takes reach `emergency` through applyDispatch();
+    // after any other change to the list it is refilled from it.
+    ConcurrentEmergencyQueue              dispatch;
+    std::mutex                            dispatchApply;   // one applier at a time
+    std::atomic<bool>                     dispatchReady;   // board matches the list
+    std::atomic<uint64_t>                 dispatchDiverged;   // board changes the list refused
+
+    // Queue entries of triaged patients by case ID, so a return puts
+    // them back in their place (cases triaged by this process only)
+    std::map<std::string, Patient>        triaged;
+
+    LoadReport reports[HOSPITAL_DATASETS];
+    double     totalLoadMillis;
+
+    // One reader/writer lock per module for concurrent (server) access.
+    // Store rooms also have their own locks: room operations take the
+    // medical lock shared, whole-store ones exclusively.
+    std::shared_mutex locks[HOSPITAL_DATASETS];
+
+    bool sharedMemory;
+
+public:
+    HospitalSystem();
+
+    // Parse every data set concurrently and wait for all of them
+    void loadAll(int threads = HOSPITAL_DATASETS);
+    // Empty modules without reading any file (a standby, see Replica.hpp)
+    void startEmpty();
+    void printLoadReport() const;
+
+    // Latency table for every timed operation, the queue wait table and
+    // memory use; latencies optionally saved as JSON
+    void statisticsMenu();
+
+    // Records each module holds now (MemoryModule order), for the
+    // memory report; takes each module's lock shared
+    void memoryRecords(int records[MEM_MODULE_COUNT]);
+
+    // Write one data set back to its file
+    void saveDataset(Dataset which);
+
+    // Share live state with separately launched module processes
+    void enableSharedMemory();
+    bool usesSharedMemory() const { return sharedMemory; }
+
+    void run();
+
+    PatientQueue&         getPatients()  { return patients; }
+    MedicalSupplyManager& getMedical()   { return medical->mainRoom(); }
+    SupplyStore&          getSupplies()  { return *medical; }
+    EmergencyManager&     getEmergency() { return *emergency; }
+    AmbulanceManager&     getAmbulance() { return ambulance; }
+
+    std::shared_mutex&    lockFor(Dataset which) { return locks[which]; }
+
+    // Move a person between the admission queue and the emergency list.
+    // Both modules refer to the same registry record, so only the handle
+    // moves and the patient keeps their ID. Callers hold both module locks
+    // exclusively (patient first). On failure error says why.
+    std::string triageNextPatient(const std::string &type, int priority, std::string &error, bool save = true);
+    int         returnToAdmission(const std::string &caseID, std::string &error, bool save = true);
+    void        triageMenu();
+    void        returnMenu();
+
+    // Filter the archive of discharged patients / processed cases
+    void archiveMenu();
+
+    // Ask which store room the supply menu works on (main when there is
+    // only one)
+    MedicalSupplyManager& chooseStoreRoom();
+
+    ConcurrentPatientQueue& getAdmissions() { return admissions; }
+    // Move queued admissions into the patient queue; caller holds the
+    // patient lock exclusively. Returns how many were moved.
+    int drainAdmissions();
+
+    ConcurrentEmergencyQueue& getDispatch()   { return dispatch; }
+    std::mutex&               dispatchLock()  { return dispatchApply; }
+    bool                      dispatchCurrent() const { return dispatchReady; }
+    // Apply the board's logs and takes to the emergency list and save it.
+    // Caller holds the emergency lock (shared is enough) and dispatchLock().
+    int  applyDispatch();
+    uint64_t dispatchDivergences() const { return dispatchDiverged; }
+    // Caller holds the emergency lock exclusively: refill the board from
+    // the list / apply it and stop using it until the list is done changing
+    void refillDispatch();
+    void releaseDispatch();
+};
+
+#endif // HOSPITAL_HPP
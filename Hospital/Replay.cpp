@@ -0,0 +1,128 @@
+#include "Replay.hpp"
+#include "../Common/Recorder.hpp"
+#include "../Common/Persistence.hpp"
+#include "../Common/Stats.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+using namespace std;
+
+// Swallows menu output during a replay
+class NullBuf : public streambuf {
+protected:
+    int_type overflow(int_type c) override { return traits_type::not_eof(c); }
+    streamsize xsputn(const char*, streamsize n) override { return n; }
+};
+
+struct ReplayRun {
+    string        recording;
+    string        module;
+    bool          paced;
+    size_t        lines;
+    ReplayBuf*    input;
+    streambuf*    savedIn;
+    streambuf*    savedOut;
+    chrono::steady_clock::time_point start;
+    bool          reported;
+};
+
+static double percentile(const vector<double> &sorted, double q) {
+    if (sorted.empty()) return 0;
+    size_t i = (size_t)(q * (double)(sorted.size() - 1));
+    return sorted[i];
+}
+
+// Restore the console and print the report (once)
+static void finishReplay(ReplayRun &run) {
+    if (run.reported) return;
+    run.reported = true;
+
+    run.input->close();
+    PersistenceWriter::instance().barrier();   // saves are part of the work
+    double wallMs = chrono::duration<double, milli>(chrono::steady_clock::now() - run.start).count();
+
+    cin.rdbuf(run.savedIn);
+    cout.rdbuf(run.savedOut);
+
+    vector<double> times = run.input->responseMillis;
+    sort(times.begin(), times.end());
+
+    cout << "\n=================== Replay Report ===================\n";
+    cout << fixed << setprecision(3);
+    cout << "Recording      : " << run.recording << " (module=" << run.module << ")\n";
+    cout << "Pacing         : " << (run.paced ? "original" : "full speed") << "\n";
+    cout << "Input lines    : " << run.input->consumed() << " of " << run.lines << "\n";
+    cout << "Wall time      : " << wallMs << " ms\n";
+    cout << "Throughput     : " << (wallMs > 0 ? run.input->consumed() * 1000.0 / wallMs : 0) << " lines/s\n";
+    cout << "Per line (ms)  : p50 " << percentile(times, 0.50)
+         << "  p99 " << percentile(times, 0.99)
+         << "  max " << (times.empty() ? 0 : times.back()) << "\n";
+    cout << "=====================================================\n";
+    cout.unsetf(ios::floatfield);
+
+    StatsRegistry::instance().printTable(cout);
+}
+
+int runReplay(HospitalSystem &hospital, const string &recording, bool originalPacing, bool showOutput) {
+    namespace fs = std::filesystem;
+
+    string module, error;
+    vector<RecordedLine> lines;
+    if (!loadRecording(recording, module, lines, error)) {
+        cerr << "[ERROR] " << error << "\n";
+        return 2;
+    }
+    if (module != "hospital" && module != "patient" && module != "medical" &&
+        module != "emergency" && module != "ambulance") {
+        cerr << "[ERROR] Unknown module in recording: " << module << "\n";
+        return 2;
+    }
+
+    // Fresh copy of the data as it was when the session started
+    string dataDir = recording + ".data";
+    string scratch = recording + ".replay";
+    error_code ec;
+    if (!fs::is_directory(dataDir, ec)) {
+        cerr << "[ERROR] Recorded data not found: " << dataDir << "\n";
+        return 2;
+    }
+    fs::remove_all(scratch, ec);
+    if (!copyDataFiles(dataDir, scratch)) return 2;
+    fs::current_path(scratch, ec);
+    if (ec) {
+        cerr << "[ERROR] Cannot enter " << scratch << ": " << ec.message() << "\n";
+        return 2;
+    }
+
+    static NullBuf discard;
+    static ReplayRun run;
+    run = ReplayRun{recording, module, originalPacing, lines.size(), nullptr,
+                    cin.rdbuf(), cout.rdbuf(), chrono::steady_clock::now(), false};
+    if (!showOutput) cout.rdbuf(&discard);
+
+    hospital.loadAll();
+
+    // If the recording stops mid-menu, the menus would wait for input forever
+    ReplayBuf input(lines, originalPacing, [] {
+        finishReplay(run);
+        exit(0);
+    });
+    run.input = &input;
+    cin.rdbuf(&input);
+    tableInputRedirected() = true;
+    run.start = chrono::steady_clock::now();
+
+    if (module == "hospital") hospital.run();
+    else if (module == "patient") patientMenu(hospital.getPatients());
+    else if (module == "medical") medicalSupplyMenu(hospital.getMedical());
+    else if (module == "emergency") emergencyMenu(hospital.getEmergency());
+    else ambulanceMenu(hospital.getAmbulance());
+
+    finishReplay(run);
+    return 0;
+}
@@ -0,0 +1,21 @@
+#ifndef REPLAY_HPP
+#define REPLAY_HPP
+
+#include <string>
+
+#include "Hospital.hpp"
+
+// Replay a session recorded with HOSPITAL_RECORD (see Common/Recorder.hpp).
+//
+// The recorded data files (FILE.data/) are copied to a scratch directory
+// FILE.replay/ and the replay runs there, so every replay of a recording
+// starts from the same data and the live files are never touched. The
+// recorded lines are fed to the same menu the session used, either as
+// fast as possible or at the original pacing.
+//
+// Menu output is discarded unless showOutput is set. Afterwards prints
+// throughput, the time taken to handle each input line, and the
+// per-operation latency table. Returns the process exit code.
+int runReplay(HospitalSystem &hospital, const std::string &recording, bool originalPacing, bool showOutput);
+
+#endif // REPLAY_HPP
@@ -0,0 +1,478 @@
+#include "Replica.hpp"
+#include "Server.hpp"
+#include "../Common/ChangeLog.hpp"
+#include "../Common/Persistence.hpp"
+#include "../Common/WaitStats.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <shared_mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <csignal>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+const string CHANGELOG_FILE   = "changes.log";
+const string CHANGELOG_SOCKET = "changes.sock";
+
+// ===============================
+// Primary
+// ===============================
+#ifndef _WIN32
+static bool unixAddress(const string &path, sockaddr_un &addr) {
+    memset(&addr, 0, sizeof(addr));
+    if (path.size() >= sizeof(addr.sun_path)) return false;
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    return true;
+}
+
+// Hands every standby that connects to the change log
+static void serveFollowers(const string &path) {
+    sockaddr_un addr;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || !unixAddress(path, addr)) {
+        cerr << "[WARN] Change log socket path too long; standbys must follow the file.\n";
+        if (fd >= 0) close(fd);
+        return;
+    }
+    unlink(path.c_str());   // stale socket from a previous run
+    if (bind(fd, (sockaddr*)&addr, sizeof(addr)) < 0 || listen(fd, 8) < 0) {
+        cerr << "[WARN] Cannot listen on " << path << ": " << strerror(errno) << "\n";
+        close(fd);
+        return;
+    }
+
+    signal(SIGPIPE, SIG_IGN);   // a standby that goes away must not kill us
+    thread([fd] {
+        while (true) {
+            int client = accept(fd, nullptr, nullptr);
+            if (client >= 0) ChangeLog::instance().follow(client);
+            else if (errno != EINTR) return;
+        }
+    }).detach();
+}
+#endif
+
+bool startChangeLog(HospitalSystem &hospital, const string &dir) {
+    error_code ec;
+    filesystem::create_directories(dir, ec);
+    string path = dir + "/" + CHANGELOG_FILE;
+
+    // A new file rather than a truncated one, so a standby following the
+    // old log sees that it was replaced
+    remove(path.c_str());
+    if (!ChangeLog::instance().open(path)) {
+        cerr << "[ERROR] Cannot create change log " << path << "\n";
+        return false;
+    }
+
+    // The current state, as the lines that would have built it
+    logChange("log", "begin", ChangeFields{{"started", to_string(wallClockMillis())}});
+    PatientQueue &pq = hospital.getPatients();
+    PatientLanes lanes = pq.lanesVersion();
+    for (size_t l = 0; l < lanes.lanes.size(); l++)
+        lanes.lanes[l].forEach([&](size_t, const Patient &p) {
+            ChangeFields fields = changeFields(p);
+            fields.push_back({"lane", pq.laneConfig()[l].name});
+            logChange("patient", "admit", fields);
+            return true;
+        });
+    SupplyStore &store = hospital.getSupplies();
+    for (const string &room : store.roomNames()) {
+        SupplyVersion stack;
+        store.contents(room, stack);
+        stack.forEach([&room](size_t, const Supply &s) {
+            ChangeFields fields = changeFields(s);
+            if (room != MEDICAL_MAIN_ROOM) fields.push_back({"room", room});
+            logChange("medical", "push", fields);
+            return true;
+        });
+    }
+    hospital.getEmergency().version().forEach([](size_t, const Emergency &e) {
+        logChange("emergency", "log", changeFields(e));
+        return true;
+    });
+    const AmbulanceQueue &ambulances = hospital.getAmbulance().getQueue();
+    Ambulance a;
+    for (int i = 0; i < ambulances.size(); i++)
+        if (ambulances.getAt(i, a)) logChange("ambulance", "register", changeFields(a));
+    logChange("log", "ready");
+
+#ifndef _WIN32
+    serveFollowers(dir + "/" + CHANGELOG_SOCKET);
+#endif
+    cerr << "[INFO] Writing change log to " << path << "\n";
+    return true;
+}
+
+// ===============================
+// Standby: applying changes
+// ===============================
+struct StandbyState {
+    atomic<bool>     stop;
+    atomic<bool>     ready;      // base state received
+    atomic<uint64_t> lastSeq;
+    atomic<uint64_t> errors;
+    string           lastError;  // guarded by errorLock
+    mutex            errorLock;
+
+    StandbyState() : stop(false), ready(false), lastSeq(0), errors(0) {}
+};
+
+typedef map<string, string> ChangeArgs;
+
+static string argOf(const ChangeArgs &args, const char *key) {
+    auto it = args.find(key);
+    return it == args.end() ? string() : it->second;
+}
+
+// One log line; false (and error) when it could not be repeated exactly
+static bool applyChange(HospitalSystem &hospital, const string &module, const string &op,
+                        const ChangeArgs &args, string &error) {
+    if (module == "log") {
+        if (op == "begin") {
+            // A new log from the start: the primary may have restarted
+            unique_lock<shared_mutex> p(hospital.lockFor(DATA_PATIENT));
+            unique_lock<shared_mutex> m(hospital.lockFor(DATA_MEDICAL));
+            unique_lock<shared_mutex> e(hospital.lockFor(DATA_EMERGENCY));
+            unique_lock<shared_mutex> a(hospital.lockFor(DATA_AMBULANCE));
+            hospital.startEmpty();
+        }
+        return true;
+    }
+
+    if (module == "patient") {
+        unique_lock<shared_mutex> guard(hospital.lockFor(DATA_PATIENT));
+        PatientQueue &pq = hospital.getPatients();
+        int id = atoi(argOf(args, "id").c_str());
+
+        if (op == "admit") {
+            int admitted = pq.admitPatient(id, argOf(args, "name"), argOf(args, "condition"), false,
+                                           atoll(argOf(args, "enqueued").c_str()), argOf(args, "lane"));
+            if (admitted != id) error = "admitted under another ID";
+        } else if (op == "discharge") {
+            // The lane is named: the standby's round robin need not be
+            // where the primary's was
+            Patient out;
+            string lane = argOf(args, "lane");
+            if ((lane.empty() ? pq.dischargeFront(out, false) : pq.dischargeFromLane(lane, out, false)) < 0)
+                error = "queue empty";
+            else if (out.id != id) error = "discharged " + to_string(out.id) + " instead of " + to_string(id);
+        } else if (op == "triage") {
+            Patient out;
+            if (!pq.takeForTriage(out, false, argOf(args, "lane"))) error = "queue empty";
+            else if (out.id != id) error = "triaged " + to_string(out.id) + " instead of " + to_string(id);
+        } else if (op == "restore") {
+            PatientHandle person = PatientRegistry::instance().adopt(id, argOf(args, "name"),
+                                                                     argOf(args, "condition"));
+            Patient p{id, person, atoll(argOf(args, "enqueued").c_str()), 0};
+            if (PatientRegistry::instance().get(person).id != id) error = "restored under another ID";
+            else if (!pq.restoreTriaged(p, false, argOf(args, "lane")))
+                error = "patient " + to_string(id) + " already waiting";
+        } else if (op == "remove") {
+            Patient out;
+            if (pq.removeByID(id, out, false) < 0) error = "no waiting patient " + to_string(id);
+        } else if (op == "undo") {
+            if (!pq.undoLastChange(false)) error = "nothing to undo";
+        } else {
+            error = "unknown operation";
+        }
+    }
+    else if (module == "medical") {
+        unique_lock<shared_mutex> guard(hospital.lockFor(DATA_MEDICAL));
+        string room = argOf(args, "room");
+        MedicalSupplyManager &ms = hospital.getSupplies().roomManager(room.empty() ? MEDICAL_MAIN_ROOM : room);
+
+        if (op == "push") {
+            Supply s{argOf(args, "type"), atoi(argOf(args, "quantity").c_str()), argOf(args, "batch")};
+            if (!ms.pushSupply(s, false)) error = "stack full";
+        } else if (op == "pop") {
+            Supply out;
+            if (!ms.popSupply(out, false)) error = "stack empty";
+            else if (out.batch != argOf(args, "batch")) error = "used batch " + out.batch;
+        } else if (op == "take") {
+            Supply out;
+            if (!ms.takeFromTop(atoi(argOf(args, "quantity").c_str()), out, false)) error = "stack empty";
+            else if (out.batch != argOf(args, "batch")) error = "took from batch " + out.batch;
+        } else if (op == "undo") {
+            if (!ms.undoLastChange(false)) error = "nothing to undo";
+        } else {
+            error = "unknown operation";
+        }
+    }
+    else if (module == "emergency") {
+        unique_lock<shared_mutex> guard(hospital.lockFor(DATA_EMERGENCY));
+        EmergencyManager &em = hospital.getEmergency();
+        string id = argOf(args, "id");
+        Emergency out;
+
+        if (op == "log") {
+            string type = argOf(args, "type");
+            PatientHandle patient = adoptCasePatient(id, argOf(args, "name"), type);
+            string added = em.addCaseFor(patient, type, atoi(argOf(args, "priority").c_str()), false,
+                                         atoll(argOf(args, "logged").c_str()), id);
+            if (added != id) error = added.empty() ? "list full or case exists" : "logged as " + added;
+        } else if (op == "process") {
+            if (!em.processByID(id, out, false)) error = "no case " + id;
+        } else if (op == "remove") {
+            if (!em.popByID(id, out, false)) error = "no case " + id;
+        } else if (op == "undo") {
+            if (!em.undoLastChange(false)) error = "nothing to undo";
+        } else {
+            error = "unknown operation";
+        }
+    }
+    else if (module == "ambulance") {
+        unique_lock<shared_mutex> guard(hospital.lockFor(DATA_AMBULANCE));
+        AmbulanceManager &am = hospital.getAmbulance();
+
+        if (op == "register") {
+            Ambulance a;
+            memset(&a, 0, sizeof(a));
+            a.id = atoi(argOf(args, "id").c_str());
+            strncpy(a.plate, argOf(args, "plate").c_str(), sizeof(a.plate) - 1);
+            strncpy(a.driverName, argOf(args, "driver").c_str(), sizeof(a.driverName) - 1);
+            a.shift = atoi(argOf(args, "shift").c_str());
+            am.addAmbulance(a, error);
+        } else if (op == "rotate") {
+            if (!am.rotateAll()) error = "no ambulances";
+        } else if (op == "status") {
+            AmbulanceState state;
+            if (!parseAmbulanceState(argOf(args, "state"), state)) error = "bad state";
+            else am.setState(atoi(argOf(args, "id").c_str()), state, error, atoll(argOf(args, "at").c_str()));
+        } else {
+            error = "unknown operation";
+        }
+    }
+    else {
+        error = "unknown module";
+    }
+    return error.empty();
+}
+
+// Parse and apply one line; lines already applied are skipped
+static void applyLine(HospitalSystem &hospital, StandbyState &state, const string &line) {
+    vector<string> parts;
+    stringstream ss(line);
+    string part;
+    while (getline(ss, part, '\t')) parts.push_back(part);
+    if (parts.size() < 3) return;
+
+    uint64_t seq = strtoull(parts[0].c_str(), nullptr, 10);
+    bool begin = parts[1] == "log" && parts[2] == "begin";
+    if (begin) {
+        state.ready = false;
+        state.lastSeq = 0;
+    } else if (seq <= state.lastSeq) {
+        return;
+    }
+
+    ChangeArgs args;
+    for (size_t i = 3; i < parts.size(); i++) {
+        size_t eq = parts[i].find('=');
+        if (eq != string::npos) args[parts[i].substr(0, eq)] = parts[i].substr(eq + 1);
+    }
+
+    string error;
+    if (seq != state.lastSeq + 1)
+        error = "missing changes " + to_string(state.lastSeq + 1) + "-" + to_string(seq - 1);
+    if (!applyChange(hospital, parts[1], parts[2], args, error) || !error.empty()) {
+        state.errors++;
+        lock_guard<mutex> guard(state.errorLock);
+        state.lastError = "#" + parts[0] + " " + parts[1] + " " + parts[2] + ": " + error;
+        cerr << "[WARN] Standby diverged at " << state.lastError << "\n";
+    }
+
+    state.lastSeq = seq;
+    if (parts[1] == "log" && parts[2] == "ready") {
+        state.ready = true;
+        cerr << "[INFO] Standby is warm (" << seq << " changes applied).\n";
+    }
+}
+
+// Apply every complete line in buffer; the partial last line stays
+static void applyBuffer(HospitalSystem &hospital, StandbyState &state, string &buffer) {
+    size_t start = 0, end;
+    while ((end = buffer.find('\n', start)) != string::npos) {
+        applyLine(hospital, state, buffer.substr(start, end - start));
+        start = end + 1;
+    }
+    buffer.erase(0, start);
+}
+
+// ===============================
+// Standby: following the primary
+// ===============================
+static void followFile(HospitalSystem &hospital, StandbyState &state, const string &path) {
+    FILE *f = nullptr;
+    string buffer;
+    char chunk[65536];
+
+    while (!state.stop) {
+        if (f == nullptr) {
+            f = fopen(path.c_str(), "rb");
+            if (f == nullptr) {
+                this_thread::sleep_for(chrono::milliseconds(200));
+                continue;
+            }
+            buffer.clear();
+        }
+
+        size_t n = fread(chunk, 1, sizeof(chunk), f);
+        if (n > 0) {
+            buffer.append(chunk, n);
+            applyBuffer(hospital, state, buffer);
+            continue;
+        }
+
+        // At the end: wait for more, or start over if the primary began
+        // a new log (a new file at the same path)
+        clearerr(f);
+        bool replaced = false;
+#ifndef _WIN32
+        struct stat now, opened;
+        replaced = stat(path.c_str(), &now) != 0 || fstat(fileno(f), &opened) != 0 ||
+                   now.st_ino != opened.st_ino;
+#endif
+        if (replaced) {
+            fclose(f);
+            f = nullptr;
+            continue;
+        }
+        this_thread::sleep_for(chrono::milliseconds(20));
+    }
+    if (f != nullptr) fclose(f);
+}
+
+#ifndef _WIN32
+static void followSocket(HospitalSystem &hospital, StandbyState &state, const string &path) {
+    bool warned = false;
+
+    while (!state.stop) {
+        sockaddr_un addr;
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0 || !unixAddress(path, addr) || connect(fd, (sockaddr*)&addr, sizeof(addr)) < 0) {
+            if (fd >= 0) close(fd);
+            if (!warned) cerr << "[INFO] Waiting for the primary on " << path << "...\n";
+            warned = true;
+            this_thread::sleep_for(chrono::seconds(1));
+            continue;
+        }
+        warned = false;
+        cerr << "[INFO] Connected to the primary.\n";
+
+        // The primary resends its whole log, starting with "log begin"
+        string buffer;
+        char chunk[65536];
+        while (!state.stop) {
+            pollfd p = {fd, POLLIN, 0};
+            if (poll(&p, 1, 200) <= 0) continue;
+            ssize_t n = read(fd, chunk, sizeof(chunk));
+            if (n <= 0) break;
+            buffer.append(chunk, (size_t)n);
+            applyBuffer(hospital, state, buffer);
+        }
+        close(fd);
+        if (!state.stop) cerr << "[WARN] Lost the primary; type 'promote' to take over.\n";
+    }
+}
+#endif
+
+static void printStatus(HospitalSystem &hospital, StandbyState &state) {
+    int counts[HOSPITAL_DATASETS];
+    {
+        shared_lock<shared_mutex> p(hospital.lockFor(DATA_PATIENT));
+        shared_lock<shared_mutex> m(hospital.lockFor(DATA_MEDICAL));
+        shared_lock<shared_mutex> e(hospital.lockFor(DATA_EMERGENCY));
+        shared_lock<shared_mutex> a(hospital.lockFor(DATA_AMBULANCE));
+        counts[DATA_PATIENT] = hospital.getPatients().count();
+        counts[DATA_MEDICAL] = hospital.getSupplies().count();
+        counts[DATA_EMERGENCY] = hospital.getEmergency().count();
+        counts[DATA_AMBULANCE] = hospital.getAmbulance().getQueue().size();
+    }
+
+    cout << (state.ready ? "warm" : "catching up") << ": change " << state.lastSeq
+         << ", patients=" << counts[DATA_PATIENT] << " supplies=" << counts[DATA_MEDICAL]
+         << " cases=" << counts[DATA_EMERGENCY] << " ambulances=" << counts[DATA_AMBULANCE]
+         << ", errors=" << state.errors << "\n";
+    if (state.errors > 0) {
+        lock_guard<mutex> guard(state.errorLock);
+        cout << "last error: " << state.lastError << "\n";
+    }
+}
+
+int runStandby(HospitalSystem &hospital, const string &source, const string &logDir,
+               const string &serveAddress, int threads) {
+    hospital.startEmpty();
+    departuresRecorded() = false;   // until promoted
+    StandbyState state;
+
+    thread follower;
+    if (source.compare(0, 5, "unix:") == 0) {
+#ifndef _WIN32
+        follower = thread(followSocket, ref(hospital), ref(state), source.substr(5));
+#else
+        cerr << "[ERROR] Unix sockets are only available on POSIX systems.\n";
+        return 2;
+#endif
+    } else {
+        follower = thread(followFile, ref(hospital), ref(state), source + "/" + CHANGELOG_FILE);
+    }
+
+    cout << "[INFO] Standby following " << source << ". Commands: status, promote\n";
+    string line;
+    bool promote = false;
+    while (!promote && getline(cin, line)) {
+        if (line == "status") printStatus(hospital, state);
+        else if (line == "promote") promote = true;
+        else if (!line.empty()) cout << "Commands: status, promote\n";
+    }
+
+    if (!promote) {
+        follower.join();   // no console: follow until killed
+        return 0;
+    }
+
+    state.stop = true;
+    follower.join();
+    departuresRecorded() = true;
+    if (!state.ready)
+        cerr << "[WARN] Promoting before the primary's full state arrived.\n";
+    printStatus(hospital, state);
+
+    // Take over: write every module's files here, then serve
+    error_code ec;
+    filesystem::create_directories("Medical", ec);
+    filesystem::create_directories("Emergency", ec);
+    filesystem::create_directories("Ambulance", ec);
+    for (int i = 0; i < HOSPITAL_DATASETS; i++)
+        hospital.saveDataset((Dataset)i);
+    if (PersistenceWriter::instance().barrier() > 0)
+        cerr << "[ERROR] Promoted, but not every data file could be written.\n";
+    else
+        cout << "[INFO] Promoted; data files written.\n";
+
+    if (!logDir.empty()) startChangeLog(hospital, logDir);
+    if (!serveAddress.empty())
+        return runServer(hospital, serveAddress, threads);
+    hospital.run();
+    return 0;
+}
@@ -0,0 +1,32 @@
+#ifndef REPLICA_HPP
+#define REPLICA_HPP
+
+#include <string>
+
+#include "Hospital.hpp"
+
+// Hot standby fed by the change log (see Common/ChangeLog.hpp).
+//
+// Primary: startChangeLog() writes DIR/changes.log, beginning with the
+// current state of every module, and streams the same lines to standbys
+// connected to the Unix socket DIR/changes.sock. Call it after loading
+// and before anything else can change the data. False if the log file
+// cannot be created.
+bool startChangeLog(HospitalSystem &hospital, const std::string &dir);
+
+// Standby: start with empty modules and apply every change from source,
+// which is the primary's DIR (follow DIR/changes.log) or unix:PATH. A
+// primary that restarts begins a new log, and the standby starts over
+// from it. Nothing is written while following, not even archive rows or
+// wait samples (the primary records those), so it may share the
+// primary's directory.
+//
+// Reads commands from standard input: "status" prints how far it is,
+// "promote" stops following, writes every module's files and then runs
+// the server on serveAddress (if given) or the menu. If logDir is not
+// empty the promoted process starts its own change log there.
+// Returns the process exit code.
+int runStandby(HospitalSystem &hospital, const std::string &source, const std::string &logDir,
+               const std::string &serveAddress, int threads);
+
+#endif // REPLICA_HPP
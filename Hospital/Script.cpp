@@ -0,0 +1,598 @@
+#include "Script.hpp"
+#include "Backup.hpp"
+#include "../Common/Persistence.hpp"
+#include "../Common/WaitStats.hpp"
+#include "../Common/Archive.hpp"
+
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+#include <cctype>
+
+using namespace std;
+
+// ===============================
+// Parsing
+// ===============================
+static bool isNumber(const string &s) {
+    if (s.empty()) return false;
+    for (char c : s)
+        if (!isdigit((unsigned char)c)) return false;
+    return true;
+}
+
+bool parseCommand(const string &line, Command &out, string &error) {
+    out = Command();
+
+    stringstream ss(line);
+    string token;
+    vector<string> tokens;
+    while (ss >> token) tokens.push_back(token);
+
+    if (tokens.empty()) { error = "empty command"; return false; }
+
+    out.module = tokens[0];
+    if (tokens.size() > 1) out.op = tokens[1];
+
+    string key;
+    for (size_t i = 2; i < tokens.size(); i++) {
+        size_t eq = tokens[i].find('=');
+        if (eq != string::npos && eq > 0) {
+            key = tokens[i].substr(0, eq);
+            out.args[key] = tokens[i].substr(eq + 1);
+        } else if (!key.empty()) {
+            out.args[key] += " " + tokens[i];   // value with spaces
+        } else {
+            error = "expected key=value, got '" + tokens[i] + "'";
+            return false;
+        }
+    }
+
+    // Values end up in CSV files, so commas would corrupt the row
+    for (const auto &kv : out.args) {
+        if (kv.second.find(',') != string::npos) {
+            error = kv.first + " must not contain ','";
+            return false;
+        }
+    }
+    return true;
+}
+
+bool datasetFor(const string &module, Dataset &out) {
+    if (module == "patient") out = DATA_PATIENT;
+    else if (module == "medical") out = DATA_MEDICAL;
+    else if (module == "emergency") out = DATA_EMERGENCY;
+    else if (module == "ambulance") out = DATA_AMBULANCE;
+    else return false;
+    return true;
+}
+
+void writeWaitRows(ostream &out) {
+    vector<WaitSummary> rows = WaitStatsRegistry::instance().summary();
+    ostringstream t;
+    t << fixed << setprecision(3);
+    for (const WaitSummary &r : rows)
+        t << "row\twait\tqueue=" << r.queue << "\tgroup=" << r.key << "\tcount=" << r.count
+          << "\tp50_s=" << r.p50Seconds << "\tp90_s=" << r.p90Seconds
+          << "\tp99_s=" << r.p99Seconds << "\tmax_s=" << r.maxSeconds << "\n";
+    t << "ok\twaits\trows=" << rows.size() << "\n";
+    out << t.str();
+}
+
+void writeMemoryRows(HospitalSystem &hospital, ostream &out) {
+    int records[MEM_MODULE_COUNT];
+    hospital.memoryRecords(records);
+    MemoryRegistry &memory = MemoryRegistry::instance();
+    vector<MemoryRow> rows = memory.rows();
+
+    ostringstream t;
+    t << fixed << setprecision(1);
+    for (const MemoryRow &r : rows)
+        t << "row\tmemory\tmodule=" << r.module << "\tstructure=" << r.structure
+          << "\tlive_bytes=" << r.liveBytes << "\tpeak_bytes=" << r.peakBytes
+          << "\tallocs=" << r.allocations << "\tlive_allocs=" << r.liveAllocations << "\n";
+    for (int m = 0; m < MEM_MODULE_COUNT; m++) {
+        int64_t bytes = memory.moduleBytes(m);
+        t << "row\tmemory\tmodule=" << memoryModuleName(m) << "\tstructure=total\trecords=" << records[m]
+          << "\tlive_bytes=" << bytes << "\tbytes_per_record=" << (records[m] > 0 ? (double)bytes / records[m] : 0.0)
+          << "\n";
+    }
+    t << "ok\tmemory\trows=" << rows.size() + MEM_MODULE_COUNT << "\n";
+    out << t.str();
+}
+
+// ===============================
+// Runner
+// ===============================
+CommandRunner::CommandRunner(HospitalSystem &h)
+    : hospital(h), pending(0), failuresSeen(PersistenceWriter::instance().failures()) {
+    for (int i = 0; i < HOSPITAL_DATASETS; i++) dirty[i] = false;
+}
+
+static bool requireArgs(const Command &cmd, const char *const names[], int n, string &missing) {
+    for (int i = 0; i < n; i++) {
+        auto it = cmd.args.find(names[i]);
+        if (it == cmd.args.end() || it->second.empty()) {
+            missing = names[i];
+            return false;
+        }
+    }
+    return true;
+}
+
+bool CommandRunner::execute(const Command &cmd, ostream &out) {
+    const string name = cmd.module + "." + cmd.op;
+    string missing;
+
+    auto fail = [&](const string &msg) {
+        out << "err\t" << name << "\tmessage=" << msg << "\n";
+        return false;
+    };
+    auto changed = [&](Dataset d) {
+        dirty[d] = true;
+        pending++;
+    };
+
+    // ---------- Patient ----------
+    if (cmd.module == "patient") {
+        PatientQueue &pq = hospital.getPatients();
+
+        if (cmd.op == "admit") {
+            static const char *const need[] = {"name", "condition"};
+            if (!requireArgs(cmd, need, 2, missing)) return fail("missing " + missing);
+
+            int id = pq.admitNext(cmd.args.at("name"), cmd.args.at("condition"), false);
+            if (id < 0) return fail("patient queue full");
+            changed(DATA_PATIENT);
+            out << "ok\t" << name << "\tid=" << id << "\n";
+        } else if (cmd.op == "discharge") {
+            Patient p;
+            int lane = pq.dischargeFront(p, false);
+            if (lane < 0) return fail("queue empty");
+            changed(DATA_PATIENT);
+            out << "ok\t" << name << "\tid=" << p.id << "\tname=" << p.name() << "\tcondition=" << p.condition()
+                << "\tlane=" << pq.laneConfig()[lane].name << "\n";
+        } else if (cmd.op == "remove") {
+            auto idIt = cmd.args.find("id");
+            if (idIt == cmd.args.end()) return fail("missing id");
+            if (!isNumber(idIt->second) || idIt->second.size() > 9) return fail("id must be a number");
+
+            // Saved as one journal line right away, so the dataset is not
+            // marked for a full rewrite
+            Patient p;
+            int lane = pq.removeByID(stoi(idIt->second), p, true);
+            if (lane < 0) return fail("no waiting patient " + idIt->second);
+            out << "ok\t" << name << "\tid=" << p.id << "\tname=" << p.name() << "\tcondition=" << p.condition()
+                << "\tlane=" << pq.laneConfig()[lane].name << "\n";
+        } else if (cmd.op == "triage") {
+            static const char *const need[] = {"type", "priority"};
+            if (!requireArgs(cmd, need, 2, missing)) return fail("missing " + missing);
+
+            const string &pri = cmd.args.at("priority");
+            int priority = isNumber(pri) && pri.size() <= 2 ? stoi(pri) : -1;
+            if (priority < 1 || priority > 10) return fail("priority must be 1-10");
+
+            string error;
+            string id = hospital.triageNextPatient(cmd.args.at("type"), priority, error, false);
+            if (id.empty()) return fail(error);
+            changed(DATA_PATIENT);
+            changed(DATA_EMERGENCY);
+            out << "ok\t" << name << "\tid=" << id << "\n";
+        } else if (cmd.op == "view") {
+            PatientLanes lanes = pq.lanesVersion();
+            for (size_t l = 0; l < lanes.lanes.size(); l++)
+                lanes.lanes[l].forEach([&](size_t, const Patient &p) {
+                    out << "row\tpatient\tlane=" << pq.laneConfig()[l].name << "\tid=" << p.id << "\tname=" << p.name()
+                        << "\tcondition=" << p.condition() << "\n";
+                    return true;
+                });
+            out << "ok\t" << name << "\trows=" << lanes.size() << "\n";
+        } else if (cmd.op == "lanes") {
+            PatientLanes lanes = pq.lanesVersion();
+            const vector<PatientLane> &config = pq.laneConfig();
+            for (size_t l = 0; l < config.size(); l++)
+                out << "row\tpatient\tlane=" << config[l].name << "\tweight=" << config[l].weight
+                    << "\tdepth=" << lanes.lanes[l].size() << "\tserved=" << pq.servedFrom(l) << "\n";
+            out << "ok\t" << name << "\trows=" << config.size() << "\n";
+        } else if (cmd.op == "undo") {
+            string what = pq.lastChange();
+            if (!pq.undoLastChange(false)) return fail("nothing to undo");
+            changed(DATA_PATIENT);
+            out << "ok\t" << name << "\tundone=" << what << "\n";
+        } else {
+            return fail("unknown operation");
+        }
+    }
+    // ---------- Emergency ----------
+    else if (cmd.module == "emergency") {
+        EmergencyManager &em = hospital.getEmergency();
+
+        if (cmd.op == "log") {
+            static const char *const need[] = {"name", "type", "priority"};
+            if (!requireArgs(cmd, need, 3, missing)) return fail("missing " + missing);
+
+            const string &pri = cmd.args.at("priority");
+            int priority = isNumber(pri) && pri.size() <= 2 ? stoi(pri) : -1;
+            if (priority < 1 || priority > 10) return fail("priority must be 1-10");
+
+            string id = em.addCase(cmd.args.at("name"), cmd.args.at("type"), priority, false);
+            if (id.empty()) return fail("emergency list full");
+            changed(DATA_EMERGENCY);
+            out << "ok\t" << name << "\tid=" << id << "\n";
+        } else if (cmd.op == "process") {
+            Emergency e;
+            if (!em.popCritical(e, false)) return fail("no cases");
+            changed(DATA_EMERGENCY);
+            out << "ok\t" << name << "\tid=" << e.id << "\tname=" << e.name()
+                << "\ttype=" << e.type << "\tpriority=" << e.priority << "\n";
+        } else if (cmd.op == "return") {
+            static const char *const need[] = {"id"};
+            if (!requireArgs(cmd, need, 1, missing)) return fail("missing " + missing);
+
+            string error;
+            int id = hospital.returnToAdmission(cmd.args.at("id"), error, false);
+            if (id < 0) return fail(error);
+            changed(DATA_PATIENT);
+            changed(DATA_EMERGENCY);
+            out << "ok\t" << name << "\tpatient=" << id << "\n";
+        } else if (cmd.op == "view") {
+            EmergencyVersion cases = em.version();
+            cases.forEach([&](size_t, const Emergency &e) {
+                out << "row\temergency\tid=" << e.id << "\tname=" << e.name()
+                    << "\ttype=" << e.type << "\tpriority=" << e.priority << "\n";
+                return true;
+            });
+            out << "ok\t" << name << "\trows=" << cases.size() << "\n";
+        } else if (cmd.op == "undo") {
+            string what = em.lastChange();
+            if (!em.undoLastChange(false)) return fail("nothing to undo");
+            changed(DATA_EMERGENCY);
+            out << "ok\t" << name << "\tundone=" << what << "\n";
+        } else {
+            return fail("unknown operation");
+        }
+    }
+    // ---------- Medical ----------
+    // Store room operations lock only their room(s); see SupplyStore.hpp
+    else if (cmd.module == "medical") {
+        SupplyStore &store = hospital.getSupplies();
+
+        auto it = cmd.args.find("room");
+        string room = it == cmd.args.end() || it->second.empty() ? MEDICAL_MAIN_ROOM : it->second;
+        if (!validRoomName(room)) return fail("room must be letters, digits, '-' or '_'");
+
+        if (cmd.op == "add") {
+            static const char *const need[] = {"type", "quantity", "batch"};
+            if (!requireArgs(cmd, need, 3, missing)) return fail("missing " + missing);
+
+            const string &qty = cmd.args.at("quantity");
+            if (!isNumber(qty) || qty.size() > 9 || stoi(qty) <= 0) return fail("quantity must be a positive number");
+
+            Supply s;
+            s.type = cmd.args.at("type");
+            s.quantity = stoi(qty);
+            s.batch = cmd.args.at("batch");
+            if (!store.push(room, s, false)) return fail("supply stack full");
+            changed(DATA_MEDICAL);
+            SupplyVersion stack;
+            store.contents(room, stack);
+            out << "ok\t" << name << "\troom=" << room << "\tcount=" << stack.size() << "\n";
+        } else if (cmd.op == "use") {
+            Supply s;
+            if (!store.pop(room, s, false)) return fail("no supplies");
+            changed(DATA_MEDICAL);
+            out << "ok\t" << name << "\troom=" << room << "\ttype=" << s.type << "\tquantity=" << s.quantity
+                << "\tbatch=" << s.batch << "\n";
+        } else if (cmd.op == "view") {
+            SupplyVersion stack;
+            if (!store.contents(room, stack)) return fail("no room " + room);
+            for (size_t i = stack.size(); i-- > 0;) {   // top first
+                const Supply &s = stack.at(i);
+                out << "row\tmedical\ttype=" << s.type << "\tquantity=" << s.quantity << "\tbatch=" << s.batch << "\n";
+            }
+            out << "ok\t" << name << "\troom=" << room << "\trows=" << stack.size() << "\n";
+        } else if (cmd.op == "undo") {
+            string what;
+            if (!store.undo(room, what, false)) return fail("nothing to undo");
+            changed(DATA_MEDICAL);
+            out << "ok\t" << name << "\troom=" << room << "\tundone=" << what << "\n";
+        } else if (cmd.op == "transfer") {
+            static const char *const need[] = {"from", "to"};
+            if (!requireArgs(cmd, need, 2, missing)) return fail("missing " + missing);
+            const string &from = cmd.args.at("from"), &to = cmd.args.at("to");
+            if (!validRoomName(from) || !validRoomName(to)) return fail("room must be letters, digits, '-' or '_'");
+
+            int quantity = 0;
+            auto q = cmd.args.find("quantity");
+            if (q != cmd.args.end()) {
+                if (!isNumber(q->second) || q->second.size() > 9 || stoi(q->second) <= 0)
+                    return fail("quantity must be a positive number");
+                quantity = stoi(q->second);
+            }
+
+            Supply moved;
+            string error;
+            if (!store.transfer(from, to, quantity, moved, error, false)) return fail(error);
+            changed(DATA_MEDICAL);
+            out << "ok\t" << name << "\tfrom=" << from << "\tto=" << to << "\ttype=" << moved.type
+                << "\tquantity=" << moved.quantity << "\tbatch=" << moved.batch << "\n";
+        } else if (cmd.op == "stock") {
+            auto t = cmd.args.find("type");
+            vector<SupplyTotal> totals = store.totals(t == cmd.args.end() ? "" : t->second);
+            ostringstream rows;
+            for (const SupplyTotal &total : totals) {
+                rows << "row\tmedical\ttype=" << total.type << "\tquantity=" << total.quantity
+                     << "\tbatches=" << total.batches;
+                for (const auto &r : total.byRoom) rows << "\t" << r.first << "=" << r.second;
+                rows << "\n";
+            }
+            out << rows.str() << "ok\t" << name << "\trows=" << totals.size() << "\n";
+        } else if (cmd.op == "rooms") {
+            vector<string> rooms = store.roomNames();
+            for (const string &r : rooms) {
+                SupplyVersion stack;
+                store.contents(r, stack);
+                out << "row\tmedical\troom=" << r << "\tsupplies=" << stack.size() << "\n";
+            }
+            out << "ok\t" << name << "\trows=" << rooms.size() << "\n";
+        } else {
+            return fail("unknown operation");
+        }
+    }
+    // ---------- Ambulance ----------
+    else if (cmd.module == "ambulance") {
+        AmbulanceManager &am = hospital.getAmbulance();
+
+        if (cmd.op == "register") {
+            static const char *const need[] = {"plate", "driver", "shift"};
+            if (!requireArgs(cmd, need, 3, missing)) return fail("missing " + missing);
+
+            const string &shift = cmd.args.at("shift");
+            if (shift != "1" && shift != "2" && shift != "3") return fail("shift must be 1-3");
+
+            Ambulance a;
+            memset(&a, 0, sizeof(a));
+            auto idIt = cmd.args.find("id");
+            if (idIt != cmd.args.end()) {
+                if (!isNumber(idIt->second) || idIt->second.size() > 9) return fail("id must be a number");
+                a.id = stoi(idIt->second);
+            }
+            strncpy(a.plate, cmd.args.at("plate").c_str(), sizeof(a.plate) - 1);
+            strncpy(a.driverName, cmd.args.at("driver").c_str(), sizeof(a.driverName) - 1);
+            a.shift = shift[0] - '1';
+
+            string error;
+            if (!am.addAmbulance(a, error)) return fail(error);
+            changed(DATA_AMBULANCE);
+            out << "ok\t" << name << "\tid=" << a.id << "\n";
+        } else if (cmd.op == "rotate") {
+            if (!am.rotateAll()) return fail("no ambulances");
+            changed(DATA_AMBULANCE);
+            out << "ok\t" << name << "\tcount=" << am.getQueue().size() << "\n";
+        } else if (cmd.op == "view") {
+            Ambulance a;
+            const AmbulanceQueue &q = am.getQueue();
+            for (int i = 0; i < q.size(); i++)
+                if (q.getAt(i, a))
+                    out << "row\tambulance\tid=" << a.id << "\tplate=" << a.plate
+                        << "\tdriver=" << a.driverName << "\tshift=" << a.shift + 1 << "\n";
+            out << "ok\t" << name << "\trows=" << q.size() << "\n";
+        } else if (cmd.op == "status") {
+            static const char *const need[] = {"id", "state"};
+            if (!requireArgs(cmd, need, 2, missing)) return fail("missing " + missing);
+            const string &id = cmd.args.at("id");
+            if (!isNumber(id) || id.size() > 9) return fail("id must be a number");
+
+            AmbulanceState state;
+            if (!parseAmbulanceState(cmd.args.at("state"), state))
+                return fail("state must be available, dispatched, returning or off-shift");
+            string error;
+            if (!am.setState(stoi(id), state, error)) return fail(error);
+            out << "ok\t" << name << "\tid=" << id << "\tstate=" << ambulanceStateName(state) << "\n";
+        } else if (cmd.op == "utilization") {
+            // Times in ms up to now; utilization = busy / (busy + idle)
+            FleetTelemetry &fleet = am.getTelemetry();
+            int64_t now = wallClockMillis();
+            fleet.catchUp(now);
+
+            auto times = [&](const StateTimes &t) {
+                out << "\tbusy_ms=" << t.busy() << "\tidle_ms=" << t.idle() << "\toff_ms=" << t.ms[AMB_OFF_SHIFT]
+                    << "\tutilization=" << fixed << setprecision(3) << t.utilization() << defaultfloat;
+            };
+            Ambulance a;
+            const AmbulanceQueue &q = am.getQueue();
+            int rows = 0;
+            for (int i = 0; i < q.size(); i++) {
+                StateTimes t;
+                uint32_t moves = 0;
+                AmbulanceState state;
+                if (!q.getAt(i, a) || !fleet.ambulanceTimes(a.id, now, t, &moves) || !fleet.stateOf(a.id, state))
+                    continue;
+                out << "row\tambulance\tid=" << a.id << "\tshift=" << a.shift + 1
+                    << "\tstate=" << ambulanceStateName(state);
+                times(t);
+                out << "\ttransitions=" << moves << "\n";
+                rows++;
+            }
+            for (int sh = 0; sh < AMBULANCE_SHIFTS; sh++) {
+                out << "row\tambulance\tshift=" << sh + 1;
+                times(fleet.shiftTimes(sh, now));
+                out << "\n";
+            }
+            out << "row\tambulance\tfleet=all";
+            for (int s = 0; s < AMB_STATE_COUNT; s++) out << "\t" << ambulanceStateName(s) << "=" << fleet.inState((AmbulanceState)s);
+            times(fleet.fleetTimes(now));
+            out << "\n";
+            out << "ok\t" << name << "\trows=" << rows + AMBULANCE_SHIFTS + 1 << "\n";
+        } else if (cmd.op == "telemetry") {
+            am.exportTelemetry();
+            out << "ok\t" << name << "\tfile=" << TELEMETRY_FILE << "\tevents=" << am.getTelemetry().eventCount() << "\n";
+        } else {
+            return fail("unknown operation");
+        }
+    }
+    // ---------- Archive of departed records ----------
+    else if (cmd.module == "archive") {
+        if (cmd.op != "query") return fail("unknown operation");
+
+        auto arg = [&](const char *key) {
+            auto it = cmd.args.find(key);
+            return it == cmd.args.end() ? string() : it->second;
+        };
+
+        string module = arg("module");
+        if (module.empty()) module = "patient";
+        string path;
+        if (module == "patient") path = PATIENT_ARCHIVE;
+        else if (module == "emergency") path = EMERGENCY_ARCHIVE;
+        else return fail("module must be patient or emergency");
+
+        ArchiveQuery q;
+        q.type = arg("type");
+        q.limit = 20;
+        if (!arg("from").empty() && !parseTimeArg(arg("from"), false, q.from))
+            return fail("from must be epoch ms or YYYY-MM-DD [HH:MM[:SS]]");
+        if (!arg("to").empty() && !parseTimeArg(arg("to"), true, q.to))
+            return fail("to must be epoch ms or YYYY-MM-DD [HH:MM[:SS]]");
+        if (!arg("priority").empty()) {
+            if (!isNumber(arg("priority")) || arg("priority").size() > 2) return fail("priority must be a number");
+            q.priority = stoi(arg("priority"));
+        }
+        if (!arg("limit").empty()) {
+            if (!isNumber(arg("limit")) || arg("limit").size() > 9) return fail("limit must be a number");
+            q.limit = (size_t)stoul(arg("limit"));
+        }
+
+        ArchiveResult r = RecordArchive(path).query(q);
+        ostringstream t;
+        t << fixed << setprecision(3);
+        for (const ArchivedRecord &a : r.rows)
+            t << "row\tarchive\tid=" << a.id << "\tname=" << a.name << "\ttype=" << a.type
+              << "\tpriority=" << a.priority << "\tremoved=" << formatMillis(a.removedAt)
+              << "\twait_s=" << (a.removedAt - a.enqueuedAt) / 1000.0 << "\n";
+        t << "ok\t" << name << "\tmatched=" << r.matched << "\tscanned=" << r.rowsScanned
+          << "\tblocks=" << r.blocks << "\tskipped=" << r.blocksSkipped
+          << "\tmean_wait_s=" << (r.matched ? r.totalWaitSeconds / r.matched : 0.0)
+          << "\tmax_wait_s=" << r.maxWaitSeconds << "\tms=" << r.millis << "\n";
+        out << t.str();
+    }
+    // ---------- Online backup ----------
+    else if (cmd.module == "backup") {
+        if (cmd.op == "start") {
+            auto it = cmd.args.find("name");
+            BackupStart started;
+            string error;
+            if (!startBackup(hospital, it == cmd.args.end() ? string() : it->second, started, error))
+                return fail(error);
+            out << "ok\t" << name << "\tdir=" << started.dir << "\tpid=" << started.pid << fixed
+                << setprecision(3) << "\tpause_ms=" << started.pauseMillis << "\n";
+            out.unsetf(ios::floatfield);
+        } else if (cmd.op == "status") {
+            string dir;
+            string status = lastBackupStatus(dir);
+            out << "ok\t" << name << "\tstatus=" << status;
+            if (!dir.empty()) out << "\tdir=" << dir;
+            out << "\n";
+        } else {
+            return fail("unknown operation");
+        }
+    }
+    else {
+        return fail("unknown module");
+    }
+    return true;
+}
+
+int CommandRunner::flush(ostream *out) {
+    int files = 0;
+    for (int i = 0; i < HOSPITAL_DATASETS; i++) {
+        if (!dirty[i]) continue;
+        hospital.saveDataset((Dataset)i);
+        dirty[i] = false;
+        files++;
+    }
+
+    if (out != nullptr) {
+        *out << "flush\tops=" << pending << "\tfiles=" << files << "\n";
+        reportWriteFailures(*out, "flush", false);   // earlier flushes; this one is still queued
+    }
+    pending = 0;
+    return files;
+}
+
+int CommandRunner::reportWriteFailures(ostream &out, const char *what, bool wait) {
+    PersistenceWriter &writer = PersistenceWriter::instance();
+    string lastPath;
+    uint64_t total = wait ? writer.barrier(&lastPath) : writer.failures(&lastPath);
+    if (total <= failuresSeen) return 0;
+
+    int failed = (int)(total - failuresSeen);
+    failuresSeen = total;
+    out << "err\t" << what << "\tmessage=" << failed << " file write(s) failed, last " << lastPath << "\n";
+    return failed;
+}
+
+// ===============================
+// Script driver
+// ===============================
+int runScript(HospitalSystem &hospital, istream &in, ostream &out, int batchSize) {
+    CommandRunner runner(hospital);
+    string line;
+    int inBatch = 0;
+    int errors = 0;
+
+    while (getline(in, line)) {
+        size_t a = line.find_first_not_of(" \t\r");
+        if (a == string::npos || line[a] == '#') continue;
+        line = line.substr(a);
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+
+        if (line == "commit") {
+            runner.flush(&out);
+            inBatch = 0;
+            continue;
+        }
+
+        if (line == "sync") {
+            runner.flush(&out);
+            inBatch = 0;
+            if (runner.reportWriteFailures(out, "sync", true) > 0) errors++;
+            else out << "ok\tsync\n";
+            continue;
+        }
+
+        if (line == "stats") {
+            out << "ok\tstats\tjson=" << StatsRegistry::instance().json() << "\n";
+            continue;
+        }
+        if (line == "waits") {
+            writeWaitRows(out);
+            continue;
+        }
+        if (line == "memory") {
+            writeMemoryRows(hospital, out);
+            continue;
+        }
+
+        Command cmd;
+        string error;
+        if (!parseCommand(line, cmd, error)) {
+            out << "err\tparse\tmessage=" << error << "\n";
+            errors++;
+            continue;
+        }
+
+        if (!runner.execute(cmd, out)) errors++;
+
+        if (++inBatch >= batchSize) {
+            runner.flush(&out);
+            inBatch = 0;
+        }
+    }
+
+    runner.flush(&out);
+    if (runner.reportWriteFailures(out, "flush", true) > 0) errors++;
+    out.flush();
+    return errors;
+}
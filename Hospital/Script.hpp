@@ -0,0 +1,62 @@
+#ifndef SCRIPT_HPP
+#define SCRIPT_HPP
+
+#include <iostream>
+#include <map>
+#include <string>
+
+#include "Hospital.hpp"
+
+// One parsed command line, e.g.
+//   emergency log name=Hui Nan type=Heart Attack priority=1
+// Values run until the next "key=" token, so they may contain spaces.
+struct Command {
+    std::string module;
+    std::string op;
+    std::map<std::string, std::string> args;
+};
+
+bool parseCommand(const std::string &line, Command &out, std::string &error);
+bool datasetFor(const std::string &module, Dataset &out);
+
+// Executes commands against resident managers without prompting and
+// without saving; modified modules are written once per flush().
+//
+// Output is one tab-separated line per result:
+//   ok   <module>.<op>  key=value ...
+//   err  <module>.<op>  message=...
+//   row  <module>       key=value ...      (listings)
+class CommandRunner {
+private:
+    HospitalSystem &hospital;
+    bool dirty[HOSPITAL_DATASETS];
+    int  pending;          // mutating commands since last flush
+    uint64_t failuresSeen; // PersistenceWriter failures already reported
+
+public:
+    explicit CommandRunner(HospitalSystem &h);
+
+    bool execute(const Command &cmd, std::ostream &out);   // false on err
+    int  flush(std::ostream *out = nullptr);   // returns number of files written
+
+    // File writes that failed since the last report: one "err <what>" line
+    // if there were any. With wait, first waits until everything queued is
+    // on disk. Returns how many failed.
+    int  reportWriteFailures(std::ostream &out, const char *what, bool wait);
+};
+
+// "waits": one row per queue/group with wait percentiles in seconds
+void writeWaitRows(std::ostream &out);
+
+// "memory": one row per module/structure, then a total per module with
+// bytes per record
+void writeMemoryRows(HospitalSystem &hospital, std::ostream &out);
+
+// Run every command from a stream, flushing every batchSize commands,
+// on a "commit" line, and at end of input. Flushed files are queued on the
+// background writer; a "sync" line, and the end of input, also wait until
+// they are on disk. Failed writes are reported as errors. Returns the
+// error count.
+int runScript(HospitalSystem &hospital, std::istream &in, std::ostream &out, int batchSize);
+
+#endif // SCRIPT_HPP
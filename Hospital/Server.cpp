@@ -0,0 +1,446 @@
+#include "Server.hpp"
+#include "Script.hpp"
+#include "ThreadPool.hpp"
+#include "../Common/Persistence.hpp"
+
+#include <iostream>
+
+using namespace std;
+
+#ifdef _WIN32
+
+int runServer(HospitalSystem &, const string &, int) {
+    cerr << "[ERROR] Server mode is only available on POSIX systems.\n";
+    return 2;
+}
+
+#else
+
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <sstream>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// ===============================
+// Connection state
+// ===============================
+// While `busy` is set a worker owns the socket for writing and the poll
+// loop neither reads from nor closes it.
+struct Connection {
+    int               fd;
+    string            input;    // bytes received, not yet a full line
+    atomic<bool>      busy;
+    atomic<bool>      closing;
+    CommandRunner     runner;
+
+    Connection(int f, HospitalSystem &h) : fd(f), busy(false), closing(false), runner(h) {}
+};
+
+static volatile sig_atomic_t stopRequested = 0;
+
+static void onStopSignal(int) {
+    stopRequested = 1;
+}
+
+// ===============================
+// Socket setup
+// ===============================
+static bool isPortNumber(const string &s) {
+    if (s.empty() || s.size() > 5) return false;
+    for (char c : s)
+        if (!isdigit((unsigned char)c)) return false;
+    return true;
+}
+
+static int openListener(const string &address) {
+    int fd;
+
+    if (isPortNumber(address)) {
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd < 0) return -1;
+
+        int yes = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+
+        sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons((unsigned short)stoi(address));
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);   // local clients only
+
+        if (bind(fd, (sockaddr*)&addr, sizeof(addr)) < 0) { close(fd); return -1; }
+    } else {
+        sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        if (address.size() >= sizeof(addr.sun_path)) { errno = ENAMETOOLONG; return -1; }
+
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) return -1;
+
+        addr.sun_family = AF_UNIX;
+        strncpy(addr.sun_path, address.c_str(), sizeof(addr.sun_path) - 1);
+        unlink(address.c_str());   // stale socket from a previous run
+
+        if (bind(fd, (sockaddr*)&addr, sizeof(addr)) < 0) { close(fd); return -1; }
+    }
+
+    if (listen(fd, 64) < 0) { close(fd); return -1; }
+    return fd;
+}
+
+static void writeAll(int fd, const string &data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t n = write(fd, data.data() + sent, data.size() - sent);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return;   // client went away; poll loop will notice
+        sent += (size_t)n;
+    }
+}
+
+// ===============================
+// Request handling (worker thread)
+// ===============================
+
+// Admissions go through the lock-free intake queue and are moved into the
+// PatientQueue by whichever thread can take the patient lock. Every
+// patient request calls this after releasing the lock, so an admission
+// whose try_lock failed is picked up by the thread that was holding it.
+static void drainAdmissions(HospitalSystem &hospital) {
+    shared_mutex &lock = hospital.lockFor(DATA_PATIENT);
+
+    while (hospital.getAdmissions().count() > 0) {
+        unique_lock<shared_mutex> guard(lock, try_to_lock);
+        if (!guard.owns_lock()) return;
+        if (hospital.drainAdmissions() > 0)
+            hospital.saveDataset(DATA_PATIENT);
+    }
+}
+
+static void admitPatient(HospitalSystem &hospital, const Command &cmd, ostream &out) {
+    auto name = cmd.args.find("name");
+    auto condition = cmd.args.find("condition");
+    if (name == cmd.args.end() || name->second.empty()) {
+        out << "err\tpatient.admit\tmessage=missing name\n";
+        return;
+    }
+    if (condition == cmd.args.end() || condition->second.empty()) {
+        out << "err\tpatient.admit\tmessage=missing condition\n";
+        return;
+    }
+
+    int id = hospital.getAdmissions().admitPatient(name->second, condition->second);
+    out << "ok\tpatient.admit\tid=" << id << "\n";
+}
+
+// Intake desks and triage officers work on the dispatch board with the
+// emergency lock held shared, so they never wait for each other. The
+// board's changes reach the emergency list (and its file) through
+// whichever thread gets the apply lock, as admissions do above; work on
+// the whole list holds the emergency lock exclusively and has the board
+// refilled afterwards.
+static void applyDispatch(HospitalSystem &hospital) {
+    while (hospital.getDispatch().unapplied() > 0) {
+        unique_lock<mutex> guard(hospital.dispatchLock(), try_to_lock);
+        if (!guard.owns_lock()) return;
+        hospital.applyDispatch();
+    }
+}
+
+static void dispatchCommand(HospitalSystem &hospital, const Command &cmd, ostream &out) {
+    ConcurrentEmergencyQueue &board = hospital.getDispatch();
+    Emergency e;
+
+    if (cmd.op == "log") {
+        const char *const need[] = {"name", "type", "priority"};
+        for (const char *key : need) {
+            auto it = cmd.args.find(key);
+            if (it == cmd.args.end() || it->second.empty()) {
+                out << "err\temergency.log\tmessage=missing " << key << "\n";
+                return;
+            }
+        }
+        const string &pri = cmd.args.at("priority");
+        int priority = pri.size() <= 2 && pri.find_first_not_of("0123456789") == string::npos ? atoi(pri.c_str()) : -1;
+        if (priority < 1 || priority > 10) {
+            out << "err\temergency.log\tmessage=priority must be 1-10\n";
+            return;
+        }
+        e.type = cmd.args.at("type");
+        e.priority = priority;
+    }
+
+    shared_mutex &lock = hospital.lockFor(DATA_EMERGENCY);
+    while (true) {
+        if (!hospital.dispatchCurrent()) {
+            unique_lock<shared_mutex> guard(lock);
+            if (!hospital.dispatchCurrent()) hospital.refillDispatch();
+        }
+        shared_lock<shared_mutex> guard(lock);
+        if (!hospital.dispatchCurrent()) continue;   // the list changed in between
+
+        if (cmd.op == "log") {
+            // The slot first: a full board must not use up a patient ID
+            if (board.reserve()) {
+                e.patient = PatientRegistry::instance().registerPerson(cmd.args.at("name"), e.type);
+                e.id = caseIDFor(e.patient);
+                e.loggedAt = wallClockMillis();
+                board.logReserved(e);
+                out << "ok\temergency.log\tid=" << e.id << "\n";
+            } else {
+                out << "err\temergency.log\tmessage=emergency list full\n";
+            }
+        } else if (board.popCritical(e)) {
+            out << "ok\temergency.process\tid=" << e.id << "\tname=" << e.name()
+                << "\ttype=" << e.type << "\tpriority=" << e.priority << "\n";
+        } else {
+            out << "err\temergency.process\tmessage=no cases\n";
+        }
+        applyDispatch(hospital);
+        return;
+    }
+}
+
+static void serveLine(HospitalSystem &hospital, CommandRunner &runner, const string &line, ostream &out) {
+    Command cmd;
+    string error;
+    if (!parseCommand(line, cmd, error)) {
+        out << "err\tparse\tmessage=" << error << "\n";
+        return;
+    }
+
+    Dataset which;
+    if (!datasetFor(cmd.module, which)) {
+        runner.execute(cmd, out);   // reports the unknown module
+        return;
+    }
+
+    // Intake IDs come from an in-process counter, which other processes
+    // sharing the patient segment can't see: use the locked path then
+    if (which == DATA_PATIENT && cmd.op == "admit" && !hospital.getPatients().isShared()) {
+        admitPatient(hospital, cmd, out);
+        drainAdmissions(hospital);
+        return;
+    }
+
+    // The board lives in this process only
+    if (which == DATA_EMERGENCY && (cmd.op == "log" || cmd.op == "process") && !hospital.getEmergency().isShared()) {
+        dispatchCommand(hospital, cmd, out);
+        return;
+    }
+
+    // Transfers touch both modules. Locks are always taken patient first,
+    // then emergency, so two transfers can't deadlock.
+    if ((which == DATA_PATIENT && cmd.op == "triage") || (which == DATA_EMERGENCY && cmd.op == "return")) {
+        {
+            unique_lock<shared_mutex> patientGuard(hospital.lockFor(DATA_PATIENT));
+            unique_lock<shared_mutex> emergencyGuard(hospital.lockFor(DATA_EMERGENCY));
+            hospital.drainAdmissions();
+            hospital.releaseDispatch();
+            if (runner.execute(cmd, out))
+                runner.flush();
+        }
+        drainAdmissions(hospital);
+        return;
+    }
+
+    // Store rooms lock themselves, so wards don't wait for each other; the
+    // medical lock is only held shared to keep whole-store work out
+    if (which == DATA_MEDICAL) {
+        shared_lock<shared_mutex> guard(hospital.lockFor(DATA_MEDICAL));
+        if (runner.execute(cmd, out) && cmd.op != "view" && cmd.op != "stock" && cmd.op != "rooms")
+            runner.flush();
+        return;
+    }
+
+    shared_mutex &lock = hospital.lockFor(which);
+    if (cmd.op == "view" || cmd.op == "lanes") {
+        shared_lock<shared_mutex> guard(lock);
+        if (which == DATA_EMERGENCY) {
+            // Board changes are applied under the shared lock too
+            lock_guard<mutex> apply(hospital.dispatchLock());
+            hospital.applyDispatch();
+            runner.execute(cmd, out);
+        } else {
+            runner.execute(cmd, out);
+        }
+    } else {
+        unique_lock<shared_mutex> guard(lock);
+        if (which == DATA_PATIENT)
+            hospital.drainAdmissions();   // keep FIFO order for discharge
+        if (which == DATA_EMERGENCY)
+            hospital.releaseDispatch();
+        if (runner.execute(cmd, out))
+            runner.flush();
+    }
+
+    if (which == DATA_PATIENT)
+        drainAdmissions(hospital);
+}
+
+// Returns false when the client asked to quit
+static bool serveLines(HospitalSystem &hospital, Connection &conn, const string &lines) {
+    ostringstream reply;
+    istringstream in(lines);
+    string line;
+    bool keepOpen = true;
+
+    while (getline(in, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        size_t a = line.find_first_not_of(" \t");
+        if (a == string::npos) continue;
+        line = line.substr(a);
+
+        if (line == "quit") { keepOpen = false; break; }
+        if (line == "sync") {
+            if (conn.runner.reportWriteFailures(reply, "sync", true) == 0) reply << "ok\tsync\n";
+            continue;
+        }
+        if (line == "stats") {
+            reply << "ok\tstats\tjson=" << StatsRegistry::instance().json() << "\n";
+            continue;
+        }
+        if (line == "waits") {
+            writeWaitRows(reply);
+            continue;
+        }
+        if (line == "memory") {
+            writeMemoryRows(hospital, reply);
+            continue;
+        }
+        serveLine(hospital, conn.runner, line, reply);
+    }
+
+    writeAll(conn.fd, reply.str());
+    return keepOpen;
+}
+
+// ===============================
+// Event loop
+// ===============================
+int runServer(HospitalSystem &hospital, const string &address, int threads) {
+    int listener = openListener(address);
+    if (listener < 0) {
+        cerr << "[ERROR] Cannot listen on " << address << ": " << strerror(errno) << "\n";
+        return 2;
+    }
+
+    // Workers poke this pipe when they hand a connection back
+    int wake[2];
+    if (pipe(wake) < 0) {
+        cerr << "[ERROR] pipe: " << strerror(errno) << "\n";
+        close(listener);
+        return 2;
+    }
+    fcntl(wake[0], F_SETFL, O_NONBLOCK);
+    fcntl(wake[1], F_SETFL, O_NONBLOCK);
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = onStopSignal;   // no SA_RESTART: poll() must return
+    sigaction(SIGINT, &sa, nullptr);
+    sigaction(SIGTERM, &sa, nullptr);
+    signal(SIGPIPE, SIG_IGN);
+
+    cout << "[INFO] Serving on " << address << " with " << threads << " worker threads. Ctrl+C to stop.\n";
+
+    map<int, unique_ptr<Connection>> connections;
+    {
+        ThreadPool pool(threads);
+
+        while (!stopRequested) {
+            vector<pollfd> fds;
+            fds.push_back({listener, POLLIN, 0});
+            fds.push_back({wake[0], POLLIN, 0});
+            for (auto &entry : connections)
+                if (!entry.second->busy)
+                    fds.push_back({entry.first, POLLIN, 0});
+
+            if (poll(fds.data(), fds.size(), -1) < 0) {
+                if (errno == EINTR) continue;
+                cerr << "[ERROR] poll: " << strerror(errno) << "\n";
+                break;
+            }
+
+            if (fds[1].revents & POLLIN) {
+                char drain[64];
+                while (read(wake[0], drain, sizeof(drain)) > 0) {}
+            }
+
+            if (fds[0].revents & POLLIN) {
+                int client = accept(listener, nullptr, nullptr);
+                if (client >= 0)
+                    connections[client].reset(new Connection(client, hospital));
+            }
+
+            for (size_t i = 2; i < fds.size(); i++) {
+                if (fds[i].revents == 0) continue;
+                Connection &conn = *connections[fds[i].fd];
+
+                char buffer[4096];
+                ssize_t n = read(conn.fd, buffer, sizeof(buffer));
+                if (n <= 0) {
+                    conn.closing = true;
+                    continue;
+                }
+                conn.input.append(buffer, (size_t)n);
+
+                size_t lastNewline = conn.input.rfind('\n');
+                if (lastNewline == string::npos) continue;
+
+                string lines = conn.input.substr(0, lastNewline + 1);
+                conn.input.erase(0, lastNewline + 1);
+
+                conn.busy = true;
+                Connection *target = &conn;
+                int wakeFd = wake[1];
+                pool.submit([&hospital, target, lines, wakeFd] {
+                    if (!serveLines(hospital, *target, lines))
+                        target->closing = true;
+                    target->busy = false;
+                    char c = 0;
+                    ssize_t ignored = write(wakeFd, &c, 1);
+                    (void)ignored;
+                });
+            }
+
+            for (auto it = connections.begin(); it != connections.end(); ) {
+                if (it->second->closing && !it->second->busy) {
+                    close(it->first);
+                    it = connections.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+        }
+        // pool destructor finishes in-flight requests here
+    }
+
+    for (auto &entry : connections) close(entry.first);
+    close(listener);
+    close(wake[0]);
+    close(wake[1]);
+    if (!isPortNumber(address)) unlink(address.c_str());
+
+    if (hospital.dispatchDivergences() > 0)
+        cerr << "[WARN] " << hospital.dispatchDivergences() << " dispatch board change(s) did not match the emergency list.\n";
+    cout << "[INFO] Server stopped.\n";
+    return 0;
+}
+
+#endif
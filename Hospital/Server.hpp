@@ -0,0 +1,26 @@
+#ifndef SERVER_HPP
+#define SERVER_HPP
+
+#include <string>
+
+#include "Hospital.hpp"
+
+// Serve the scripted command protocol (see Script.hpp) to many clients.
+//
+// address is either a port number (listens on 127.0.0.1) or a filesystem
+// path (Unix-domain socket). Each request is one line; the reply is any
+// "row" lines followed by exactly one "ok" or "err" line. "quit" closes
+// the connection.
+//
+// Requests run on a pool of `threads` workers. Every module has its own
+// reader/writer lock, so "view" requests share the lock while writes to
+// one module never wait for another module. Patient admissions take no
+// lock at all (see ConcurrentPatientQueue).
+//
+// Each write queues its module's file on the background writer before
+// the reply is sent (admissions: by whichever thread next holds the
+// patient lock); "sync" waits until everything queued is on disk.
+// Stops on SIGINT/SIGTERM. Returns the process exit code.
+int runServer(HospitalSystem &hospital, const std::string &address, int threads);
+
+#endif // SERVER_HPP
@@ -0,0 +1,409 @@
+#include "Simulation.hpp"
+#include "ThreadPool.hpp"
+#include "../Emergency/Emergency.hpp"
+#include "../Ambulance/Ambulance.hpp"
+#include "../Common/Table.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <ctime>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <thread>
+
+using namespace std;
+
+// ===============================
+// Model
+// ===============================
+// Simulated time is in milliseconds of wall clock time, starting at local
+// midnight of a fixed date, so FleetTelemetry puts shift changes at the
+// same hours as in real use.
+static const int64_t MINUTE = 60 * 1000;
+static const int64_t HOUR = 60 * MINUTE;
+static const int64_t DAY = 24 * HOUR;
+static const double PI = 3.14159265358979323846;
+
+// Arrivals swing around the daily mean: busiest at 4 PM, quietest at 4 AM
+static const double ARRIVAL_SWING = 0.6;
+static const double ARRIVAL_PEAK_HOUR = 16;
+
+// How often each priority turns up (1 = critical ... 10 = mild)
+static const double PRIORITY_WEIGHTS[10] = {2, 3, 5, 8, 10, 14, 16, 16, 14, 12};
+
+static double ambulanceChance(int priority) {
+    return priority <= 3 ? 0.9 : (priority <= 6 ? 0.5 : 0.15);
+}
+
+// Mean minutes; half of it is fixed, the rest exponential
+static const double MINUTES_TO_HOSPITAL = 35;   // drive out, on scene, drive in
+static const double MINUTES_BACK_TO_BASE = 15;
+static double treatmentMinutes(int priority) { return 15 + 3 * (10 - priority); }
+
+static int64_t simulationStart() {
+    tm start = {};
+    start.tm_year = 2026 - 1900;
+    start.tm_mon = 0;
+    start.tm_mday = 5;
+    start.tm_isdst = -1;
+    return (int64_t)mktime(&start) * 1000;
+}
+
+// ===============================
+// Waiting cases
+// ===============================
+struct SimCase {
+    int     priority;
+    int64_t since;
+};
+
+// At most MAX_EMERGENCY cases in arrival order, like the real list, but
+// in a fixed array
+class SimCaseList {
+private:
+    SimCase items[MAX_EMERGENCY];
+    int     n;
+
+public:
+    SimCaseList() : n(0) {}
+
+    bool empty() const { return n == 0; }
+    bool full() const { return n == MAX_EMERGENCY; }
+    void pushBack(const SimCase &c) { items[n++] = c; }
+
+    template <class F>
+    void forEach(F f) const {
+        for (int i = 0; i < n; i++)
+            if (!f((size_t)i, items[i])) return;
+    }
+
+    // The case EmergencyManager would take next
+    SimCase takeCritical() {
+        int i = mostCriticalIndex(*this);
+        SimCase c = items[i];
+        for (int j = i + 1; j < n; j++) items[j - 1] = items[j];
+        n--;
+        return c;
+    }
+};
+
+// ===============================
+// Events
+// ===============================
+enum SimEventKind : uint8_t { SIM_ARRIVAL, SIM_AT_HOSPITAL, SIM_AT_BASE, SIM_TREATED, SIM_HOUR };
+
+struct SimEvent {
+    int64_t      at;
+    uint64_t     order;      // equal times: first scheduled, first handled
+    SimEventKind kind;
+    int8_t       priority;   // of the case carried
+    int16_t      unit;       // ambulance ID
+};
+
+// For a min-heap on (at, order)
+struct SimEventLater {
+    bool operator()(const SimEvent &a, const SimEvent &b) const {
+        return a.at != b.at ? a.at > b.at : a.order > b.order;
+    }
+};
+
+// ===============================
+// One scenario
+// ===============================
+class Simulator {
+private:
+    SimulationResult &result;
+
+    int64_t start, end, now;
+    vector<SimEvent> events;   // binary heap, reserved up front
+    uint64_t scheduled;
+
+    mt19937_64 arrivals;   // same stream in every scenario
+    mt19937_64 service;
+    exponential_distribution<double> exponential;
+    uniform_real_distribution<double> unit;
+    discrete_distribution<int> priorities;
+    double peakRate;   // arrivals per ms at the busiest moment
+
+    SimCaseList waiting;   // logged, waiting for an officer
+    SimCaseList calls;     // waiting for an ambulance
+    int idleOfficers;
+    int64_t officerBusy;
+
+    Ambulance fleet[MAX_AMBULANCES];   // by ID - 1
+    AmbulanceQueue onDuty;             // available, in dispatch order
+    AmbulanceQueue offDuty;
+    FleetTelemetry telemetry;
+    string error;                      // telemetry's, unused
+
+    void schedule(int64_t at, SimEventKind kind, int priority = 0, int ambulanceID = 0) {
+        events.push_back(SimEvent{at, scheduled++, kind, (int8_t)priority, (int16_t)ambulanceID});
+        push_heap(events.begin(), events.end(), SimEventLater());
+    }
+
+    int64_t minutes(mt19937_64 &rng, double mean) {
+        return (int64_t)((mean / 2 + exponential(rng) * mean / 2) * MINUTE);
+    }
+
+    double rateAt(int64_t t) const {
+        double hour = (double)((t - start) % DAY) / HOUR;
+        return peakRate / (1 + ARRIVAL_SWING) *
+               (1 + ARRIVAL_SWING * cos(2 * PI * (hour - ARRIVAL_PEAK_HOUR) / 24));
+    }
+
+    // ---------- Officers ----------
+    void treat(const SimCase &c) {
+        double waited = (double)(now - c.since) / MINUTE;
+        result.waitMinutes.add(waited);
+        if (c.priority <= 3) result.criticalWaitMinutes.add(waited);
+
+        int64_t done = now + minutes(service, treatmentMinutes(c.priority));
+        officerBusy += min(done, end) - now;
+        schedule(done, SIM_TREATED);
+    }
+
+    void logCase(int priority) {
+        SimCase c{priority, now};
+        if (idleOfficers > 0) {
+            idleOfficers--;
+            treat(c);
+        } else if (waiting.full()) {
+            result.diverted++;
+        } else {
+            waiting.pushBack(c);
+        }
+    }
+
+    // ---------- Ambulances ----------
+    void dispatch(const SimCase &call) {
+        Ambulance a;
+        onDuty.dequeue(a);
+        AmbulanceState state = AMB_DISPATCHED;
+        telemetry.transition(a.id, state, now, error);
+        result.responseMinutes.add((double)(now - call.since) / MINUTE);
+        schedule(now + minutes(service, MINUTES_TO_HOSPITAL), SIM_AT_HOSPITAL, call.priority, a.id);
+    }
+
+    void dispatchWaiting() {
+        while (!calls.empty() && !onDuty.isEmpty()) dispatch(calls.takeCritical());
+    }
+
+    // Keep the two queues in step with the shift on duty
+    void moveOver(AmbulanceQueue &from, AmbulanceQueue &to, AmbulanceState state) {
+        int n = from.size();
+        Ambulance a;
+        for (int i = 0; i < n; i++) {
+            from.dequeue(a);
+            AmbulanceState s = AMB_OFF_SHIFT;
+            telemetry.stateOf(a.id, s);
+            (s == state ? to : from).enqueue(a);
+        }
+    }
+
+    // ---------- Event handlers ----------
+    void arrival() {
+        schedule(now + max<int64_t>(1, (int64_t)(exponential(arrivals) / peakRate)), SIM_ARRIVAL);
+        if (unit(arrivals) * peakRate > rateAt(now)) return;   // thinned out: quieter hour
+
+        int priority = priorities(arrivals) + 1;
+        bool byAmbulance = unit(arrivals) < ambulanceChance(priority);
+        result.cases++;
+        if (!byAmbulance) {
+            logCase(priority);
+            return;
+        }
+
+        result.calls++;
+        SimCase call{priority, now};
+        if (!onDuty.isEmpty()) dispatch(call);
+        else if (calls.full()) result.diverted++;
+        else calls.pushBack(call);
+    }
+
+    void atHospital(const SimEvent &e) {
+        AmbulanceState state = AMB_RETURNING;
+        telemetry.transition(e.unit, state, now, error);
+        schedule(now + minutes(service, MINUTES_BACK_TO_BASE), SIM_AT_BASE, 0, e.unit);
+        logCase(e.priority);
+    }
+
+    void atBase(const SimEvent &e) {
+        AmbulanceState state = AMB_AVAILABLE;   // off shift if its shift has ended
+        telemetry.transition(e.unit, state, now, error);
+        if (state == AMB_AVAILABLE) {
+            onDuty.enqueue(fleet[e.unit - 1]);
+            dispatchWaiting();
+        } else {
+            offDuty.enqueue(fleet[e.unit - 1]);
+        }
+    }
+
+    void treated() {
+        if (waiting.empty()) idleOfficers++;
+        else treat(waiting.takeCritical());
+    }
+
+    void hour() {
+        schedule(now + HOUR, SIM_HOUR);
+        telemetry.catchUp(now);
+        moveOver(onDuty, offDuty, AMB_OFF_SHIFT);
+        moveOver(offDuty, onDuty, AMB_AVAILABLE);
+        dispatchWaiting();
+    }
+
+public:
+    Simulator(const SimulationConfig &c, SimulationResult &r, int ambulances, int officers)
+        : result(r), scheduled(0), arrivals(c.seed), service(c.seed * 0x9E3779B97F4A7C15ull + 1),
+          exponential(1.0), unit(0.0, 1.0), priorities(PRIORITY_WEIGHTS, PRIORITY_WEIGHTS + 10),
+          idleOfficers(officers), officerBusy(0) {
+        start = simulationStart();
+        end = start + (int64_t)c.days * DAY;
+        now = start;
+        peakRate = (double)c.casesPerDay / DAY * (1 + ARRIVAL_SWING);
+        events.reserve(MAX_AMBULANCES + officers + 8);   // at most one pending event per actor
+
+        for (int i = 0; i < ambulances; i++) {
+            Ambulance &a = fleet[i];
+            a.id = i + 1;
+            snprintf(a.plate, sizeof(a.plate), "SIM%03d", a.id);
+            snprintf(a.driverName, sizeof(a.driverName), "Crew %d", a.id);
+            a.shift = i % AMBULANCE_SHIFTS;
+            telemetry.track(a.id, a.shift, now);
+            AmbulanceState state = AMB_OFF_SHIFT;
+            telemetry.stateOf(a.id, state);
+            (state == AMB_AVAILABLE ? onDuty : offDuty).enqueue(a);
+        }
+    }
+
+    void run() {
+        schedule(now, SIM_ARRIVAL);
+        schedule(now + HOUR, SIM_HOUR);
+
+        while (!events.empty() && events.front().at < end) {
+            pop_heap(events.begin(), events.end(), SimEventLater());
+            SimEvent e = events.back();
+            events.pop_back();
+            now = e.at;
+            result.events++;
+
+            switch (e.kind) {
+                case SIM_ARRIVAL:     arrival(); break;
+                case SIM_AT_HOSPITAL: atHospital(e); break;
+                case SIM_AT_BASE:     atBase(e); break;
+                case SIM_TREATED:     treated(); break;
+                case SIM_HOUR:        hour(); break;
+            }
+        }
+
+        telemetry.catchUp(end);
+        result.ambulanceUtilization = telemetry.fleetTimes(end).utilization();
+        result.officerUtilization = result.officers > 0
+            ? (double)officerBusy / ((double)result.officers * (double)(end - start)) : 0.0;
+    }
+};
+
+SimulationResult simulateScenario(const SimulationConfig &config, int ambulances, int officers) {
+    SimulationResult result;
+    result.ambulances = ambulances;
+    result.officers = officers;
+    result.cases = result.calls = result.diverted = result.events = 0;
+    result.officerUtilization = result.ambulanceUtilization = 0;
+
+    auto started = chrono::steady_clock::now();
+    unique_ptr<Simulator> sim(new Simulator(config, result, ambulances, officers));
+    sim->run();
+    result.wallSeconds = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+    return result;
+}
+
+// ===============================
+// Scenarios and report
+// ===============================
+bool parseCountList(const string &text, int min, int max, vector<int> &out) {
+    out.clear();
+    stringstream in(text);
+    string part;
+    while (getline(in, part, ',')) {
+        int from, to;
+        char dash, extra;
+        stringstream p(part);
+        if (!(p >> from)) return false;
+        if (p >> dash) {
+            if (dash != '-' || !(p >> to) || p >> extra) return false;
+        } else {
+            to = from;
+        }
+        if (from < min || to > max || from > to) return false;
+        for (int n = from; n <= to; n++) out.push_back(n);
+    }
+    return !out.empty();
+}
+
+static string fixedText(double value, int decimals) {
+    ostringstream t;
+    t << fixed << setprecision(decimals) << value;
+    return t.str();
+}
+
+int runSimulation(const SimulationConfig &config) {
+    vector<future<SimulationResult>> running;
+    auto started = chrono::steady_clock::now();
+    {
+        ThreadPool pool(config.threads);
+        for (int ambulances : config.ambulances)
+            for (int officers : config.officers)
+                running.push_back(pool.submit([&config, ambulances, officers] {
+                    return simulateScenario(config, ambulances, officers);
+                }));
+    }
+    double wall = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+
+    cout << "\nSimulated " << config.days << " days at " << config.casesPerDay << " cases/day, seed "
+         << config.seed << ". Waits in minutes.\n";
+
+    // Every figure is formatted first, so each column is as wide as its
+    // longest one: a capacity report must never cut a number short
+    vector<TableColumn> columns = {{"Amb", 4, true},      {"Off", 4, true},      {"Cases", 7, true},
+                                   {"Divert", 6, true},   {"Wait p50", 8, true}, {"p90", 6, true},
+                                   {"p99", 6, true},      {"Crit p90", 8, true}, {"Resp p50", 8, true},
+                                   {"p90", 6, true},      {"Off %", 6, true},    {"Amb %", 6, true}};
+    vector<vector<string>> cells;
+    uint64_t events = 0;
+    double busySeconds = 0;
+    for (auto &f : running) {
+        SimulationResult r = f.get();
+        events += r.events;
+        busySeconds += r.wallSeconds;
+        cells.push_back({to_string(r.ambulances), to_string(r.officers), to_string(r.cases), to_string(r.diverted),
+                         fixedText(r.waitMinutes.quantile(0.5), 1), fixedText(r.waitMinutes.quantile(0.9), 1),
+                         fixedText(r.waitMinutes.quantile(0.99), 1), fixedText(r.criticalWaitMinutes.quantile(0.9), 1),
+                         fixedText(r.responseMinutes.quantile(0.5), 1), fixedText(r.responseMinutes.quantile(0.9), 1),
+                         fixedText(r.officerUtilization * 100, 1), fixedText(r.ambulanceUtilization * 100, 1)});
+        for (size_t i = 0; i < columns.size(); i++)
+            columns[i].width = max(columns[i].width, cells.back()[i].size());
+    }
+
+    size_t width = 1;   // "| " ... " | " ... " |"
+    for (const TableColumn &c : columns) width += c.width + 3;
+    string title = " Capacity Scenarios ";
+    size_t left = width > title.size() ? (width - title.size()) / 2 : 0;
+    size_t right = width > title.size() + left ? width - title.size() - left : 0;
+
+    TableWriter table(cout, columns, true);
+    table.line("\n" + string(left, '=') + title + string(right, '='));
+    table.header();
+    for (const vector<string> &c : cells)
+        if (!table.row({c[0], c[1], c[2], c[3], c[4], c[5], c[6], c[7], c[8], c[9], c[10], c[11]})) break;
+    table.line(string(width, '-'));
+    table.line("  Amb: fleet size, a third on each shift. Off: officers on duty. Divert: list or call queue full.");
+    table.line("  " + to_string(events) + " events in " + fixedText(wall, 2) + " s on " + to_string(config.threads) +
+               " threads (" + fixedText(busySeconds > 0 ? events / busySeconds / 1e6 : 0, 2) +
+               " million events/s per thread)");
+    table.finish(running.size(), string(width, '='));
+    return 0;
+}
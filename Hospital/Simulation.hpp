@@ -0,0 +1,66 @@
+#ifndef SIMULATION_HPP
+#define SIMULATION_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "../Common/Quantile.hpp"
+
+// Capacity planning: how many ambulances and emergency officers does a
+// given caseload need?
+//
+// Each scenario is a discrete-event simulation of the emergency
+// department over a number of days. Cases arrive at random (more in the
+// afternoon than at night) with a priority from 1 to 10. Most critical
+// cases and some of the others come in by ambulance, the rest walk in.
+// The simulation uses the real pieces where they decide something:
+//   - officers take the case EmergencyManager would take
+//     (mostCriticalIndex), and cases beyond MAX_EMERGENCY are diverted;
+//   - available ambulances wait in an AmbulanceQueue and are sent in
+//     rotation, front first, one back at base joining the rear;
+//   - crews work the same three shifts, followed by FleetTelemetry,
+//     which also measures utilization.
+//
+// Nothing is read or written and nobody is asked anything. After set-up
+// an event allocates nothing, except when the fleet telemetry's event
+// log (up to TELEMETRY_MAX_EVENTS) or a quantile sketch (logarithmic in
+// its samples) grows. Scenarios are independent and run in
+// parallel on a thread pool. Every scenario draws its arrivals from the
+// same seeded stream, so they are compared on the same days, and a seed
+// always gives the same report.
+
+struct SimulationConfig {
+    int              casesPerDay;
+    int              days;
+    uint64_t         seed;
+    std::vector<int> ambulances;   // fleet sizes to try (a third on each shift)
+    std::vector<int> officers;     // officers on duty to try
+    int              threads;
+};
+
+struct SimulationResult {
+    int      ambulances;
+    int      officers;
+    uint64_t cases;
+    uint64_t calls;              // cases that needed an ambulance
+    uint64_t diverted;           // list or call queue full: sent elsewhere
+    QuantileSketch waitMinutes;          // logged -> taken by an officer
+    QuantileSketch criticalWaitMinutes;  // the same, priority 1-3
+    QuantileSketch responseMinutes;      // call -> ambulance sent
+    double   officerUtilization;
+    double   ambulanceUtilization;       // busy / (busy + idle) while on shift
+    uint64_t events;
+    double   wallSeconds;
+};
+
+SimulationResult simulateScenario(const SimulationConfig &config, int ambulances, int officers);
+
+// Runs every (ambulances, officers) pair and prints the report. Returns
+// the process exit code.
+int runSimulation(const SimulationConfig &config);
+
+// "6,9,12" or "6-12"; every number within [min, max]
+bool parseCountList(const std::string &text, int min, int max, std::vector<int> &out);
+
+#endif // SIMULATION_HPP
@@ -0,0 +1,72 @@
+#ifndef THREADPOOL_HPP
+#define THREADPOOL_HPP
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+// Small fixed-size worker pool. Tasks run in submission order across
+// the workers; the destructor finishes queued tasks and joins.
+class ThreadPool {
+private:
+    std::vector<std::thread>          workers;
+    std::queue<std::function<void()>> tasks;
+    std::mutex                        lock;
+    std::condition_variable           ready;
+    bool                              stopping;
+
+    void workerLoop() {
+        while (true) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> guard(lock);
+                ready.wait(guard, [this] { return stopping || !tasks.empty(); });
+                if (stopping && tasks.empty()) return;
+                task = std::move(tasks.front());
+                tasks.pop();
+            }
+            task();
+        }
+    }
+
+public:
+    explicit ThreadPool(int threads) : stopping(false) {
+        if (threads < 1) threads = 1;
+        for (int i = 0; i < threads; ++i)
+            workers.emplace_back(&ThreadPool::workerLoop, this);
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            stopping = true;
+        }
+        ready.notify_all();
+        for (std::thread &t : workers) t.join();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    int threadCount() const { return (int)workers.size(); }
+
+    template <class F>
+    auto submit(F f) -> std::future<decltype(f())> {
+        using R = decltype(f());
+        auto job = std::make_shared<std::packaged_task<R()>>(std::move(f));
+        std::future<R> result = job->get_future();
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            tasks.push([job] { (*job)(); });
+        }
+        ready.notify_one();
+        return result;
+    }
+};
+
+#endif // THREADPOOL_HPP
@@ -17,17 +17,39 @@ void getCompileRunCommands(const string &role, string &compileCmd, string &runCm
 #endif
 
     if (role == "patient") {
-        compileCmd = "g++ Patient/Patient.cpp -o Patient" + exeExt;
+        compileCmd = "g++ -std=c++17 -pthread Patient/Patient.cpp -o Patient" + exeExt;
         runCmd = "Patient" + exeExt;
     } else if (role == "medical") {
-        compileCmd = "g++ Medical/Medical.cpp -o Medical" + exeExt;
+        compileCmd = "g++ -std=c++17 -pthread Medical/Medical.cpp -o Medical" + exeExt;
         runCmd = "Medical" + exeExt;
     } else if (role == "emergency") {
-        compileCmd = "g++ Emergency/Emergency.cpp -o Emergency" + exeExt;
+        compileCmd = "g++ -std=c++17 -pthread Emergency/Emergency.cpp -o Emergency" + exeExt;
         runCmd = "Emergency" + exeExt;
     } else if (role == "ambulance") {
-        compileCmd = "g++ Ambulance/Ambulance.cpp -o Ambulance" + exeExt;
+        compileCmd = "g++ -std=c++17 -pthread Ambulance/Ambulance.cpp -o Ambulance" + exeExt;
         runCmd = "Ambulance" + exeExt;
+    } else if (role == "hospital") {
+        // All modules linked into one process (each module's own main() is compiled out)
+        compileCmd = "g++ -std=c++17 -pthread -DHOSPITAL_SINGLE_PROCESS"
+                     " Hospital/Hospital.cpp Hospital/Script.cpp Hospital/Server.cpp Hospital/Replay.cpp Hospital/Replica.cpp"
+                     " Hospital/Backup.cpp Hospital/Simulation.cpp"
+                     " Patient/Patient.cpp Medical/Medical.cpp"
+                     " Emergency/Emergency.cpp Ambulance/Ambulance.cpp -o Hospital" + exeExt;
+        runCmd = "Hospital" + exeExt;
+    } else if (role == "bench") {
+        // Optimised build; generates data under bench_data/ and prints CSV results
+        compileCmd = "g++ -std=c++17 -O2 -pthread -DHOSPITAL_SINGLE_PROCESS"
+                     " Bench/Bench.cpp Medical/Medical.cpp Emergency/Emergency.cpp Ambulance/Ambulance.cpp"
+                     " -o Bench" + exeExt;
+        runCmd = "Bench" + exeExt;
+    } else if (role == "simulation") {
+        // Optimised build of the integrated system, run in capacity planning mode
+        compileCmd = "g++ -std=c++17 -O2 -pthread -DHOSPITAL_SINGLE_PROCESS"
+                     " Hospital/Hospital.cpp Hospital/Script.cpp Hospital/Server.cpp Hospital/Replay.cpp Hospital/Replica.cpp"
+                     " Hospital/Backup.cpp Hospital/Simulation.cpp"
+                     " Patient/Patient.cpp Medical/Medical.cpp"
+                     " Emergency/Emergency.cpp Ambulance/Ambulance.cpp -o HospitalSim" + exeExt;
+        runCmd = "HospitalSim" + exeExt + " --simulate";
     }
 
 #ifndef _WIN32
@@ -49,7 +71,10 @@ int main() {
         cout << "2. Medical Supply Manager\n";
         cout << "3. Emergency Department Officer\n";
         cout << "4. Ambulance Dispatcher\n";
-        cout << "5. Exit\n";
+        cout << "5. Integrated System (all modules in one process)\n";
+        cout << "6. Benchmark Suite (results as CSV)\n";
+        cout << "7. Capacity Simulation (ambulances and officers needed)\n";
+        cout << "8. Exit\n";
 
         string choiceStr;
         getline(cin, choiceStr);
@@ -59,7 +84,10 @@ int main() {
         else if (choiceStr == "2") role = "medical";
         else if (choiceStr == "3") role = "emergency";
         else if (choiceStr == "4") role = "ambulance";
-        else if (choiceStr == "5") break;
+        else if (choiceStr == "5") role = "hospital";
+        else if (choiceStr == "6") role = "bench";
+        else if (choiceStr == "7") role = "simulation";
+        else if (choiceStr == "8") break;
         else {
             cout << "[ERROR] Invalid choice. Try again.\n\n";
             continue;
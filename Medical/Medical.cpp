@@ -1,27 +1,103 @@
 #include "Medical.hpp"
+#include "../Common/Persistence.hpp"
+#include "../Common/Snapshot.hpp"
+#include "../Common/Stats.hpp"
+#include "../Common/Trace.hpp"
+#include "../Common/Recorder.hpp"
+#include "../Common/Table.hpp"
 #include <iostream>
 #include <fstream>
 #include <sstream>
 #include <iomanip>   // for formatting output
+#include <cstdlib>
 
 using namespace std;
 
 // ===============================
 // Constructor
 // ===============================
-MedicalSupplyManager::MedicalSupplyManager() : top(-1) {
-    loadFromCSV();   // load existing data when object is created
+MedicalSupplyManager::MedicalSupplyManager(bool load, const string &storeRoom)
+    : room(storeRoom), csvPath(supplyCsvPath(storeRoom)), sharedGeneration(0) {
+    if (load)
+        loadFromCSV();   // load existing data when object is created
 }
 
 // ===============================
 // Helper functions
 // ===============================
 bool MedicalSupplyManager::isFull() const {
-    return top == MAX_SUPPLIES - 1;
+    return supplies.size() >= (size_t)MAX_SUPPLIES;
 }
 
 bool MedicalSupplyManager::isEmpty() const {
-    return top == -1;
+    return supplies.empty();
+}
+
+int MedicalSupplyManager::count() const {
+    return (int)supplies.size();
+}
+
+// ===============================
+// Shared memory mode
+// ===============================
+
+// Copy the segment into the stack if another process changed it
+void MedicalSupplyManager::pullShared(bool force) {
+    SupplyTable::Layout *seg = shared->get();
+    if (!force && seg->generation == sharedGeneration)
+        return;
+
+    std::vector<Supply> items;
+    for (int i = 0; i < seg->count; ++i)
+        items.push_back(Supply{seg->records[i].type, seg->records[i].quantity, seg->records[i].batch});
+    supplies.assign(items);
+    history.clear();   // our old versions would undo someone else's work
+    sharedGeneration = seg->generation;
+}
+
+// Publish the stack after a change
+void MedicalSupplyManager::pushShared() {
+    SupplyTable::Layout *seg = shared->get();
+
+    supplies.forEach([&](size_t i, const Supply &s) {
+        copyText(seg->records[i].type, s.type);
+        seg->records[i].quantity = s.quantity;
+        copyText(seg->records[i].batch, s.batch);
+        return true;
+    });
+    seg->count = count();
+    sharedGeneration = ++seg->generation;
+}
+
+bool MedicalSupplyManager::enableSharedMemory(const string &name) {
+    unique_ptr<SupplyTable> table(new SupplyTable());
+    string error;
+    if (!table->attach(name, error)) {
+        cout << "[Warning] Shared memory unavailable (" << error << "). Using private data.\n";
+        return false;
+    }
+
+    shared = move(table);
+    SharedScope<SupplyTable> scope(shared.get());
+    if (!shared->get()->loaded) {
+        pushShared();   // first process: seed the segment from our CSV
+        shared->get()->loaded = 1;
+    } else {
+        pullShared(true);
+    }
+    return true;
+}
+
+void MedicalSupplyManager::refresh() {
+    SharedScope<SupplyTable> scope(shared.get());
+    if (scope.active())
+        pullShared();
+}
+
+void MedicalSupplyManager::logSupplyChange(const string &op, ChangeFields fields) const {
+    if (room != MEDICAL_MAIN_ROOM)
+        fields.push_back({"room", room});
+    logChange("medical", op, fields);
 }
 
 // ===============================
@@ -30,6 +106,7 @@ bool MedicalSupplyManager::isEmpty() const {
 
 // Get a non-empty string
 string getNonEmptyString(const string &prompt) {
+    TraceSpan span("medical.prompt");
     string input;
     while (true) {
         cout << prompt;
@@ -44,6 +121,7 @@ string getNonEmptyString(const string &prompt) {
 
 // Get a positive integer
 int getPositiveInt(const string &prompt) {
+    TraceSpan span("medical.prompt");
     int value;
     while (true) {
         cout << prompt;
@@ -77,11 +155,40 @@ int getMenuChoice(const string &prompt, int min, int max) {
     }
 }
 
+// ===============================
+// Load from binary snapshot
+// ===============================
+struct SupplyRecord {
+    StrRef  type;
+    int32_t quantity;
+    StrRef  batch;
+};
+
+bool MedicalSupplyManager::loadFromSnapshot() {
+    TraceSpan span("medical.loadSnapshot");
+    SnapshotView snap;
+    if (!snap.open<SupplyRecord>(csvPath, SNAPSHOT_MEDICAL))
+        return false;
+
+    std::vector<Supply> items;
+    for (size_t i = 0; i < snap.count() && i < (size_t)MAX_SUPPLIES; ++i) {
+        const SupplyRecord &r = snap.record<SupplyRecord>(i);
+        items.push_back(Supply{snap.text(r.type), r.quantity, snap.text(r.batch)});
+    }
+    supplies.assign(items);
+    return true;
+}
+
 // ===============================
 // Load from CSV into stack
 // ===============================
 void MedicalSupplyManager::loadFromCSV() {
-    ifstream file(CSV_PATH.c_str());
+    StatTimer timer(STAT_MEDICAL_LOAD);
+    if (loadFromSnapshot())
+        return;   // binary snapshot is current: no CSV parsing needed
+
+    TraceSpan span("medical.parseCSV");
+    ifstream file(csvPath.c_str());
 
     if (!file.is_open()) {
         // File does not exist yet — start with empty stack
@@ -89,7 +196,7 @@ void MedicalSupplyManager::loadFromCSV() {
     }
 
     string line;
-    top = -1; // reset stack
+    std::vector<Supply> items;
 
     while (getline(file, line)) {
         if (line.empty())
@@ -113,44 +220,59 @@ void MedicalSupplyManager::loadFromCSV() {
         if (qss.fail())
             continue; // invalid quantity, skip
 
-        if (isFull()) {
+        if (items.size() >= (size_t)MAX_SUPPLIES) {
             cout << "[Warning] Maximum supplies reached. Some records from CSV were ignored.\n";
             break;
         }
 
-        top++;
-        supplies[top].type = type;
-        supplies[top].quantity = quantity;
-        supplies[top].batch = batch;
+        items.push_back(Supply{type, quantity, batch});
     }
 
     file.close();
+    supplies.assign(items);
 }
 
 // ===============================
 // Save stack to CSV
 // ===============================
-void MedicalSupplyManager::saveToCSV() {
-    ofstream file(CSV_PATH.c_str()); // overwrite file
-
-    if (!file.is_open()) {
-        cout << "[Error] Unable to open CSV file for writing: " << CSV_PATH << endl;
-        return;
-    }
-
-    for (int i = 0; i <= top; ++i) {
-        file << supplies[i].type << ","
-             << supplies[i].quantity << ","
-             << supplies[i].batch << "\n";
-    }
+string MedicalSupplyManager::csvText() const {
+    ostringstream file;
+    supplies.forEach([&](size_t, const Supply &s) {
+        file << s.type << ","
+             << s.quantity << ","
+             << s.batch << "\n";
+        return true;
+    });
+    return file.str();
+}
 
-    file.close();
+void MedicalSupplyManager::saveToCSV() {
+    StatTimer timer(STAT_MEDICAL_SAVE);
+    SnapshotWriter snap;
+
+    SupplyVersion saved = supplies;   // frozen: later changes don't show up
+    string csv = csvText();
+    saved.forEach([&](size_t, const Supply &s) {
+        SupplyRecord r;
+        r.type = snap.addString(s.type);
+        r.quantity = s.quantity;
+        r.batch = snap.addString(s.batch);
+        snap.addRecord(r);
+        return true;
+    });
+
+    // Replaces both files atomically, CSV first; queued on the background
+    // writer unless processes share the data
+    bool sync = shared != nullptr;
+    persistFile(csvPath, csv, sync);
+    persistFile(snapshotPathFor(csvPath), snap.finish<SupplyRecord>(SNAPSHOT_MEDICAL, 0, csv), sync);
 }
 
 // ===============================
 // 1. Add Supply Stock (PUSH)
 // ===============================
 void MedicalSupplyManager::addSupply() {
+    TraceSpan span("medical.addSupply");
     if (isFull()) {
         cout << "Supply stack is full! Cannot add more supplies.\n";
         return;
@@ -164,65 +286,218 @@ void MedicalSupplyManager::addSupply() {
     s.quantity = getPositiveInt("Enter quantity: ");
     s.batch = getNonEmptyString("Enter batch number: ");
 
-    supplies[++top] = s;
-    saveToCSV();
+    // Another process may have filled the stack while we were asking
+    if (!pushSupply(s)) {
+        cerr << "[ERROR] Failed to add supply: stack full\n";
+        return;
+    }
 
     cout << "[INFO] Supply added successfully and saved.\n";
 }
 
+// ===============================
+// Push without prompting
+// ===============================
+bool MedicalSupplyManager::pushSupply(const Supply &s, bool save) {
+    StatTimer timer(STAT_MEDICAL_ADD);
+    SharedScope<SupplyTable> scope(shared.get());
+    if (scope.active())
+        pullShared();
+
+    if (isFull())
+        return false;
+
+    history.record(supplies, "adding " + s.type + " (batch " + s.batch + ")");
+    supplies.pushBack(s);
+    if (changeLogOn())
+        logSupplyChange("push", changeFields(s));
+    if (scope.active())
+        pushShared();
+    if (save)
+        saveToCSV();
+    return true;
+}
+
 // ===============================
 // 2. Use 'Last Added' Supply (POP)
 // ===============================
 void MedicalSupplyManager::useLastSupply() {
+    TraceSpan span("medical.useLastSupply");
+    refresh();
     if (isEmpty()) {
         cout << "No supplies available to use.\n";
         return;
     }
 
     cout << "\n=== Use Last Added Supply ===\n";
-    cout << "Type  : " << supplies[top].type << "\n";
-    cout << "Qty   : " << supplies[top].quantity << "\n";
-    cout << "Batch : " << supplies[top].batch << "\n";
+    Supply last = supplies.back();
+    cout << "Type  : " << last.type << "\n";
+    cout << "Qty   : " << last.quantity << "\n";
+    cout << "Batch : " << last.batch << "\n";
 
     string confirm;
+    TraceSpan prompt("medical.prompt");
     cout << "\nConfirm usage? (Y/N): ";
     cin >> confirm;
+    prompt.end();
 
     if (confirm == "Y" || confirm == "y") {
-        top--;
-        saveToCSV();
+        // Another user may have changed the stack while we were confirming
+        Supply used;
+        if (!popSupply(used, true, last.batch)) {
+            cout << "[INFO] Stack was changed by another user: batch " << last.batch
+                 << " is no longer on top. Nothing removed.\n";
+            return;
+        }
         cout << "[INFO] Supply removed and file updated.\n";
     } else {
         cout << "[INFO] Cancelled. Supply not removed.\n";
     }
 }
 
+// ===============================
+// Pop without prompting
+// ===============================
+bool MedicalSupplyManager::popSupply(Supply &out, bool save, const string &expectedBatch) {
+    StatTimer timer(STAT_MEDICAL_USE);
+    SharedScope<SupplyTable> scope(shared.get());
+    if (scope.active())
+        pullShared();
+
+    if (isEmpty())
+        return false;
+    if (!expectedBatch.empty() && supplies.back().batch != expectedBatch)
+        return false;
+
+    out = supplies.back();
+    history.record(supplies, "use of " + out.type + " (batch " + out.batch + ")");
+    supplies.popBack();
+    if (changeLogOn())
+        logSupplyChange("pop", ChangeFields{{"batch", out.batch}});
+    if (scope.active())
+        pushShared();
+    if (save)
+        saveToCSV();
+    return true;
+}
+
+// ===============================
+// Take part of the top batch
+// ===============================
+bool MedicalSupplyManager::takeFromTop(int quantity, Supply &taken, bool save) {
+    SharedScope<SupplyTable> scope(shared.get());
+    if (scope.active())
+        pullShared();
+
+    if (isEmpty() || quantity < 0)
+        return false;
+
+    Supply top = supplies.back();
+    if (quantity == 0 || quantity > top.quantity)
+        quantity = top.quantity;
+
+    taken = top;
+    taken.quantity = quantity;
+    history.record(supplies, "taking " + to_string(quantity) + " " + top.type + " (batch " + top.batch + ")");
+    supplies.popBack();
+    if (quantity < top.quantity) {
+        top.quantity -= quantity;
+        supplies.pushBack(top);   // the rest stays on top
+    }
+    if (changeLogOn())
+        logSupplyChange("take", ChangeFields{{"batch", taken.batch}, {"quantity", to_string(quantity)}});
+    if (scope.active())
+        pushShared();
+    if (save)
+        saveToCSV();
+    return true;
+}
+
+bool MedicalSupplyManager::getAt(int index, Supply &out) const {
+    if (index < 0 || index >= count())
+        return false;
+    out = supplies.at(supplies.size() - 1 - index);
+    return true;
+}
+
+// ===============================
+// Undo (no prompts)
+// ===============================
+bool MedicalSupplyManager::undoLastChange(bool save) {
+    SharedScope<SupplyTable> scope(shared.get());
+    if (scope.active())
+        pullShared();   // changes from elsewhere clear the history
+
+    if (!history.undo(supplies))
+        return false;
+    if (changeLogOn())
+        logSupplyChange("undo", ChangeFields());
+
+    if (scope.active())
+        pushShared();
+    if (save)
+        saveToCSV();
+    return true;
+}
+
+string MedicalSupplyManager::lastChange() const {
+    return history.canUndo() ? history.lastChange() : "";
+}
+
 // ===============================
 // 3. View Current Supplies
 // ===============================
 void MedicalSupplyManager::viewSupplies() const {
+    TraceSpan span("medical.viewSupplies");
     cout << "\n=== Current Supplies (Top of Stack First) ===\n";
+    if (room != MEDICAL_MAIN_ROOM)
+        cout << "Store room: " << room << "\n";
 
     if (isEmpty()) {
         cout << "No supplies available.\n";
         return;
     }
 
-    cout << left << setw(5) << "No"
-         << setw(20) << "Type"
-         << setw(10) << "Quantity"
-         << setw(15) << "Batch" << "\n";
-    cout << string(50, '-') << "\n";
+    TableWriter table(cout, {{"No", 5, false}, {"Type", 20, false}, {"Quantity", 10, false}, {"Batch", 15, false}});
+    table.header();
 
     // Show from top (last added) down to bottom
+    SupplyVersion shown = version();
     int counter = 1;
-    for (int i = top; i >= 0; --i) {
-        cout << left << setw(5) << counter
-             << setw(20) << supplies[i].type
-             << setw(10) << supplies[i].quantity
-             << setw(15) << supplies[i].batch << "\n";
+    for (size_t i = shown.size(); i-- > 0;) {
+        const Supply &s = shown.at(i);
+        if (!table.row({to_string(counter), s.type, to_string(s.quantity), s.batch})) break;
         counter++;
     }
+    table.finish(shown.size());
+}
+
+// ===============================
+// 5. Undo Last Change
+// ===============================
+void MedicalSupplyManager::undoPrompt() {
+    TraceSpan span("medical.undo");
+    string what = lastChange();
+    if (what.empty()) {
+        cout << "Nothing to undo.\n";
+        return;
+    }
+
+    string confirm;
+    TraceSpan prompt("medical.prompt");
+    cout << "\nUndo " << what << "? (Y/N): ";
+    cin >> confirm;
+    prompt.end();
+
+    if (confirm == "Y" || confirm == "y") {
+        if (!undoLastChange()) {
+            cout << "[INFO] Stock was changed by another user. Nothing to undo.\n";
+            return;
+        }
+        cout << "[INFO] Undone: " << what << ".\n";
+    } else {
+        cout << "[INFO] Cancelled. Nothing undone.\n";
+    }
 }
 
 // ===============================
@@ -237,8 +512,10 @@ void medicalSupplyMenu(MedicalSupplyManager &manager) {
         cout << "2. Use 'Last Added' Supply\n";
         cout << "3. View Current Supplies\n";
         cout << "4. Back to Main Menu\n";
+        cout << "5. Undo Last Change\n";
 
-        choice = getMenuChoice("Enter your choice: ", 1, 4);
+        choice = getMenuChoice("Enter your choice: ", 1, 5);
+        manager.refresh();
 
         switch (choice) {
             case 1:
@@ -256,18 +533,28 @@ void medicalSupplyMenu(MedicalSupplyManager &manager) {
             case 4:
                 cout << "Returning to main menu...\n";
                 break;
+
+            case 5:
+                manager.undoPrompt();
+                break;
         }
 
     } while (choice != 4);
 }
 
+#ifndef HOSPITAL_SINGLE_PROCESS
 int main() {
+    startRecordingFromEnv("medical");
+
     // Create the manager (loads CSV automatically)
     MedicalSupplyManager manager;
+    if (getenv("HOSPITAL_SHM"))
+        manager.enableSharedMemory();
 
     // Enter the medical supply menu
     medicalSupplyMenu(manager);
 
     cout << "Exiting Medical Supply System. Goodbye!\n";
     return 0;
-}
\ No newline at end of file
+}
+#endif
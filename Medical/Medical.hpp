@@ -1,7 +1,11 @@
 #ifndef MEDICAL_HPP
 #define MEDICAL_HPP
 
+#include <memory>
 #include <string>
+#include "../Common/SharedTable.hpp"
+#include "../Common/Persistent.hpp"
+#include "../Common/ChangeLog.hpp"
 
 struct Supply {
     std::string type;
@@ -9,29 +13,98 @@ struct Supply {
     std::string batch;
 };
 
+inline void accountStrings(const Supply &s, MemoryAccount account, int sign) {
+    accountString(account, s.type, sign);
+    accountString(account, s.batch, sign);
+}
+
+// Change log line for a push (see Common/ChangeLog.hpp)
+inline ChangeFields changeFields(const Supply &s) {
+    return ChangeFields{{"type", s.type}, {"quantity", std::to_string(s.quantity)}, {"batch", s.batch}};
+}
+
+// Fixed-layout copy of Supply kept in shared memory
+struct SharedSupply {
+    char type[64];
+    int  quantity;
+    char batch[32];
+};
+
+const std::string MEDICAL_SHM = "/hospital_medical";
+
+// Store rooms (see SupplyStore.hpp). The main room keeps the original
+// Medical/Medical.csv; every other room has Medical/Medical-<room>.csv.
+const std::string MEDICAL_MAIN_ROOM = "main";
+
+inline std::string supplyCsvPath(const std::string &room) {
+    return room == MEDICAL_MAIN_ROOM ? "Medical/Medical.csv" : "Medical/Medical-" + room + ".csv";
+}
+
+// Stack contents, bottom first; a copy is a frozen version
+typedef PersistentSeq<Supply, MEM_MEDICAL_NODES, MEM_MEDICAL_STRINGS> SupplyVersion;
+
 class MedicalSupplyManager {
 private:
     static const int MAX_SUPPLIES = 100;   // change this if needed
-    Supply supplies[MAX_SUPPLIES];        // array-based stack
-    int top;                              // index of last element; -1 = empty
+    SupplyVersion supplies;               // persistent stack, top = back
+    UndoHistory<SupplyVersion> history;   // versions before recent changes
 
-    // CSV file path (relative to where the program runs)
-    const std::string CSV_PATH = "Medical/Medical.csv";
+    // Store room and its CSV file (relative to where the program runs)
+    std::string room;
+    std::string csvPath;
 
     void loadFromCSV();   // read existing data from CSV into stack
-    void saveToCSV();     // write current stack to CSV
+    bool loadFromSnapshot(); // same, from the binary snapshot if current
+
+    // Shared memory mode (null when off)
+    typedef SharedTable<SharedSupply, MAX_SUPPLIES> SupplyTable;
+    std::unique_ptr<SupplyTable> shared;
+    uint64_t sharedGeneration;
+    void pullShared(bool force = false);
+    void pushShared();
+
+    // Change log line; rooms other than main add room=
+    void logSupplyChange(const std::string &op, ChangeFields fields) const;
 
 public:
-    MedicalSupplyManager();
+    // load = false starts empty without reading the CSV (standby)
+    explicit MedicalSupplyManager(bool load = true, const std::string &room = MEDICAL_MAIN_ROOM);
+
+    void saveToCSV();     // write current stack to CSV (and snapshot)
+    std::string csvText() const;   // what saveToCSV() writes to the CSV
 
     // Core functionalities
     void addSupply();         // 1. Add Supply Stock
     void useLastSupply();     // 2. Use 'Last Added' Supply
     void viewSupplies() const;// 3. View Current Supplies
+    void undoPrompt();        // 5. Undo Last Change
+
+    // Non-interactive push/pop (no prompts)
+    bool pushSupply(const Supply &s, bool save = true);
+    // expectedBatch != "": only if that batch is still on top (the one an
+    // operator confirmed)
+    bool popSupply(Supply &out, bool save = true, const std::string &expectedBatch = "");
+    // Take quantity units off the top batch (all of it when quantity is 0
+    // or covers the batch); taken gets what was removed. One undo step.
+    bool takeFromTop(int quantity, Supply &taken, bool save = true);
+    bool getAt(int index, Supply &out) const; // 0 = top of stack
+    SupplyVersion version() const { return supplies; }
+
+    // Restore the stack as it was before the last add/use made by this
+    // process; lastChange() describes it ("" when there is nothing)
+    bool undoLastChange(bool save = true);
+    std::string lastChange() const;
+
+    // Keep the stack in a named shared-memory segment so several processes
+    // see the same live stock. The first process to attach seeds it.
+    bool enableSharedMemory(const std::string &name = MEDICAL_SHM);
+    void refresh();   // pick up changes made by other processes
 
     // Helper functions
     bool isFull() const;
     bool isEmpty() const;
+    int count() const;
+    const std::string& getRoom() const { return room; }
 };
 
 // Function to handle menu for this module
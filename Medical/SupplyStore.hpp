@@ -0,0 +1,374 @@
+#ifndef SUPPLY_STORE_HPP
+#define SUPPLY_STORE_HPP
+
+#include <cctype>
+#include <filesystem>
+#include <future>
+#include <map>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <shared_mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "Medical.hpp"
+#include "../Common/Persistence.hpp"
+
+// =======================================================
+// SUPPLY STORE (one stack per store room)
+// Each ward's store room is its own MedicalSupplyManager with its own
+// file (supplyCsvPath) and its own lock, so nurses on different wards
+// never wait for each other. The room list only grows; it has a
+// reader/writer lock of its own that is held just long enough to find a
+// room.
+//
+// Lock order: a room's lock is never held while taking the room list
+// lock, and transfers lock both rooms together (std::scoped_lock), so no
+// two callers can deadlock.
+//
+// A transfer changes two files, and a crash between their writes would
+// lose or double the batch. The rooms of a transfer are therefore saved
+// together: their new contents go to MEDICAL_TRANSFER_JOURNAL (one
+// durable write) before either file, and the journal is emptied once
+// both are on disk. Loading finds a complete journal only after such a
+// crash, and writes its contents over the room files first.
+// =======================================================
+
+const std::string MEDICAL_TRANSFER_JOURNAL = "Medical/Transfer.journal";
+
+// Stock of one supply type across rooms
+struct SupplyTotal {
+    std::string type;
+    long long   quantity;
+    int         batches;
+    std::map<std::string, long long> byRoom;
+};
+
+// Room names end up in file names
+inline bool validRoomName(const std::string &room) {
+    if (room.empty() || room.size() > 32) return false;
+    for (char c : room)
+        if (!isalnum((unsigned char)c) && c != '_' && c != '-') return false;
+    return true;
+}
+
+class SupplyStore {
+private:
+    struct Room {
+        std::mutex lock;
+        std::unique_ptr<MedicalSupplyManager> manager;
+        bool dirty;   // changed since it was last written
+    };
+
+    mutable std::shared_mutex roomsLock;
+    std::map<std::string, std::unique_ptr<Room>> rooms;
+
+    // Rooms changed by a transfer and not yet saved together (under
+    // pairedLock; the rooms' own locks are taken after it)
+    std::mutex pairedLock;
+    std::set<std::string> paired;
+
+    Room* find(const std::string &room) const {
+        std::shared_lock<std::shared_mutex> guard(roomsLock);
+        auto it = rooms.find(room);
+        return it == rooms.end() ? nullptr : it->second.get();
+    }
+
+    // load = false: a new room starts empty and counts as changed, so its
+    // (empty) file is written on the next save
+    Room* open(const std::string &room, bool load) {
+        std::unique_lock<std::shared_mutex> guard(roomsLock);
+        std::unique_ptr<Room> &slot = rooms[room];
+        if (!slot) {
+            slot.reset(new Room());
+            slot->manager.reset(new MedicalSupplyManager(load, room));
+            slot->dirty = !load;
+        }
+        return slot.get();
+    }
+
+    void changed(Room *r, bool save) {
+        if (save) r->manager->saveToCSV();
+        r->dirty = !save;
+    }
+
+    // Journal record: "#room <name>" before each room's CSV lines (which
+    // always hold commas, the markers never do), "#end" when complete
+    static std::string journalRecord(const std::vector<Room*> &group) {
+        std::string record;
+        for (Room *r : group)
+            record += "#room " + r->manager->getRoom() + "\n" + r->manager->csvText();
+        return record + "#end\n";
+    }
+
+    // Save rooms whose files must change together; caller holds their
+    // locks. Their files are written before the journal is emptied, and a
+    // failed write keeps the journal and leaves them to be saved again.
+    bool saveTogether(const std::vector<Room*> &group) {
+        PersistenceWriter &writer = PersistenceWriter::instance();
+        uint64_t failedBefore = writer.failures();
+        persistFile(MEDICAL_TRANSFER_JOURNAL, journalRecord(group), true);
+        for (Room *r : group) r->manager->saveToCSV();
+        if (writer.barrier() != failedBefore) {
+            for (Room *r : group) r->dirty = true;
+            return false;
+        }
+        persistFile(MEDICAL_TRANSFER_JOURNAL, "", true);
+        for (Room *r : group) r->dirty = false;
+        return true;
+    }
+
+    // Rooms of unsaved transfers, saved as one group. Caller holds
+    // pairedLock and roomsLock (shared), and no room lock.
+    void savePaired() {
+        if (paired.empty()) return;
+        std::vector<Room*> group;
+        std::vector<std::unique_lock<std::mutex>> held;
+        for (const std::string &name : paired) {   // rooms in name order
+            auto it = rooms.find(name);
+            if (it == rooms.end()) continue;
+            group.push_back(it->second.get());
+            held.emplace_back(it->second->lock);
+        }
+        if (saveTogether(group)) paired.clear();
+    }
+
+    // After a crash between the files of a transfer: the journal holds
+    // every room of it as it should be
+    static void replayTransferJournal() {
+        std::ifstream file(MEDICAL_TRANSFER_JOURNAL);
+        if (!file.is_open()) return;
+        std::map<std::string, std::string> contents;
+        std::string line, room;
+        bool complete = false;
+        while (std::getline(file, line)) {
+            if (line == "#end") { complete = true; break; }
+            if (line.compare(0, 6, "#room ") == 0) { room = line.substr(6); contents[room]; continue; }
+            if (!room.empty()) contents[room] += line + "\n";
+        }
+        file.close();
+
+        if (complete) {   // a torn record means no room file was touched yet
+            for (const auto &c : contents) {
+                if (!validRoomName(c.first)) continue;
+                if (!writeFileAtomically(supplyCsvPath(c.first), c.second)) return;   // try again next time
+            }
+            std::cerr << "[INFO] Finished an interrupted supply transfer.\n";
+        }
+        writeFileAtomically(MEDICAL_TRANSFER_JOURNAL, "");
+    }
+
+public:
+    // load = false starts with an empty main room (standby); otherwise
+    // the main room and every Medical/Medical-<room>.csv are read
+    explicit SupplyStore(bool load = true) {
+        if (load) replayTransferJournal();
+        open(MEDICAL_MAIN_ROOM, load);
+        if (!load) return;
+
+        std::error_code ec;
+        for (const auto &entry : std::filesystem::directory_iterator("Medical", ec)) {
+            std::string name = entry.path().filename().string();
+            const std::string prefix = "Medical-", suffix = ".csv";
+            if (name.size() <= prefix.size() + suffix.size() || name.compare(0, prefix.size(), prefix) != 0 ||
+                name.compare(name.size() - suffix.size(), suffix.size(), suffix) != 0)
+                continue;
+            std::string room = name.substr(prefix.size(), name.size() - prefix.size() - suffix.size());
+            if (validRoomName(room)) open(room, true);
+        }
+    }
+
+    // The main room, for the menu and shared memory mode. Callers that
+    // use it directly hold the medical dataset lock exclusively.
+    MedicalSupplyManager& mainRoom() { return *find(MEDICAL_MAIN_ROOM)->manager; }
+
+    bool hasRoom(const std::string &room) const { return find(room) != nullptr; }
+
+    // Manager of a room, opened (empty) if new. Same rule as mainRoom().
+    MedicalSupplyManager& roomManager(const std::string &room) {
+        Room *r = find(room);
+        return *(r != nullptr ? r : open(room, false))->manager;
+    }
+
+    std::vector<std::string> roomNames() const {
+        std::shared_lock<std::shared_mutex> guard(roomsLock);
+        std::vector<std::string> names;
+        for (const auto &r : rooms) names.push_back(r.first);
+        return names;
+    }
+
+    // Supplies in every room
+    int count() const {
+        std::shared_lock<std::shared_mutex> guard(roomsLock);
+        int total = 0;
+        for (const auto &r : rooms) {
+            std::lock_guard<std::mutex> roomGuard(r.second->lock);
+            total += r.second->manager->count();
+        }
+        return total;
+    }
+
+    // ---------- One room, under its own lock ----------
+    // push opens the room if it is new; the others fail on unknown rooms
+
+    bool push(const std::string &room, const Supply &s, bool save = true) {
+        Room *r = find(room);
+        if (r == nullptr) r = open(room, false);
+        std::lock_guard<std::mutex> guard(r->lock);
+        if (!r->manager->pushSupply(s, false)) return false;
+        changed(r, save);
+        return true;
+    }
+
+    bool pop(const std::string &room, Supply &out, bool save = true) {
+        Room *r = find(room);
+        if (r == nullptr) return false;
+        std::lock_guard<std::mutex> guard(r->lock);
+        if (!r->manager->popSupply(out, false)) return false;
+        changed(r, save);
+        return true;
+    }
+
+    // what = description of the undone change
+    bool undo(const std::string &room, std::string &what, bool save = true) {
+        Room *r = find(room);
+        if (r == nullptr) return false;
+        std::lock_guard<std::mutex> guard(r->lock);
+        what = r->manager->lastChange();
+        if (!r->manager->undoLastChange(false)) return false;
+        changed(r, save);
+        return true;
+    }
+
+    // Frozen copy of a room's stack (bottom first); false if no such room
+    bool contents(const std::string &room, SupplyVersion &out) const {
+        Room *r = find(room);
+        if (r == nullptr) return false;
+        std::lock_guard<std::mutex> guard(r->lock);
+        out = r->manager->version();
+        return true;
+    }
+
+    // ---------- Between rooms ----------
+    // Move quantity units (0 = all) of the top batch in `from` onto the
+    // top of `to`. Both rooms are locked for the whole move, so nobody
+    // sees the supply in both rooms or in neither; when it can't be done
+    // nothing changes and error says why. Both files are saved together,
+    // now or (save = false) by the next saveChanged().
+    bool transfer(const std::string &from, const std::string &to, int quantity, Supply &moved,
+                  std::string &error, bool save = true) {
+        if (from == to) { error = "rooms must differ"; return false; }
+        Room *src = find(from);
+        if (src == nullptr) { error = "no room " + from; return false; }
+        Room *dst = find(to);
+        if (dst == nullptr) dst = open(to, false);
+
+        std::lock_guard<std::mutex> pairedGuard(pairedLock);
+        // Rooms of earlier unsaved transfers are saved with this one;
+        // found before any room is locked (lock order above)
+        std::vector<Room*> others;
+        if (save)
+            for (const std::string &name : paired)
+                if (name != from && name != to) others.push_back(find(name));
+
+        std::scoped_lock guard(src->lock, dst->lock);
+        if (src->manager->isEmpty()) { error = "no supplies in " + from; return false; }
+        if (dst->manager->isFull()) { error = to + " is full"; return false; }
+        if (!src->manager->takeFromTop(quantity, moved, false)) { error = "quantity must not be negative"; return false; }
+        dst->manager->pushSupply(moved, false);   // checked for room above
+        src->dirty = dst->dirty = true;
+        paired.insert(from);
+        paired.insert(to);
+        if (!save) return true;
+
+        std::vector<Room*> group = {src, dst};
+        std::vector<std::unique_lock<std::mutex>> held;
+        for (Room *r : others) {   // no one else locks two rooms while we hold pairedLock
+            held.emplace_back(r->lock);
+            group.push_back(r);
+        }
+        if (saveTogether(group)) paired.clear();
+        return true;
+    }
+
+    // ---------- Stock across rooms ----------
+    // Each room's stack is copied under its lock (an O(1) persistent
+    // copy) and summed on its own thread; type = "" totals every type
+    std::vector<SupplyTotal> totals(const std::string &type = "") const {
+        std::vector<std::pair<std::string, SupplyVersion>> copies;
+        {
+            std::shared_lock<std::shared_mutex> guard(roomsLock);
+            for (const auto &r : rooms) {
+                std::lock_guard<std::mutex> roomGuard(r.second->lock);
+                copies.emplace_back(r.first, r.second->manager->version());
+            }
+        }
+
+        typedef std::map<std::string, std::pair<long long, int>> RoomStock;   // type -> quantity, batches
+        std::vector<std::future<RoomStock>> jobs;
+        for (const auto &c : copies) {
+            const SupplyVersion *stack = &c.second;
+            jobs.push_back(std::async(std::launch::async, [stack, &type] {
+                RoomStock stock;
+                stack->forEach([&](size_t, const Supply &s) {
+                    if (type.empty() || s.type == type) {
+                        stock[s.type].first += s.quantity;
+                        stock[s.type].second++;
+                    }
+                    return true;
+                });
+                return stock;
+            }));
+        }
+
+        std::map<std::string, SupplyTotal> merged;
+        for (size_t i = 0; i < jobs.size(); i++) {
+            for (const auto &t : jobs[i].get()) {
+                SupplyTotal &total = merged[t.first];
+                total.type = t.first;
+                total.quantity += t.second.first;
+                total.batches += t.second.second;
+                total.byRoom[copies[i].first] += t.second.first;
+            }
+        }
+
+        std::vector<SupplyTotal> out;
+        for (auto &m : merged) out.push_back(m.second);
+        return out;
+    }
+
+    // ---------- Files ----------
+    // Write the rooms changed since their last save, each under its lock
+    // (those of transfers together, first)
+    int saveChanged() {
+        std::lock_guard<std::mutex> pairedGuard(pairedLock);
+        std::shared_lock<std::shared_mutex> guard(roomsLock);
+        int written = 0;
+        size_t pairs = paired.size();
+        savePaired();
+        if (paired.empty()) written += (int)pairs;
+        for (const auto &r : rooms) {
+            if (paired.count(r.first) > 0) continue;   // failed to save together: retried together
+            std::lock_guard<std::mutex> roomGuard(r.second->lock);
+            if (!r.second->dirty) continue;
+            r.second->manager->saveToCSV();
+            r.second->dirty = false;
+            written++;
+        }
+        return written;
+    }
+
+    // Every room, changed or not (the menu saves the main room itself)
+    void saveAll() {
+        std::shared_lock<std::shared_mutex> guard(roomsLock);
+        for (const auto &r : rooms) {
+            std::lock_guard<std::mutex> roomGuard(r.second->lock);
+            r.second->manager->saveToCSV();
+            r.second->dirty = false;
+        }
+    }
+};
+
+#endif // SUPPLY_STORE_HPP
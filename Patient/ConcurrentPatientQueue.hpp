@@ -0,0 +1,139 @@
+#ifndef CONCURRENT_PATIENT_QUEUE_HPP
+#define CONCURRENT_PATIENT_QUEUE_HPP
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include "Patient.hpp"
+using namespace std;
+
+// Node used by the concurrent queue (next must be atomic, unlike Patient)
+struct AdmissionNode {
+    atomic<AdmissionNode*> next;
+    int id;
+    string name;
+    string condition;
+    int64_t enqueuedAt;
+};
+
+inline void accountAdmission(const AdmissionNode* node, int sign) {
+    if (sign > 0) MemoryRegistry::instance().allocated(MEM_ADMISSION_NODES, sizeof(AdmissionNode));
+    else MemoryRegistry::instance().released(MEM_ADMISSION_NODES, sizeof(AdmissionNode));
+    accountString(MEM_ADMISSION_STRINGS, node->name, sign);
+    accountString(MEM_ADMISSION_STRINGS, node->condition, sign);
+}
+
+// An admission taken off the queue, ready to be registered
+struct Admission {
+    int id;
+    string name;
+    string condition;
+    int64_t enqueuedAt;   // when the desk took it, not when it was drained
+};
+
+// =======================================================
+// LOCK-FREE ADMISSION QUEUE
+// Many threads may call admitPatient() at the same time (multi-producer);
+// only ONE thread may call dischargePatient() (single consumer).
+// No mutex anywhere: a producer does one atomic exchange and one store.
+// =======================================================
+class ConcurrentPatientQueue {
+private:
+    atomic<AdmissionNode*> head;   // newest node, producers swap in here
+    AdmissionNode* tail;           // oldest node, touched only by the consumer
+    AdmissionNode stub;            // dummy node so the list is never empty
+    atomic<int> size;              // patients admitted but not yet discharged
+
+    void push(AdmissionNode* node) {
+        node->next.store(nullptr, memory_order_relaxed);
+        AdmissionNode* prev = head.exchange(node, memory_order_acq_rel);
+        // Between the exchange and this store the list is briefly unlinked;
+        // the consumer sees the queue as empty until it completes.
+        prev->next.store(node, memory_order_release);
+    }
+
+    // Returns the oldest node, or nullptr when empty (or a push is mid-link)
+    AdmissionNode* pop() {
+        AdmissionNode* t = tail;
+        AdmissionNode* next = t->next.load(memory_order_acquire);
+
+        if (t == &stub) {
+            if (next == nullptr) return nullptr;
+            tail = next;
+            t = next;
+            next = next->next.load(memory_order_acquire);
+        }
+
+        if (next != nullptr) {
+            tail = next;
+            return t;
+        }
+
+        if (t != head.load(memory_order_acquire)) return nullptr;
+
+        // t is the last real node: put the stub behind it so t can leave
+        push(&stub);
+        next = t->next.load(memory_order_acquire);
+        if (next != nullptr) {
+            tail = next;
+            return t;
+        }
+        return nullptr;
+    }
+
+public:
+    ConcurrentPatientQueue() : head(&stub), tail(&stub), size(0) {
+        stub.next.store(nullptr, memory_order_relaxed);
+    }
+
+    ~ConcurrentPatientQueue() {
+        Admission a;
+        while (dischargePatient(a)) {}
+    }
+
+    ConcurrentPatientQueue(const ConcurrentPatientQueue&) = delete;
+    ConcurrentPatientQueue& operator=(const ConcurrentPatientQueue&) = delete;
+
+    int count() const { return size.load(memory_order_acquire); }
+
+    // =======================================================
+    // ENQUEUE (any thread). Returns the assigned ID, taken from the
+    // registry's counter so it never clashes with other modules.
+    // =======================================================
+    int admitPatient(const string& name, const string& condition) {
+        int newID = PatientRegistry::instance().allocateID();
+        AdmissionNode* node = new AdmissionNode{{nullptr}, newID, name, condition, wallClockMillis()};
+        accountAdmission(node, 1);
+
+        size.fetch_add(1, memory_order_release);
+        push(node);
+        return newID;
+    }
+
+    // =======================================================
+    // DEQUEUE (consumer thread only). False when empty.
+    // =======================================================
+    bool dischargePatient(Admission& out) {
+        AdmissionNode* node = pop();
+
+        // size is raised before a push starts, so a null pop with size > 0
+        // only means a producer is mid-push: wait for its link to land
+        while (node == nullptr) {
+            if (size.load(memory_order_acquire) == 0) return false;
+            this_thread::yield();
+            node = pop();
+        }
+
+        out.id = node->id;
+        out.name = node->name;
+        out.condition = node->condition;
+        out.enqueuedAt = node->enqueuedAt;
+
+        size.fetch_sub(1, memory_order_release);
+        accountAdmission(node, -1);
+        delete node;
+        return true;
+    }
+};
+
+#endif
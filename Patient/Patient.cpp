@@ -1,13 +1,10 @@
 #include <iostream>
+#include <cstdlib>
 #include "Patient.hpp"
+#include "../Common/Recorder.hpp"
 using namespace std;
 
-int main() {
-    PatientQueue pq;
-
-    // Load existing data from CSV
-    pq.loadFromCSV("Patient.csv");
-
+void patientMenu(PatientQueue &pq) {
     int choice;
     string name, condition;
 
@@ -16,21 +13,27 @@ int main() {
         cout << "1. Admit Patient\n";
         cout << "2. Discharge Patient\n";
         cout << "3. View Patient Queue\n";
+        cout << "4. Undo Last Change\n";
+        cout << "5. Remove Patient by ID\n";
         cout << "0. Exit\n";
         cout << "Choose option: ";
         cin >> choice;
         cin.ignore(); // prevents input skipping
+        pq.refresh();
 
         switch (choice) {
-            case 1:
+            case 1: {
+                TraceSpan prompt("patient.prompt");
                 cout << "\nEnter Patient Name: ";
                 getline(cin, name);
 
                 cout << "Enter Condition Type: ";
                 getline(cin, condition);
+                prompt.end();
 
                 pq.admitPatientAuto(name, condition);
                 break;
+            }
 
             case 2:
                 pq.dischargePatient();
@@ -40,6 +43,14 @@ int main() {
                 pq.viewPatients();
                 break;
 
+            case 4:
+                pq.undoPrompt();
+                break;
+
+            case 5:
+                pq.removePatient();
+                break;
+
             case 0:
                 cout << "Saving data and exiting...\n";
                 break;
@@ -49,6 +60,22 @@ int main() {
         }
 
     } while (choice != 0);
+}
+
+// The integrated system (Hospital/Hospital.cpp) links this module in and
+// provides its own main().
+#ifndef HOSPITAL_SINGLE_PROCESS
+int main() {
+    startRecordingFromEnv("patient");
+    PatientQueue pq;
+
+    // Load existing data from CSV
+    pq.loadFromCSV("Patient.csv");
+    if (getenv("HOSPITAL_SHM"))
+        pq.enableSharedMemory();
+
+    patientMenu(pq);
 
     return 0;
 }
+#endif
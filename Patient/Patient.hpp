@@ -5,32 +5,286 @@
 #include <fstream>
 #include <sstream>
 #include <string>
+#include <memory>
+#include <algorithm>
+#include <unordered_map>
+#include <cstdlib>
+#include <functional>
+#include "../Common/SharedTable.hpp"
+#include "../Common/Persistence.hpp"
+#include "../Common/Snapshot.hpp"
+#include "../Common/Stats.hpp"
+#include "../Common/Trace.hpp"
+#include "../Common/WaitStats.hpp"
+#include "../Common/Persistent.hpp"
+#include "../Common/Archive.hpp"
+#include "../Common/ChangeLog.hpp"
+#include "../Common/Table.hpp"
+#include "PatientRegistry.hpp"
+#include "PatientLanes.hpp"
 using namespace std;
 
+// Queue entry; name and condition live in the PatientRegistry
 struct Patient {
     int id;
-    string name;
-    string condition;
-    Patient* next;
+    PatientHandle person;
+    int64_t enqueuedAt;   // wall clock ms when they joined the queue
+    uint64_t seq;         // admission order in this process; rises along every lane
+
+    const string& name() const { return PatientRegistry::instance().get(person).name; }
+    const string& condition() const { return PatientRegistry::instance().get(person).condition; }
+};
+
+// Change log line for an admission (see Common/ChangeLog.hpp)
+inline ChangeFields changeFields(const Patient& p) {
+    return ChangeFields{{"id", to_string(p.id)}, {"name", p.name()}, {"condition", p.condition()},
+                        {"enqueued", to_string(p.enqueuedAt)}};
+}
+
+// Fixed-layout copy of Patient kept in shared memory
+struct SharedPatient {
+    int     id;
+    char    name[64];
+    char    condition[64];
+    int64_t enqueuedAt;
 };
 
+const string PATIENT_SHM = "/hospital_patient";
+const string PATIENT_ARCHIVE = "Patient.archive"; // discharged patients
+const int PATIENT_SHM_CAPACITY = 4096; // the shared segment has a fixed size
+
+// Removals by ID are appended to <file>.journal instead of rewriting the
+// whole file; the next full save empties it. After this many the removal
+// is saved in full instead, so loading never replays a long journal.
+const string PATIENT_JOURNAL_SUFFIX = ".journal";
+const size_t PATIENT_JOURNAL_LIMIT = 256;
+
+typedef SharedTable<SharedPatient, PATIENT_SHM_CAPACITY> PatientTable;
+
+// Fixed-width snapshot record (strings live in the snapshot heap)
+struct PatientRecord {
+    int32_t id;
+    StrRef  name;
+    StrRef  condition;
+    int64_t enqueuedAt;
+};
+
+// Persistent FIFO queue: every change makes a new version that shares
+// everything but O(log n) nodes with the old one (Common/Persistent.hpp)
+typedef PersistentSeq<Patient, MEM_PATIENT_NODES> PatientVersion;
+
+// Every admission lane, front first in each (see PatientLanes.hpp)
+typedef LaneSet<PatientVersion> PatientLanes;
+
+// Where a queued patient is: lane, and seq to find their position
+struct PatientSlot {
+    int lane;
+    uint64_t seq;
+};
+typedef unordered_map<int, PatientSlot, hash<int>, equal_to<int>,
+                      CountingAllocator<pair<const int, PatientSlot>, MEM_PATIENT_INDEX>> PatientIndex;
+
 class PatientQueue {
 private:
-    Patient* front;
-    Patient* rear;
+    vector<PatientLane> lanes;             // configuration, fixed after construction
+    PatientLanes queue;                    // current version of every lane
+    UndoHistory<PatientLanes> history;     // versions before recent changes
+    PatientIndex byID;                     // every queued patient by ID
+    uint64_t nextSeq;
+    string journalPath;                    // <CSV>.journal of the last load or save
+    size_t journalLines;                   // removals in it
+    bool journalResetQueued;               // its emptying is still on the writer
     int lastID; // tracks last assigned patient ID
 
+    // Shared memory mode (null when off)
+    unique_ptr<PatientTable> shared;
+    uint64_t sharedGeneration;
+
+    // Queue entry for a registered person; keeps lastID up to date
+    Patient entryFor(PatientHandle person, int64_t enqueuedAt) {
+        int id = PatientRegistry::instance().get(person).id;
+        if (id > lastID) lastID = id;
+        return Patient{id, person, enqueuedAt, nextSeq++};
+    }
+
+    void rebuildIndex() {
+        byID.clear();
+        for (size_t l = 0; l < queue.lanes.size(); l++)
+            queue.lanes[l].forEach([&](size_t, const Patient& p) {
+                byID[p.id] = PatientSlot{(int)l, p.seq};
+                return true;
+            });
+    }
+
+    // Position of a queued patient in their lane: lanes are sorted by
+    // seq, so a binary search down the treap finds it in O(log n)
+    bool locate(int id, int& lane, size_t& pos) const {
+        auto it = byID.find(id);
+        if (it == byID.end()) return false;
+        const PatientVersion& in = queue.lanes[it->second.lane];
+        uint64_t seq = it->second.seq;
+        pos = in.partitionPoint([seq](const Patient& p) { return p.seq < seq; });
+        lane = it->second.lane;
+        return pos < in.size() && in.at(pos).id == id;
+    }
+
+    // Sort entries (arrival order) into their lanes; the round robin
+    // starts over
+    void assignLanes(const vector<Patient>& entries) {
+        vector<vector<Patient>> byLane(lanes.size());
+        unordered_map<string, int> laneOf;   // conditions repeat a lot
+        for (const Patient& p : entries) {
+            auto it = laneOf.find(p.condition());
+            if (it == laneOf.end()) it = laneOf.emplace(p.condition(), laneForCondition(lanes, p.condition())).first;
+            byLane[it->second].push_back(p);
+        }
+
+        vector<uint64_t> served = queue.served;   // counts are this process's
+        queue = PatientLanes(lanes.size());
+        if (served.size() == lanes.size()) queue.served = served;
+        for (size_t l = 0; l < lanes.size(); l++)
+            queue.lanes[l].assign(byLane[l]);
+        rebuildIndex();
+    }
+
+    // Rebuild the queue from the segment if another process changed it.
+    // The segment holds one list in arrival order; each process keeps its
+    // own round-robin position.
+    void pullShared(bool force = false) {
+        PatientTable::Layout* seg = shared->get();
+        if (!force && seg->generation == sharedGeneration) return;
+
+        vector<Patient> entries;
+        for (int i = 0; i < seg->count; i++)
+            entries.push_back(entryFor(PatientRegistry::instance().adopt(seg->records[i].id, seg->records[i].name,
+                                                                         seg->records[i].condition),
+                                       seg->records[i].enqueuedAt));
+        assignLanes(entries);
+        history.clear();   // our old versions would undo someone else's work
+        lastID = seg->counter;
+        sharedGeneration = seg->generation;
+    }
+
+    // Publish the queue after a change
+    void pushShared() {
+        PatientTable::Layout* seg = shared->get();
+
+        // Never more than the capacity: enableSharedMemory() and append()
+        // refuse to go past it
+        int count = 0;
+        version().forEach([&](size_t i, const Patient& p) {
+            if (i >= (size_t)PATIENT_SHM_CAPACITY) return false;
+            seg->records[i].id = p.id;
+            copyText(seg->records[i].name, p.name());
+            copyText(seg->records[i].condition, p.condition());
+            seg->records[i].enqueuedAt = p.enqueuedAt;
+            count++;
+            return true;
+        });
+        seg->count = count;
+        seg->counter = lastID;
+        sharedGeneration = ++seg->generation;
+    }
+
+    // Append under the shared-memory lock (if any). person NO_PATIENT =
+    // register name/condition as a new person with the next free ID.
+    // enqueuedAt 0 = now; lane -1 = by condition. Returns the patient's
+    // ID, or -1 when the shared segment is full.
+    int append(PatientHandle person, const string& name, const string& condition, bool save,
+               int64_t enqueuedAt = 0, int lane = -1) {
+        StatTimer timer(STAT_PATIENT_ADMIT);
+        SharedScope<PatientTable> scope(shared.get());
+        if (scope.active()) {
+            pullShared();
+            if (queue.size() >= (size_t)PATIENT_SHM_CAPACITY) return -1;
+        }
+
+        PatientRegistry& registry = PatientRegistry::instance();
+        if (person == NO_PATIENT) {
+            // Processes sharing the segment continue from its counter
+            if (scope.active())
+                person = registry.adopt(max(lastID, registry.getLastID()) + 1, name, condition);
+            else
+                person = registry.registerPerson(name, condition);
+        }
+        if (lane < 0) lane = laneForCondition(lanes, registry.get(person).condition);
+        history.record(queue, "admission of " + registry.get(person).name);
+        PatientVersion& into = queue.lanes[lane];
+        into.pushBack(entryFor(person, enqueuedAt != 0 ? enqueuedAt : wallClockMillis()));
+        byID[into.back().id] = PatientSlot{lane, into.back().seq};
+        if (changeLogOn()) {
+            ChangeFields fields = changeFields(into.back());
+            fields.push_back({"lane", lanes[lane].name});
+            logChange("patient", "admit", fields);
+        }
+
+        if (scope.active()) pushShared();
+        if (save) saveToCSV("Patient.csv");
+        return registry.get(person).id;
+    }
+
 public:
-    PatientQueue() {
-        front = nullptr;
-        rear = nullptr;
+    // Lanes from PatientLanes.csv in the working directory (or defaults)
+    PatientQueue() : lanes(loadPatientLanes()), queue(lanes.size()), nextSeq(0),
+                     journalPath("Patient.csv" + PATIENT_JOURNAL_SUFFIX), journalLines(0), journalResetQueued(false) {
         lastID = 0;
+        sharedGeneration = 0;
+    }
+
+    // =======================================================
+    // SHARED MEMORY MODE
+    // Keep the queue in a named shared-memory segment so several
+    // processes see the same live queue. The first one seeds it.
+    // =======================================================
+    bool enableSharedMemory(const string& name = PATIENT_SHM) {
+        // Seeding the segment would drop everyone past its capacity
+        if (queue.size() > (size_t)PATIENT_SHM_CAPACITY) {
+            cout << "Shared memory unavailable (" << queue.size() << " patients waiting, the segment holds "
+                 << PATIENT_SHM_CAPACITY << "). Using private data.\n";
+            return false;
+        }
+
+        unique_ptr<PatientTable> table(new PatientTable());
+        string error;
+        if (!table->attach(name, error)) {
+            cout << "Shared memory unavailable (" << error << "). Using private data.\n";
+            return false;
+        }
+
+        shared = move(table);
+        SharedScope<PatientTable> scope(shared.get());
+        if (!shared->get()->loaded) {
+            pushShared();
+            shared->get()->loaded = 1;
+        } else {
+            pullShared(true);
+        }
+        return true;
     }
 
+    // Pick up changes made by other processes
+    void refresh() {
+        SharedScope<PatientTable> scope(shared.get());
+        if (scope.active()) pullShared();
+    }
+
+    bool isShared() const { return shared != nullptr; }
+
+    int count() const { return (int)queue.size(); }
+    int getLastID() const { return lastID; }
+
     // =======================================================
     // LOAD PATIENTS FROM CSV
     // =======================================================
     void loadFromCSV(const string& filename) {
+        StatTimer timer(STAT_PATIENT_LOAD);
+        if (loadFromSnapshot(filename)) {
+            replayJournal(filename);
+            cout << "Loaded Patient.csv snapshot (Last ID = " << lastID << ")\n";
+            return;
+        }
+
+        TraceSpan span("patient.parseCSV");
         ifstream file(filename);
         if (!file.is_open()) {
             cout << "Patient.csv not found. Starting with empty queue.\n";
@@ -40,15 +294,20 @@ public:
         string line;
         getline(file, line); // Skip header
 
+        vector<Patient> entries;
+        // Files without an Enqueued column: count waits from now
+        int64_t loadedAt = wallClockMillis();
+
         while (getline(file, line)) {
             if (line.empty()) continue;
 
             stringstream ss(line);
-            string idStr, name, condition;
+            string idStr, name, condition, enqueuedStr;
 
             getline(ss, idStr, ',');
             getline(ss, name, ',');
             getline(ss, condition, ',');
+            getline(ss, enqueuedStr, ',');
 
             if (idStr.empty() || name.empty() || condition.empty())
                 continue; // skip corrupted rows
@@ -59,118 +318,533 @@ public:
             if (id > lastID) lastID = id;
 
             // Load into queue WITHOUT saving
-            admitPatient(id, name, condition, false);
+            int64_t enqueuedAt = enqueuedStr.empty() ? loadedAt : atoll(enqueuedStr.c_str());
+            entries.push_back(entryFor(PatientRegistry::instance().adopt(id, name, condition), enqueuedAt));
         }
 
         file.close();
+        assignLanes(entries);
+        replayJournal(filename);
         cout << "Loaded Patient.csv (Last ID = " << lastID << ")\n";
     }
 
     // =======================================================
-    // SAVE PATIENTS TO CSV
+    // APPLY REMOVALS SAVED SINCE THE FILE WAS LAST WRITTEN
+    // Lines are "remove,<id>,<enqueued>"; one that matches nobody (the
+    // file already had it) is skipped. They stay in the journal until the
+    // next full save.
     // =======================================================
-    void saveToCSV(const string& filename) {
-        ofstream file(filename);
+    void replayJournal(const string& filename) {
+        journalPath = filename + PATIENT_JOURNAL_SUFFIX;
+        ifstream file(journalPath);
+        if (!file.is_open()) return;
 
-        file << "ID,Name,Condition\n";
+        string line;
+        while (getline(file, line)) {
+            stringstream ss(line);
+            string op, idStr, enqueuedStr;
+            getline(ss, op, ',');
+            getline(ss, idStr, ',');
+            getline(ss, enqueuedStr, ',');
+            if (op != "remove" || idStr.empty()) continue;
+
+            int id = atoi(idStr.c_str()), lane;
+            size_t pos;
+            if (locate(id, lane, pos) && queue.lanes[lane].at(pos).enqueuedAt == atoll(enqueuedStr.c_str())) {
+                queue.lanes[lane].eraseAt(pos);
+                byID.erase(id);
+            }
+            journalLines++;
+        }
+    }
 
-        Patient* current = front;
-        while (current != nullptr) {
-            file << current->id << ","
-                 << current->name << ","
-                 << current->condition << "\n";
-            current = current->next;
+    // =======================================================
+    // LOAD FROM BINARY SNAPSHOT (false if none or out of date)
+    // =======================================================
+    bool loadFromSnapshot(const string& filename) {
+        TraceSpan span("patient.loadSnapshot");
+        SnapshotView snap;
+        if (!snap.open<PatientRecord>(filename, SNAPSHOT_PATIENT)) return false;
+
+        vector<Patient> entries;
+        entries.reserve(snap.count());
+        for (size_t i = 0; i < snap.count(); i++) {
+            const PatientRecord& r = snap.record<PatientRecord>(i);
+            entries.push_back(entryFor(PatientRegistry::instance().adopt(r.id, snap.text(r.name), snap.text(r.condition)),
+                                       r.enqueuedAt));
         }
+        assignLanes(entries);
+        if (snap.counter() > lastID) lastID = (int)snap.counter();
+        return true;
+    }
 
-        file.close();
+    // =======================================================
+    // SAVE PATIENTS TO CSV (plus binary snapshot for fast startup)
+    // =======================================================
+    void saveToCSV(const string& filename) {
+        StatTimer timer(STAT_PATIENT_SAVE);
+        ostringstream file;
+
+        PatientVersion saved = version();   // frozen: later changes don't show up
+        file << "ID,Name,Condition,Enqueued\n";
+
+        SnapshotWriter snap;
+        saved.forEach([&](size_t, const Patient& p) {
+            file << p.id << ","
+                 << p.name() << ","
+                 << p.condition() << ","
+                 << p.enqueuedAt << "\n";
+
+            PatientRecord r;
+            r.id = p.id;
+            r.name = snap.addString(p.name());
+            r.condition = snap.addString(p.condition());
+            r.enqueuedAt = p.enqueuedAt;
+            snap.addRecord(r);
+            return true;
+        });
+
+        string csv = file.str();
+
+        // Queued on the background writer unless processes share the data
+        bool sync = shared != nullptr;
+        persistFile(filename, csv, sync);
+        persistFile(snapshotPathFor(filename), snap.finish<PatientRecord>(SNAPSHOT_PATIENT, lastID, csv), sync);
+        if (journalLines > 0 || journalPath != filename + PATIENT_JOURNAL_SUFFIX) {
+            // Submitted after the CSV, so the removals it held are never lost
+            persistFile(filename + PATIENT_JOURNAL_SUFFIX, "", sync);
+            journalResetQueued = !sync;
+            journalLines = 0;
+        }
+        journalPath = filename + PATIENT_JOURNAL_SUFFIX;
     }
 
     // =======================================================
     // ENQUEUE PATIENT
     // =======================================================
-    void admitPatient(int id, string name, string condition, bool save = true) {
-        Patient* newPatient = new Patient{id, name, condition, nullptr};
+    // lane = lane name to use instead of routing by condition (standby);
+    // returns the patient's ID, -1 if the shared segment is full
+    int admitPatient(int id, string name, string condition, bool save = true, int64_t enqueuedAt = 0,
+                     const string& lane = "") {
+        PatientHandle person = id == 0 ? NO_PATIENT : PatientRegistry::instance().adopt(id, name, condition);
+        return append(person, name, condition, save, enqueuedAt, lane.empty() ? -1 : laneIndex(lanes, lane));
+    }
+
+    // Re-queue someone already in the registry (e.g. back from emergency).
+    // No strings are copied. False when the shared segment is full.
+    bool admitHandle(PatientHandle person, bool save = true) {
+        return append(person, "", "", save) >= 0;
+    }
+
+    // =======================================================
+    // AUTO-ID VERSION (used by menu)
+    // =======================================================
+    void admitPatientAuto(string name, string condition) {
+        TraceSpan span("patient.admitPatientAuto");
+        int newID = admitNext(name, condition, true);
+        if (newID < 0) {
+            cout << "\nShared patient queue is full. Patient not admitted.\n";
+            return;
+        }
+
+        cout << "\nPatient admitted successfully.\n";
+        cout << "Assigned ID: " << newID << "\n";
+    }
+
+    // Silent version for scripted use; returns the assigned ID (-1 if full)
+    int admitNext(string name, string condition, bool save = true) {
+        return append(NO_PATIENT, name, condition, save);
+    }
 
-        if (rear == nullptr) {
-            front = rear = newPatient;
+    // =======================================================
+    // REMOVE NEXT PATIENT WITHOUT PROMPTING
+    // "Front" is the front of whichever lane the round robin is on
+    // =======================================================
+    // expectedID != 0: only if that patient is still next (the one an
+    // operator confirmed). Returns the lane they left, -1 if nobody left.
+    int dischargeFront(Patient& out, bool save = true, int expectedID = 0) {
+        return takeFromLane(-1, out, save, expectedID);
+    }
+
+    // Front of a named lane, ignoring the round robin (standby replay)
+    int dischargeFromLane(const string& lane, Patient& out, bool save = true) {
+        int l = laneIndex(lanes, lane);
+        return l >= 0 ? takeFromLane(l, out, save) : -1;
+    }
+
+    // =======================================================
+    // TRIAGE: the next patient moves to emergency
+    // Not a discharge: no archive row and no wait sample. The entry
+    // taken (enqueue time, seq) is what restoreTriaged() needs to put
+    // them back in their place. lane = named lane (standby replay).
+    // =======================================================
+    bool takeForTriage(Patient& out, bool save = true, const string& lane = "") {
+        int l = lane.empty() ? -1 : laneIndex(lanes, lane);
+        if (!lane.empty() && l < 0) return false;
+        return takeFromLane(l, out, save, 0, true) >= 0;
+    }
+
+    // Back from emergency, or a triage that failed: the patient goes
+    // where their enqueue time puts them, not to the back. False when
+    // they are already queued or the shared segment is full.
+    bool restoreTriaged(const Patient& p, bool save = true, const string& lane = "") {
+        StatTimer timer(STAT_PATIENT_ADMIT);
+        SharedScope<PatientTable> scope(shared.get());
+        if (scope.active()) {
+            pullShared();
+            if (queue.size() >= (size_t)PATIENT_SHM_CAPACITY) return false;
+        }
+        if (byID.count(p.id)) return false;
+
+        int l = lane.empty() ? laneForCondition(lanes, p.condition()) : laneIndex(lanes, lane);
+        if (l < 0) return false;
+        // Not undoable, and nothing before it either: the emergency case
+        // it came from is gone, and undo here would not bring it back
+        history.clear();
+
+        // Each lane is in admission order, and so in seq order
+        PatientVersion& into = queue.lanes[l];
+        size_t pos = into.partitionPoint([&p](const Patient& q) {
+            return q.enqueuedAt < p.enqueuedAt || (q.enqueuedAt == p.enqueuedAt && q.id < p.id);
+        });
+        bool seqFits = (pos == 0 || into.at(pos - 1).seq < p.seq) && (pos == into.size() || p.seq < into.at(pos).seq);
+        into.insertAt(pos, p);
+        if (seqFits) {
+            byID[p.id] = PatientSlot{l, p.seq};
         } else {
-            rear->next = newPatient;
-            rear = newPatient;
+            // The lane was renumbered since (reload, another process):
+            // number it again, O(n) but rare
+            vector<Patient> entries;
+            entries.reserve(into.size());
+            into.forEach([&](size_t, const Patient& q) {
+                entries.push_back(q);
+                entries.back().seq = nextSeq++;
+                byID[q.id] = PatientSlot{l, entries.back().seq};
+                return true;
+            });
+            into.assign(entries);
+        }
+        if (changeLogOn()) {
+            ChangeFields fields = changeFields(p);
+            fields.push_back({"lane", lanes[l].name});
+            logChange("patient", "restore", fields);
         }
 
+        if (scope.active()) pushShared();
         if (save) saveToCSV("Patient.csv");
+        return true;
     }
 
     // =======================================================
-    // AUTO-ID VERSION (used by menu)
+    // REMOVE ANY PATIENT BY ID (left early, transferred out)
+    // O(log n): the ID index gives the lane, a search by seq the
+    // position. With save the removal is one journal line, not a rewrite
+    // of the whole file. Returns the lane they left, -1 if not waiting.
     // =======================================================
-    void admitPatientAuto(string name, string condition) {
-        int newID = lastID + 1;
-        lastID = newID;
+    int removeByID(int id, Patient& out, bool save = true) {
+        StatTimer timer(STAT_PATIENT_DISCHARGE);
+        SharedScope<PatientTable> scope(shared.get());
+        if (scope.active()) pullShared();
+
+        int lane;
+        size_t pos;
+        if (!locate(id, lane, pos)) return -1;
+
+        out = queue.lanes[lane].at(pos);
+        history.record(queue, "removal of " + to_string(out.id) + " " + out.name(), departureOf(out, ""));
+        queue.lanes[lane].eraseAt(pos);
+        byID.erase(id);
+        if (changeLogOn())
+            logChange("patient", "remove", ChangeFields{{"id", to_string(out.id)}, {"lane", lanes[lane].name}});
+
+        if (scope.active()) pushShared();
+        if (save) {
+            // Processes sharing the queue each have their own journal
+            // text, so they save in full
+            if (scope.active() || journalLines >= PATIENT_JOURNAL_LIMIT) {
+                saveToCSV("Patient.csv");
+            } else {
+                // An emptying still queued would wipe the line
+                if (journalResetQueued) PersistenceWriter::instance().barrier();
+                journalResetQueued = false;
+                persistAppend(journalPath, "remove," + to_string(out.id) + "," + to_string(out.enqueuedAt) + "\n");
+                journalLines++;
+            }
+        }
+        return lane;
+    }
 
-        admitPatient(newID, name, condition, true);
+    bool findByID(int id, Patient& out) const {
+        int lane;
+        size_t pos;
+        if (!locate(id, lane, pos)) return false;
+        out = queue.lanes[lane].at(pos);
+        return true;
+    }
 
-        cout << "\nPatient admitted successfully.\n";
-        cout << "Assigned ID: " << newID << "\n";
+private:
+    // Archive row of a patient who left, and for a discharge (lane set)
+    // the wait samples. Run by the undo history once the departure can no
+    // longer be undone, so an undone one is never counted.
+    static function<void()> departureOf(const Patient& p, const string& lane) {
+        if (!departuresRecorded()) return function<void()>();
+        ArchivedRecord row{wallClockMillis(), p.enqueuedAt, p.id, 0, p.condition(), p.name()};
+        return [row, lane]() {
+            if (!lane.empty()) {
+                WaitStatsRegistry::instance().record("patient", row.enqueuedAt, -1, row.type, row.removedAt);
+                WaitStatsRegistry::instance().record("patient/" + lane, row.enqueuedAt, -1, row.type, row.removedAt);
+            }
+            RecordArchive(PATIENT_ARCHIVE).append(row);
+        };
+    }
+
+    // triage: moved to emergency rather than discharged (see takeForTriage).
+    // Returns the lane taken from, -1 if none.
+    int takeFromLane(int lane, Patient& out, bool save, int expectedID = 0, bool triage = false) {
+        StatTimer timer(STAT_PATIENT_DISCHARGE);
+        SharedScope<PatientTable> scope(shared.get());
+        if (scope.active()) pullShared();
+
+        PatientLanes before = queue;
+        if (lane < 0) lane = queue.pick(lanes);
+        if (lane < 0 || queue.lanes[lane].empty()) return -1;
+        if (expectedID != 0 && queue.lanes[lane].front().id != expectedID) {
+            queue = before;   // pick() moved the round robin on
+            return -1;
+        }
+
+        out = queue.lanes[lane].front();
+        // A triage can't be undone here (emergency keeps the case), nor
+        // can anything before it: the patient would wait in both modules
+        if (triage) history.clear();
+        else history.record(before, "discharge of " + to_string(out.id) + " " + out.name(),
+                            departureOf(out, lanes[lane].name));
+        queue.lanes[lane].popFront();
+        byID.erase(out.id);
+        queue.took(lane);
+        if (changeLogOn())
+            logChange("patient", triage ? "triage" : "discharge",
+                      ChangeFields{{"id", to_string(out.id)}, {"lane", lanes[lane].name}});
+
+        if (!triage) queue.served[lane]++;
+        if (scope.active()) pushShared();
+        if (save) saveToCSV("Patient.csv");
+        return lane;
+    }
+
+public:
+    // Every patient in arrival order (all lanes merged by enqueue time):
+    // a frozen copy for files and listings, built in O(n)
+    PatientVersion version() const {
+        vector<vector<Patient>> byLane(queue.lanes.size());
+        for (size_t l = 0; l < queue.lanes.size(); l++) {
+            byLane[l].reserve(queue.lanes[l].size());
+            queue.lanes[l].forEach([&](size_t, const Patient& p) {
+                byLane[l].push_back(p);
+                return true;
+            });
+        }
+
+        vector<Patient> all;
+        all.reserve(queue.size());
+        vector<size_t> next(byLane.size(), 0);
+        while (true) {
+            int best = -1;
+            for (size_t l = 0; l < byLane.size(); l++) {
+                if (next[l] >= byLane[l].size()) continue;
+                const Patient& p = byLane[l][next[l]];
+                if (best < 0) { best = (int)l; continue; }
+                const Patient& b = byLane[best][next[best]];
+                if (p.enqueuedAt < b.enqueuedAt || (p.enqueuedAt == b.enqueuedAt && p.id < b.id)) best = (int)l;
+            }
+            if (best < 0) break;
+            all.push_back(byLane[best][next[best]++]);
+        }
+        PatientVersion merged;
+        merged.assign(all);
+        return merged;
+    }
+
+    // Frozen copy of the lanes (one pointer copy per lane)
+    PatientLanes lanesVersion() const { return queue; }
+    const vector<PatientLane>& laneConfig() const { return lanes; }
+    uint64_t servedFrom(size_t lane) const { return queue.served[lane]; }
+
+    // Next patient dischargeFront() would take
+    bool peekFront(Patient& out) const {
+        PatientLanes next = queue;
+        int lane = next.pick(lanes);
+        if (lane < 0) return false;
+        out = next.lanes[lane].front();
+        return true;
+    }
+
+    // =======================================================
+    // UNDO: restore the queue as it was before the last admission or
+    // discharge made by this process (up to UNDO_DEPTH steps back)
+    // =======================================================
+    bool undoLastChange(bool save = true) {
+        SharedScope<PatientTable> scope(shared.get());
+        if (scope.active()) pullShared();   // changes from elsewhere clear the history
+
+        if (!history.undo(queue)) return false;
+        rebuildIndex();   // O(n), but undo is rare
+        if (changeLogOn()) logChange("patient", "undo");
+
+        if (scope.active()) pushShared();
+        if (save) saveToCSV("Patient.csv");
+        return true;
+    }
+
+    // What undoLastChange() would revert ("" when nothing)
+    string lastChange() const {
+        return history.canUndo() ? history.lastChange() : "";
+    }
+
+    // After a change the other modules share (a transfer): undo stops here
+    void forgetHistory() { history.clear(); }
+
+    void undoPrompt() {
+        TraceSpan span("patient.undo");
+        string what = lastChange();
+        if (what.empty()) {
+            cout << "\nNothing to undo.\n";
+            return;
+        }
+
+        TraceSpan prompt("patient.prompt");
+        cout << "\nUndo " << what << "? (Y/N): ";
+        char confirm;
+        cin >> confirm;
+        prompt.end();
+
+        if (confirm != 'Y' && confirm != 'y') {
+            cout << "Undo cancelled.\n";
+            return;
+        }
+
+        if (!undoLastChange(true)) {
+            cout << "Queue was changed by another clerk. Nothing to undo.\n";
+            return;
+        }
+        cout << "Undone: " << what << ".\n";
     }
 
     // =======================================================
     // DISCHARGE PATIENT (DEQUEUE)
     // =======================================================
     void dischargePatient() {
-        if (front == nullptr) {
+        TraceSpan span("patient.dischargePatient");
+        refresh();
+        if (queue.empty()) {
             cout << "No patients to discharge.\n";
             return;
         }
 
         // Preview patient before discharge
+        Patient next;
+        peekFront(next);
         cout << "\n=== Discharge Warning ===\n";
         cout << "The next patient to be discharged is:\n";
-        cout << "ID: " << front->id
-             << " | Name: " << front->name
-             << " | Condition: " << front->condition << endl;
+        cout << "ID: " << next.id
+             << " | Name: " << next.name()
+             << " | Condition: " << next.condition() << endl;
 
+        TraceSpan prompt("patient.prompt");
         cout << "Proceed with discharge? (Y/N): ";
         char confirm;
         cin >> confirm;
+        prompt.end();
 
         if (confirm != 'Y' && confirm != 'y') {
             cout << "Discharge cancelled.\n";
             return;
         }
 
-        // Execute discharge
-        Patient* temp = front;
-        front = front->next;
-        if (front == nullptr) rear = nullptr;
+        // Execute discharge, unless another clerk got there first
+        Patient removed;
+        if (dischargeFront(removed, true, next.id) < 0) {
+            cout << "Queue was changed by another clerk: patient " << next.id
+                 << " is no longer next. Nothing discharged.\n";
+            return;
+        }
 
         cout << "\nPatient discharged successfully.\n";
-
-        delete temp;
-        saveToCSV("Patient.csv");
     }
 
     // =======================================================
-    // DISPLAY QUEUE (FIFO ORDER)
+    // REMOVE A PATIENT BY ID (LEFT EARLY / TRANSFERRED OUT)
     // =======================================================
-    void viewPatients() {
-        if (front == nullptr) {
-            cout << "\nNo patients in the queue.\n";
+    void removePatient() {
+        TraceSpan span("patient.removePatient");
+        if (queue.empty()) {
+            cout << "No patients in the queue.\n";
             return;
         }
 
-        cout << "\n--- Current Patient Queue (FIFO) ---\n";
-        Patient* current = front;
+        TraceSpan prompt("patient.prompt");
+        cout << "Enter Patient ID to remove: ";
+        int id;
+        if (!(cin >> id)) {
+            cin.clear();
+            cin.ignore(10000, '\n');
+            cout << "Invalid ID.\n";
+            return;
+        }
+
+        Patient found;
+        if (!findByID(id, found)) {
+            cout << "No waiting patient with ID " << id << ".\n";
+            return;
+        }
+        cout << "Remove " << found.name() << " (" << found.condition() << ")? (Y/N): ";
+        char confirm;
+        cin >> confirm;
+        prompt.end();
+
+        if (confirm != 'Y' && confirm != 'y') {
+            cout << "Removal cancelled.\n";
+            return;
+        }
 
-        while (current != nullptr) {
-            cout << "ID: " << current->id
-                 << " | Name: " << current->name
-                 << " | Condition: " << current->condition << "\n";
-            current = current->next;
+        Patient removed;
+        if (removeByID(id, removed, true) < 0) {
+            cout << "Patient " << id << " already left the queue.\n";
+            return;
+        }
+        cout << "\nPatient " << removed.id << " removed from the queue.\n";
+    }
+
+    // =======================================================
+    // DISPLAY QUEUE (LANE BY LANE, FIFO WITHIN EACH)
+    // =======================================================
+    void viewPatients() {
+        TraceSpan span("patient.viewPatients");
+        if (queue.empty()) {
+            cout << "\nNo patients in the queue.\n";
+            return;
         }
 
-        cout << "-------------------------------------\n";
+        PatientLanes shown = lanesVersion();
+        string depths;
+        for (size_t l = 0; l < lanes.size(); l++)
+            depths += (l > 0 ? " | " : "") + lanes[l].name + " " + to_string(shown.lanes[l].size());
+
+        TableWriter table(cout, {{"Lane", 11, false}, {"ID", 8, false}, {"Name", 24, false},
+                                 {"Condition", 24, false}});
+        table.line("\n--- Current Patient Queue (by lane) ---");
+        table.line(depths);
+        table.header();
+        bool more = true;
+        for (size_t l = 0; l < lanes.size() && more; l++)
+            shown.lanes[l].forEach([&](size_t, const Patient& p) {
+                return more = table.row({lanes[l].name, to_string(p.id), p.name(), p.condition()});
+            });
+        table.finish(shown.size(), "-------------------------------------");
     }
 };
 
+// Menu loop for the admission clerk (defined in Patient.cpp)
+void patientMenu(PatientQueue &pq);
+
 #endif
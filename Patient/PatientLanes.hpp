@@ -0,0 +1,161 @@
+#ifndef PATIENT_LANES_HPP
+#define PATIENT_LANES_HPP
+
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+using namespace std;
+
+// =======================================================
+// ADMISSION LANES
+// Admissions are split by condition into lanes (urgent, standard,
+// follow-up, ...), each its own FIFO, so a walk-in with a sprained ankle
+// no longer holds up a patient with chest pain. The next patient is
+// chosen by deficit round robin: on its turn a lane may send up to
+// `weight` patients, then the next non-empty lane gets its turn.
+//
+// With weights 4/2/1 the urgent lane gets 4 of every 7 discharges while
+// all three are busy, and the patient at position p of a lane is called
+// within ceil(p / weight) rounds of at most (sum of weights) discharges:
+// no lane starves and urgent waits stay bounded however long the others
+// get.
+//
+// Lanes come from PatientLanes.csv when it exists:
+//   Lane,Weight,Keywords
+//   urgent,4,chest pain;bleeding;accident
+//   standard,2,
+//   follow-up,1,follow;review
+// A condition goes to the first lane with a keyword it contains (case
+// does not matter); otherwise to the first lane without keywords (the
+// last lane if every lane has some).
+// =======================================================
+
+const string PATIENT_LANES_FILE = "PatientLanes.csv";
+const int MAX_PATIENT_LANES = 8;
+
+struct PatientLane {
+    string name;
+    int weight;               // patients per turn, at least 1
+    vector<string> keywords;  // lower case; none = catch-all
+};
+
+inline string lowerCase(string s) {
+    for (char& c : s) c = (char)tolower((unsigned char)c);
+    return s;
+}
+
+inline vector<PatientLane> defaultPatientLanes() {
+    return {
+        {"urgent", 4, {"chest", "heart", "breath", "bleeding", "accident", "injury", "fracture", "burn",
+                       "unconscious", "seizure", "stroke", "poison"}},
+        {"standard", 2, {}},
+        {"follow-up", 1, {"follow", "review", "check", "refill", "dressing", "vaccin", "result"}},
+    };
+}
+
+// Lanes from file; the defaults if it is missing or has no valid lane
+inline vector<PatientLane> loadPatientLanes(const string& filename = PATIENT_LANES_FILE) {
+    ifstream file(filename);
+    if (!file.is_open()) return defaultPatientLanes();
+
+    vector<PatientLane> lanes;
+    string line;
+    getline(file, line);   // header
+    while (getline(file, line) && lanes.size() < (size_t)MAX_PATIENT_LANES) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty()) continue;
+
+        stringstream ss(line);
+        string name, weight, keywords;
+        getline(ss, name, ',');
+        getline(ss, weight, ',');
+        getline(ss, keywords);
+        int w = atoi(weight.c_str());
+        if (name.empty() || w < 1) {
+            cout << "[Warning] " << filename << ": skipped lane line '" << line << "'\n";
+            continue;
+        }
+
+        PatientLane lane{name, w, {}};
+        stringstream ks(keywords);
+        string k;
+        while (getline(ks, k, ';'))
+            if (!k.empty()) lane.keywords.push_back(lowerCase(k));
+        lanes.push_back(lane);
+    }
+    return lanes.empty() ? defaultPatientLanes() : lanes;
+}
+
+inline int laneForCondition(const vector<PatientLane>& lanes, const string& condition) {
+    string c = lowerCase(condition);
+    int catchAll = -1;
+    for (size_t i = 0; i < lanes.size(); i++) {
+        if (lanes[i].keywords.empty()) {
+            if (catchAll < 0) catchAll = (int)i;
+            continue;
+        }
+        for (const string& k : lanes[i].keywords)
+            if (c.find(k) != string::npos) return (int)i;
+    }
+    return catchAll >= 0 ? catchAll : (int)lanes.size() - 1;
+}
+
+inline int laneIndex(const vector<PatientLane>& lanes, const string& name) {
+    for (size_t i = 0; i < lanes.size(); i++)
+        if (lanes[i].name == name) return (int)i;
+    return -1;
+}
+
+// =======================================================
+// One version of every lane plus the round-robin position, so undo
+// puts back the scheduler (and the served counts) along with the
+// patients. Copying it copies one pointer per lane.
+// =======================================================
+template <class Seq>
+struct LaneSet {
+    vector<Seq> lanes;
+    vector<int> deficit;        // patients the lane may still send this turn
+    size_t current;             // lane whose turn it is
+    vector<uint64_t> served;    // discharges per lane since start
+
+    LaneSet() : current(0) {}
+    explicit LaneSet(size_t n) : lanes(n), deficit(n, 0), current(0), served(n, 0) {}
+
+    size_t size() const {
+        size_t n = 0;
+        for (const Seq& l : lanes) n += l.size();
+        return n;
+    }
+    bool empty() const { return size() == 0; }
+
+    // Lane the next patient comes from (-1 when all are empty). Starts a
+    // lane's turn, skipping empty lanes, but takes nobody.
+    int pick(const vector<PatientLane>& config) {
+        for (size_t n = 0; n <= lanes.size(); n++) {
+            size_t l = current;
+            if (lanes[l].empty()) {
+                deficit[l] = 0;   // an idle lane saves nothing up
+                current = (l + 1) % lanes.size();
+                continue;
+            }
+            if (deficit[l] <= 0) deficit[l] = config[l].weight;
+            return (int)l;
+        }
+        return -1;
+    }
+
+    // After taking the front of lane l: end its turn when used up
+    void took(size_t l) {
+        deficit[l]--;
+        if (deficit[l] <= 0 || lanes[l].empty()) {
+            if (lanes[l].empty()) deficit[l] = 0;
+            current = (l + 1) % lanes.size();
+        }
+    }
+};
+
+#endif // PATIENT_LANES_HPP
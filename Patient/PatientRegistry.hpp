@@ -0,0 +1,135 @@
+#ifndef PATIENT_REGISTRY_HPP
+#define PATIENT_REGISTRY_HPP
+
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include "../Common/Memory.hpp"
+using namespace std;
+
+// Index of a person in the registry; stays valid for the whole run
+typedef int PatientHandle;
+const PatientHandle NO_PATIENT = -1;
+
+struct Person {
+    int    id;
+    string name;
+    string condition;
+};
+
+inline void accountStrings(const Person& p, MemoryAccount account, int sign) {
+    accountString(account, p.name, sign);
+    accountString(account, p.condition, sign);
+}
+
+// =======================================================
+// PATIENT REGISTRY
+// One record per person, shared by the admission queue and the
+// emergency list. Both keep only a handle, so a person's name and
+// condition are stored once, and moving someone between modules is a
+// handle copy. Patient IDs come from one counter for every module.
+// =======================================================
+class PatientRegistry {
+private:
+    // push_back keeps references valid
+    deque<Person, CountingAllocator<Person, MEM_REGISTRY_RECORDS>> people;
+    unordered_map<int, PatientHandle, hash<int>, equal_to<int>,
+                  CountingAllocator<pair<const int, PatientHandle>, MEM_REGISTRY_INDEX>> byID;
+    atomic<int> lastID;
+    mutable shared_mutex lock;
+
+    PatientRegistry() : lastID(0) {}
+
+    void raiseLastID(int id) {
+        int seen = lastID.load(memory_order_relaxed);
+        while (id > seen && !lastID.compare_exchange_weak(seen, id, memory_order_relaxed)) {}
+    }
+
+    PatientHandle insert(int id, const string& name, const string& condition) {
+        people.push_back(Person{id, name, condition});
+        accountStrings(people.back(), MEM_REGISTRY_STRINGS, 1);
+        PatientHandle h = (PatientHandle)people.size() - 1;
+        byID[id] = h;
+        raiseLastID(id);
+        return h;
+    }
+
+public:
+    static PatientRegistry& instance() {
+        static PatientRegistry r;
+        return r;
+    }
+
+    PatientRegistry(const PatientRegistry&) = delete;
+    PatientRegistry& operator=(const PatientRegistry&) = delete;
+
+    // Next free patient ID. Lock-free, so the concurrent intake can use it.
+    int allocateID() {
+        return lastID.fetch_add(1, memory_order_relaxed) + 1;
+    }
+
+    int getLastID() const { return lastID.load(memory_order_relaxed); }
+
+    // No fresh ID up to `id` from now on
+    void reserveIDs(int id) { raiseLastID(id); }
+
+    // While the returned lock is held nobody is halfway through adding a
+    // person (a backup forks under it, see Hospital/Backup.cpp)
+    shared_lock<shared_mutex> holdStill() const {
+        return shared_lock<shared_mutex>(lock);
+    }
+
+    // New person with a fresh ID
+    PatientHandle registerPerson(const string& name, const string& condition) {
+        int id = allocateID();
+        unique_lock<shared_mutex> guard(lock);
+        return insert(id, name, condition);
+    }
+
+    // Person read from a file or another process. The same ID and name
+    // means the same person (e.g. listed in both Patient.csv and
+    // Emergency.csv). An ID already held by someone else is a clash
+    // between files: the newcomer gets a fresh ID. Reserve the IDs of the
+    // whole file first, or a fresh ID can be one the file uses further on.
+    PatientHandle adopt(int id, const string& name, const string& condition) {
+        if (id <= 0) return registerPerson(name, condition);
+
+        unique_lock<shared_mutex> guard(lock);
+        auto it = byID.find(id);
+        if (it == byID.end()) return insert(id, name, condition);
+        if (people[it->second].name == name) return it->second;
+        return insert(allocateID(), name, condition);
+    }
+
+    PatientHandle find(int id) const {
+        shared_lock<shared_mutex> guard(lock);
+        auto it = byID.find(id);
+        return it == byID.end() ? NO_PATIENT : it->second;
+    }
+
+    // Records are never changed or removed, so the reference stays usable
+    const Person& get(PatientHandle h) const {
+        shared_lock<shared_mutex> guard(lock);
+        return people[h];
+    }
+
+    // Forget everyone, for a standby that starts over from a new change
+    // log. Only safe once no queue holds a handle.
+    void clear() {
+        unique_lock<shared_mutex> guard(lock);
+        for (const Person& p : people) accountStrings(p, MEM_REGISTRY_STRINGS, -1);
+        people.clear();
+        byID.clear();
+        lastID = 0;
+    }
+
+    int count() const {
+        shared_lock<shared_mutex> guard(lock);
+        return (int)people.size();
+    }
+};
+
+#endif